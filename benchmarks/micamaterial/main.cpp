@@ -0,0 +1,337 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <QtCore/qrandom.h>
+#include <QtGui/qguiapplication.h>
+#include <QtGui/qimage.h>
+#include <QtGui/qpainter.h>
+#include <QtTest/qtest.h>
+#include <QtTest/qtest_gui.h>
+#include <micamaterial.h>
+#include <micamaterial_p.h>
+
+FRAMELESSHELPER_USE_NAMESPACE
+
+using namespace Global;
+
+// Same as the default blur radius of the Mica material.
+static constexpr const qreal kBlurRadius = 128.0;
+
+static constexpr const struct
+{
+    const char *name = nullptr;
+    const QSize size = {};
+} kResolutions[] = {
+    {"1080p", {1920, 1080}},
+    {"1440p", {2560, 1440}},
+    {"4K", {3840, 2160}},
+    {"8K", {7680, 4320}}
+};
+
+static constexpr const struct
+{
+    const char *name = nullptr;
+    const QImage::Format format = QImage::Format_Invalid;
+} kFormats[] = {
+    {"RGB32", QImage::Format_RGB32},
+    {"ARGB32_Premultiplied", QImage::Format_ARGB32_Premultiplied}
+};
+
+// Something that looks roughly like a photo: smooth gradients plus some noise.
+// The content doesn't matter for the timing, but it shouldn't be trivial either.
+[[nodiscard]] static inline QImage createImage(const QSize &size, const QImage::Format format)
+{
+    QImage image(size, format);
+    QRandomGenerator generator(42); // Fixed seed, every run blurs the same pixels.
+    const int width = image.width();
+    const int height = image.height();
+    for (int y = 0; y != height; ++y) {
+        const auto line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x != width; ++x) {
+            const int noise = int(generator.bounded(32));
+            const int red = ((x * 223 / width) + noise);
+            const int green = ((y * 223 / height) + noise);
+            const int blue = ((((x + y) * 223) / (width + height)) + noise);
+            const int alpha = ((format == QImage::Format_RGB32) ? 255 : (192 + noise));
+            line[x] = qPremultiply(qRgba(red, green, blue, alpha));
+        }
+    }
+    return image;
+}
+
+class MicaMaterialBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void expBlur_data();
+    void expBlur();
+    void simdBlurMatchesScalar_data();
+    void simdBlurMatchesScalar();
+    void halfScaled_data();
+    void halfScaled();
+    void blurImage_data();
+    void blurImage();
+    void blurWallpaper_data();
+    void blurWallpaper();
+    void placeWallpaper_data();
+    void placeWallpaper();
+    void updateMaterialBrush_data();
+    void updateMaterialBrush();
+
+private:
+    void addImageRows();
+};
+
+void MicaMaterialBenchmark::addImageRows()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<QImage::Format>("format");
+    for (auto &&resolution : kResolutions) {
+        for (auto &&format : kFormats) {
+            QTest::addRow("%s-%s", resolution.name, format.name) << resolution.size << format.format;
+        }
+    }
+}
+
+void MicaMaterialBenchmark::expBlur_data()
+{
+    addImageRows();
+}
+
+void MicaMaterialBenchmark::expBlur()
+{
+    QFETCH(QSize, size);
+    QFETCH(QImage::Format, format);
+    QImage image = createImage(size, format);
+    // The exponential blur costs the same for any content, so blurring the
+    // same image over and over again is fine.
+    QBENCHMARK {
+        MicaMaterialPrivate::expBlur(image, kBlurRadius, true);
+    }
+}
+
+void MicaMaterialBenchmark::simdBlurMatchesScalar_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<QImage::Format>("format");
+    QTest::addColumn<qreal>("radius");
+    // Widths which are not multiples of the vector widths, to cover the remainder
+    // paths of the kernels, and one image large enough to be blurred in parallel.
+    static constexpr const QSize sizes[] = {
+        {1, 1}, {3, 5}, {7, 9}, {16, 16}, {17, 33}, {61, 47}, {320, 240}
+    };
+    static constexpr const qreal radii[] = { 1.0, 4.0, 16.0, 64.0, 128.0, 255.0 };
+    for (auto &&size : sizes) {
+        for (auto &&format : kFormats) {
+            for (auto &&radius : radii) {
+                QTest::addRow("%dx%d-%s-%g", size.width(), size.height(), format.name, radius)
+                    << size << format.format << radius;
+            }
+        }
+    }
+}
+
+// Not a benchmark: the SIMD kernels must produce exactly the same pixels as
+// the scalar one, otherwise the blurred wallpaper would differ between machines.
+void MicaMaterialBenchmark::simdBlurMatchesScalar()
+{
+    QFETCH(QSize, size);
+    QFETCH(QImage::Format, format);
+    QFETCH(qreal, radius);
+    const QImage source = createImage(size, format);
+    for (const bool improvedQuality : {false, true}) {
+        QImage scalar = source;
+        MicaMaterialPrivate::setScalarBlurForced(true);
+        MicaMaterialPrivate::expBlur(scalar, radius, improvedQuality);
+        MicaMaterialPrivate::setScalarBlurForced(false);
+        QImage simd = source;
+        MicaMaterialPrivate::expBlur(simd, radius, improvedQuality);
+        QCOMPARE(simd, scalar);
+    }
+}
+
+void MicaMaterialBenchmark::halfScaled_data()
+{
+    addImageRows();
+}
+
+void MicaMaterialBenchmark::halfScaled()
+{
+    QFETCH(QSize, size);
+    QFETCH(QImage::Format, format);
+    const QImage image = createImage(size, format);
+    QBENCHMARK {
+        const QImage result = MicaMaterialPrivate::halfScaled(image);
+        Q_UNUSED(result);
+    }
+}
+
+void MicaMaterialBenchmark::blurImage_data()
+{
+    addImageRows();
+}
+
+void MicaMaterialBenchmark::blurImage()
+{
+    QFETCH(QSize, size);
+    QFETCH(QImage::Format, format);
+    const QImage source = createImage(size, format);
+    QImage target(size, format);
+    QBENCHMARK {
+        // The blur modifies its input (it halves it first), start from the original image every time.
+        QImage image = source;
+        QPainter painter(&target);
+        MicaMaterialPrivate::blurImage(&painter, image, kBlurRadius, true);
+    }
+}
+
+void MicaMaterialBenchmark::blurWallpaper_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<QImage::Format>("format");
+    QTest::addColumn<bool>("exact");
+    QTest::addColumn<BlurBackend>("backend");
+    static constexpr const struct
+    {
+        const char *name = nullptr;
+        const BlurBackend backend = BlurBackend::Exponential;
+    } backends[] = {
+        {"Exponential", BlurBackend::Exponential},
+        {"Box", BlurBackend::Box},
+        {"Stack", BlurBackend::Stack},
+        {"RecursiveGaussian", BlurBackend::RecursiveGaussian}
+    };
+    for (auto &&resolution : kResolutions) {
+        for (auto &&format : kFormats) {
+            for (auto &&backend : backends) {
+                for (const bool exact : {false, true}) {
+                    QTest::addRow("%s-%s-%s-%s", resolution.name, format.name, backend.name, (exact ? "Exact" : "Pyramid"))
+                        << resolution.size << format.format << exact << backend.backend;
+                }
+            }
+        }
+    }
+}
+
+void MicaMaterialBenchmark::blurWallpaper()
+{
+    QFETCH(QSize, size);
+    QFETCH(QImage::Format, format);
+    QFETCH(bool, exact);
+    QFETCH(BlurBackend, backend);
+    const QImage image = createImage(size, format);
+    QBENCHMARK {
+        const QImage result = MicaMaterialPrivate::blurWallpaper(image, kBlurRadius, exact, backend);
+        Q_UNUSED(result);
+    }
+}
+
+void MicaMaterialBenchmark::placeWallpaper_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<QImage::Format>("format");
+    QTest::addColumn<WallpaperAspectStyle>("aspectStyle");
+    static constexpr const struct
+    {
+        const char *name = nullptr;
+        const WallpaperAspectStyle aspectStyle = WallpaperAspectStyle::Fill;
+    } aspectStyles[] = {
+        {"Fill", WallpaperAspectStyle::Fill},
+        {"Fit", WallpaperAspectStyle::Fit},
+        {"Stretch", WallpaperAspectStyle::Stretch},
+        {"Tile", WallpaperAspectStyle::Tile},
+        {"Center", WallpaperAspectStyle::Center}
+    };
+    for (auto &&resolution : kResolutions) {
+        for (auto &&format : kFormats) {
+            for (auto &&aspectStyle : aspectStyles) {
+                QTest::addRow("%s-%s-%s", resolution.name, format.name, aspectStyle.name)
+                    << resolution.size << format.format << aspectStyle.aspectStyle;
+            }
+        }
+    }
+}
+
+void MicaMaterialBenchmark::placeWallpaper()
+{
+    QFETCH(QSize, size);
+    QFETCH(QImage::Format, format);
+    QFETCH(WallpaperAspectStyle, aspectStyle);
+    // A typical photo, which doesn't match the aspect ratio of the screen.
+    const QImage wallpaper = createImage(QSize(4000, 3000), format);
+    QBENCHMARK {
+        const QImage result = MicaMaterialPrivate::placeWallpaper(wallpaper, size, aspectStyle);
+        Q_UNUSED(result);
+    }
+}
+
+void MicaMaterialBenchmark::updateMaterialBrush_data()
+{
+    QTest::addColumn<bool>("cached");
+    QTest::newRow("Miss") << false;
+    QTest::newRow("Hit") << true;
+}
+
+void MicaMaterialBenchmark::updateMaterialBrush()
+{
+    QFETCH(bool, cached);
+    MicaMaterial material;
+    MicaMaterialPrivate * const d = MicaMaterialPrivate::get(&material);
+    // Cycle through more tint colors (two brushes each, one per theme) than the shared
+    // cache holds (32 brushes): the least recently used brushes are evicted first, so
+    // every one of them is gone by the time it comes round again, and the brushes of
+    // both themes are created from scratch every time, at the same eviction cost.
+    // Otherwise switch between two tint colors which are cached already, that's a
+    // lookup in the shared cache.
+    static constexpr const quint32 kMissTintCount = 64;
+    quint32 tint = 0;
+    material.setTintColor(QColor::fromRgba(0xFF000001));
+    d->updateMaterialBrush();
+    material.setTintColor(QColor::fromRgba(0xFF000000));
+    d->updateMaterialBrush();
+    QBENCHMARK {
+        ++tint;
+        material.setTintColor(QColor::fromRgba(cached ? (0xFF000000 + (tint & 1)) : (0xFF000100 + (tint % kMissTintCount))));
+        d->updateMaterialBrush();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // Nothing is shown on the screen, so the benchmarks can run on headless machines as well.
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    FramelessHelper::Core::initialize();
+
+    const QGuiApplication application(argc, argv);
+
+    MicaMaterialBenchmark benchmark;
+    return QTest::qExec(&benchmark, argc, argv);
+}
+
+#include "main.moc"
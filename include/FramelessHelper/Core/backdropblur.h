@@ -0,0 +1,87 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "framelesshelpercore_global.h"
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(lcBackdropBlur)
+
+class BackdropBlurPrivate;
+
+/*
+    Blurs a snapshot of whatever is underneath a translucent overlay (a side
+    panel or a popup, for example) inside of the same window. The snapshot has
+    to be margin() larger than the overlay on each side, because the pixels
+    near the edges of the overlay are blurred together with their neighbours.
+    Once the whole snapshot has been set, only the parts that changed need to
+    be passed again, and only the area they influence is blurred again.
+ */
+class FRAMELESSHELPER_CORE_API BackdropBlur : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(BackdropBlur)
+    Q_DECLARE_PRIVATE(BackdropBlur)
+
+    Q_PROPERTY(qreal radius READ radius WRITE setRadius NOTIFY radiusChanged FINAL)
+    Q_PROPERTY(QColor tintColor READ tintColor WRITE setTintColor NOTIFY tintColorChanged FINAL)
+    Q_PROPERTY(int margin READ margin NOTIFY marginChanged FINAL)
+
+public:
+    explicit BackdropBlur(QObject *parent = nullptr);
+    ~BackdropBlur() override;
+
+    Q_NODISCARD qreal radius() const;
+    Q_NODISCARD QColor tintColor() const;
+    Q_NODISCARD int margin() const;
+
+    // False until a snapshot is set, and again after the radius changed.
+    Q_NODISCARD bool hasSource() const;
+
+public Q_SLOTS:
+    void setRadius(const qreal value);
+    void setTintColor(const QColor &value);
+    void setSource(const QImage &image);
+    // Replaces a part of the snapshot, the position is relative to its top left corner
+    // in device independent pixels. Returns whether any pixel has really changed.
+    bool updateSource(const QImage &image, const QPoint &pos);
+    void clearSource();
+    void paint(QPainter *painter, const QRect &rect);
+
+Q_SIGNALS:
+    void radiusChanged();
+    void tintColorChanged();
+    void marginChanged();
+    void shouldRepaint();
+
+private:
+    QScopedPointer<BackdropBlurPrivate> d_ptr;
+};
+
+FRAMELESSHELPER_END_NAMESPACE
+
+Q_DECLARE_METATYPE2(FRAMELESSHELPER_PREPEND_NAMESPACE(BackdropBlur))
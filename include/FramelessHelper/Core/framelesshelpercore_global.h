@@ -211,6 +211,13 @@ Q_NAMESPACE_EXPORT(FRAMELESSHELPER_CORE_API)
 [[maybe_unused]] inline constexpr const QSize kDefaultSystemButtonSize = {qRound(qreal(kDefaultTitleBarHeight) * 1.5), kDefaultTitleBarHeight};
 [[maybe_unused]] inline constexpr const QSize kDefaultSystemButtonIconSize = kDefaultWindowIconSize;
 [[maybe_unused]] inline constexpr const QSize kDefaultWindowSize = {160, 160}; // Value taken from QPA.
+// The valid ranges of the explicit "MicaMaterial" blur settings.
+[[maybe_unused]] inline constexpr const qreal kMinimumMicaMaterialBlurRadius = 1.0;
+[[maybe_unused]] inline constexpr const qreal kMaximumMicaMaterialBlurRadius = 1024.0;
+[[maybe_unused]] inline constexpr const int kMinimumMicaMaterialDownsampleFactor = 1;
+[[maybe_unused]] inline constexpr const int kMaximumMicaMaterialDownsampleFactor = 16;
+[[maybe_unused]] inline constexpr const int kMinimumMicaMaterialBlurPasses = 1;
+[[maybe_unused]] inline constexpr const int kMaximumMicaMaterialBlurPasses = 4;
 
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
 #  define kDefaultBlackColor QColorConstants::Black
@@ -236,6 +243,30 @@ Q_NAMESPACE_EXPORT(FRAMELESSHELPER_CORE_API)
     = FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_DONT_OVERRIDE_CURSOR");
 [[maybe_unused]] inline const QByteArray kDontToggleMaximizeVar
     = FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_DONT_TOGGLE_MAXIMIZE");
+[[maybe_unused]] inline const QByteArray kWindowShadowMarginsVar
+    = FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_WINDOW_SHADOW_MARGINS");
+[[maybe_unused]] inline const QByteArray kMicaMaterialBlurThreadCountVar
+    = FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_MICA_BLUR_THREAD_COUNT");
+[[maybe_unused]] inline const QByteArray kMicaMaterialBlurBackendVar
+    = FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_MICA_BLUR_BACKEND");
+[[maybe_unused]] inline const QByteArray kMicaMaterialWallpaperDownscaleFactorVar
+    = FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_MICA_WALLPAPER_DOWNSCALE_FACTOR");
+[[maybe_unused]] inline const QByteArray kMicaMaterialMemoryBudgetVar
+    = FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_MICA_MEMORY_BUDGET");
+
+// FramelessConfig::setInternal() keys.
+// The maximum number of threads used to blur the wallpaper (int, <= 0 means the number of CPU cores).
+[[maybe_unused]] inline const QString kMicaMaterialBlurThreadCountKey
+    = FRAMELESSHELPER_STRING_LITERAL("MicaMaterial/BlurThreadCount");
+// The algorithm used to blur the wallpaper (Global::BlurBackend).
+[[maybe_unused]] inline const QString kMicaMaterialBlurBackendKey
+    = FRAMELESSHELPER_STRING_LITERAL("MicaMaterial/BlurBackend");
+// The blurred wallpaper is stored at 1/N of the screen resolution (int, <= 0 means the default, 4).
+[[maybe_unused]] inline const QString kMicaMaterialWallpaperDownscaleFactorKey
+    = FRAMELESSHELPER_STRING_LITERAL("MicaMaterial/WallpaperDownscaleFactor");
+// The memory all blurred wallpapers of the process may use, in MiB (int, <= 0 means the default, 32).
+[[maybe_unused]] inline const QString kMicaMaterialMemoryBudgetKey
+    = FRAMELESSHELPER_STRING_LITERAL("MicaMaterial/MemoryBudget");
 
 enum class Option
 {
@@ -247,7 +278,12 @@ enum class Option
     CenterWindowBeforeShow = 5,
     EnableBlurBehindWindow = 6,
     ForceNonNativeBackgroundBlur = 7,
-    DisableLazyInitializationForMicaMaterial = 8
+    DisableLazyInitializationForMicaMaterial = 8,
+    DisableWallpaperCacheForMicaMaterial = 9,
+    UseExactBlurForMicaMaterial = 10,
+    ShareWallpaperBetweenProcessesForMicaMaterial = 11,
+    UseProgressiveBlurForMicaMaterial = 12,
+    EnableWindowShadowOnLinux = 13
 };
 Q_ENUM_NS(Option)
 
@@ -402,6 +438,24 @@ enum class WindowCornerStyle
 };
 Q_ENUM_NS(WindowCornerStyle)
 
+enum class BlurBackend
+{
+    Exponential = 0, // Two sided exponential blur, the default one.
+    Box = 1, // Three passes of box blur, approximates a gaussian blur.
+    Stack = 2,
+    RecursiveGaussian = 3 // Young & van Vliet recursive gaussian filter.
+};
+Q_ENUM_NS(BlurBackend)
+
+enum class MicaMaterialQuality
+{
+    Auto = 0, // Starts with the high quality, steps down if generating the wallpaper turns out to be slow.
+    Low = 1,
+    Medium = 2,
+    High = 3
+};
+Q_ENUM_NS(MicaMaterialQuality)
+
 struct VersionNumber
 {
     int major = 0;
@@ -41,6 +41,12 @@ class FRAMELESSHELPER_CORE_API MicaMaterial : public QObject
     Q_PROPERTY(QColor tintColor READ tintColor WRITE setTintColor NOTIFY tintColorChanged FINAL)
     Q_PROPERTY(qreal tintOpacity READ tintOpacity WRITE setTintOpacity NOTIFY tintOpacityChanged FINAL)
     Q_PROPERTY(qreal noiseOpacity READ noiseOpacity WRITE setNoiseOpacity NOTIFY noiseOpacityChanged FINAL)
+    Q_PROPERTY(bool noiseEnabled READ isNoiseEnabled WRITE setNoiseEnabled NOTIFY noiseEnabledChanged FINAL)
+    Q_PROPERTY(Global::MicaMaterialQuality quality READ quality WRITE setQuality NOTIFY qualityChanged FINAL)
+    Q_PROPERTY(qreal blurRadius READ blurRadius WRITE setBlurRadius RESET resetBlurRadius NOTIFY blurRadiusChanged FINAL)
+    Q_PROPERTY(int downsampleFactor READ downsampleFactor WRITE setDownsampleFactor
+               RESET resetDownsampleFactor NOTIFY downsampleFactorChanged FINAL)
+    Q_PROPERTY(int blurPasses READ blurPasses WRITE setBlurPasses RESET resetBlurPasses NOTIFY blurPassesChanged FINAL)
 
 public:
     explicit MicaMaterial(QObject *parent = nullptr);
@@ -55,6 +61,27 @@ public:
     Q_NODISCARD qreal noiseOpacity() const;
     void setNoiseOpacity(const qreal value);
 
+    Q_NODISCARD bool isNoiseEnabled() const;
+    void setNoiseEnabled(const bool value);
+
+    Q_NODISCARD Global::MicaMaterialQuality quality() const;
+    void setQuality(const Global::MicaMaterialQuality value);
+
+    // The three settings below default to the ones of the quality tier,
+    // setting them explicitly overrides the tier. The blur radius reads back
+    // as set, but the wallpaper is blurred with it rounded to whole pixels.
+    Q_NODISCARD qreal blurRadius() const;
+    void setBlurRadius(const qreal value);
+    void resetBlurRadius();
+
+    Q_NODISCARD int downsampleFactor() const;
+    void setDownsampleFactor(const int value);
+    void resetDownsampleFactor();
+
+    Q_NODISCARD int blurPasses() const;
+    void setBlurPasses(const int value);
+    void resetBlurPasses();
+
 public Q_SLOTS:
     void paint(QPainter *painter, const QSize &size, const QPoint &pos);
 
@@ -62,6 +89,11 @@ Q_SIGNALS:
     void tintColorChanged();
     void tintOpacityChanged();
     void noiseOpacityChanged();
+    void noiseEnabledChanged();
+    void qualityChanged();
+    void blurRadiusChanged();
+    void downsampleFactorChanged();
+    void blurPassesChanged();
     void shouldRedraw();
 
 private:
@@ -0,0 +1,76 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "framelesshelpercore_global.h"
+#include <QtGui/qimage.h>
+#include <QtGui/qregion.h>
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+class BackdropBlur;
+
+class FRAMELESSHELPER_CORE_API BackdropBlurPrivate : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PUBLIC(BackdropBlur)
+    Q_DISABLE_COPY_MOVE(BackdropBlurPrivate)
+
+public:
+    explicit BackdropBlurPrivate(BackdropBlur *q);
+    ~BackdropBlurPrivate() override;
+
+    Q_NODISCARD static BackdropBlurPrivate *get(BackdropBlur *q);
+    Q_NODISCARD static const BackdropBlurPrivate *get(const BackdropBlur *q);
+
+    // The tiles of 'after' (placed at 'pos' in 'before') which differ from 'before', in pixels of 'before'.
+    Q_NODISCARD static QRegion changedRegion(const QImage &before, const QImage &after, const QPoint &pos);
+
+    Q_NODISCARD int margin() const;
+
+public Q_SLOTS:
+    void setSource(const QImage &image);
+    bool updateSource(const QImage &image, const QPoint &pos);
+    void paint(QPainter *painter, const QRect &rect);
+
+private:
+    void blurDirtyRegion();
+
+private:
+    BackdropBlur *q_ptr = nullptr;
+    qreal m_radius = 0.0;
+    QColor m_tintColor = {};
+    // The snapshot as it was passed in, and its blurred version. Both are kept
+    // around because blurring a part of the snapshot again needs its neighbours.
+    QImage m_source = {};
+    QImage m_blurred = {};
+    // The part of the snapshot which changed since it was blurred the last time, in device pixels.
+    QRegion m_dirtyRegion = {};
+};
+
+FRAMELESSHELPER_END_NAMESPACE
+
+Q_DECLARE_METATYPE2(FRAMELESSHELPER_PREPEND_NAMESPACE(BackdropBlurPrivate))
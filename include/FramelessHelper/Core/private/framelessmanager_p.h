@@ -55,7 +55,7 @@ public:
     static void removeWindow(const WId windowId);
 
     Q_INVOKABLE void notifySystemThemeHasChangedOrNot();
-    Q_INVOKABLE void notifyWallpaperHasChangedOrNot();
+    Q_INVOKABLE void notifyWallpaperHasChangedOrNot(const bool force = false);
 
     Q_NODISCARD static bool usePureQtImplementation();
 
@@ -25,11 +25,19 @@
 #pragma once
 
 #include "framelesshelpercore_global.h"
+#include <QtCore/qatomic.h>
+#include <QtCore/qsharedpointer.h>
 #include <QtGui/qbrush.h>
 
+QT_BEGIN_NAMESPACE
+class QScreen;
+QT_END_NAMESPACE
+
 FRAMELESSHELPER_BEGIN_NAMESPACE
 
 class MicaMaterial;
+struct WallpaperSnapshot;
+using WallpaperSnapshotPtr = QSharedPointer<const WallpaperSnapshot>;
 
 class FRAMELESSHELPER_CORE_API MicaMaterialPrivate : public QObject
 {
@@ -44,21 +52,64 @@ public:
     Q_NODISCARD static MicaMaterialPrivate *get(MicaMaterial *q);
     Q_NODISCARD static const MicaMaterialPrivate *get(const MicaMaterial *q);
 
+    // The building blocks of the blurred wallpaper, exposed for the benchmarks.
+    Q_NODISCARD static QImage placeWallpaper(const QImage &image, const QSize &size,
+        const Global::WallpaperAspectStyle aspectStyle);
+    Q_NODISCARD static QImage blurWallpaper(const QImage &image, const qreal radius,
+        const bool exact, const Global::BlurBackend backend);
+    static void expBlur(QImage &image, const qreal radius, const bool improvedQuality);
+    // Makes "expBlur()" use the scalar kernel instead of the SIMD ones, for comparing them.
+    static void setScalarBlurForced(const bool value);
+    Q_NODISCARD static QImage halfScaled(const QImage &image);
+    static void blurImage(QPainter *painter, QImage &image, const qreal radius, const bool improvedQuality);
+    // Blurs the alpha channel only, used by the window shadow.
+    static void alphaBlur(QImage &image, const qreal radius, const bool improvedQuality);
+
+    // The quality settings packed into one number, the instances which share
+    // it share their blurred wallpapers. Can be called from any thread.
+    Q_NODISCARD quint32 wallpaperQuality() const;
+
+    // For the painters which build their own scene out of the pieces "paint()" uses
+    // (Qt Quick), from any thread. The blurred wallpaper of \a screen is requested if
+    // needed and is null until it's ready. It's stored at a fraction of the resolution
+    // of the screen, \a imageDevicePixelRatio maps logical pixels of the screen to it.
+    Q_NODISCARD QImage screenWallpaper(const QScreen *screen, QRect *screenGeometry, qreal *imageDevicePixelRatio);
+    // The tint color and the noise: a tile which is repeated all over the surface.
+    Q_NODISCARD QImage materialTexture();
+    // Painted where there's no blurred wallpaper (yet).
+    Q_NODISCARD QColor backgroundColor() const;
+
 public Q_SLOTS:
     void maybeGenerateBlurredWallpaper(const bool force = false);
     void updateMaterialBrush();
     void paint(QPainter *painter, const QSize &size, const QPoint &pos);
+    void emitShouldRedraw();
+    void scheduleMaterialBrushUpdate();
 
 private:
     void initialize();
     void prepareGraphicsResources();
+    bool refreshMaterialBrush();
+    void updateWallpaperQuality();
 
 private:
     MicaMaterial *q_ptr = nullptr;
     QColor tintColor = {};
     qreal tintOpacity = 0.0;
     qreal noiseOpacity = 0.0;
+    bool noiseEnabled = true;
+    Global::MicaMaterialQuality quality = Global::MicaMaterialQuality::Auto;
+    std::optional<qreal> blurRadius = std::nullopt;
+    std::optional<int> downsampleFactor = std::nullopt;
+    std::optional<int> blurPasses = std::nullopt;
+    QAtomicInt packedWallpaperQuality = 0;
     QBrush micaBrush = {};
+    quint64 micaBrushCacheKey = 0;
+    bool micaBrushReady = false;
+    bool materialBrushUpdatePending = false;
+    // Our own reference to the latest blurred wallpapers, see updateWallpaperSnapshot().
+    WallpaperSnapshotPtr wallpaperSnapshot = {};
+    QColor fallbackColor = {};
     bool initialized = false;
 };
 
@@ -0,0 +1,75 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "framelesshelpercore_global.h"
+#include <QtCore/qmargins.h>
+#include <QtCore/qlist.h>
+#include <QtGui/qimage.h>
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+class WindowShadowPainter;
+
+class FRAMELESSHELPER_CORE_API WindowShadowPainterPrivate : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PUBLIC(WindowShadowPainter)
+    Q_DISABLE_COPY_MOVE(WindowShadowPainterPrivate)
+
+public:
+    explicit WindowShadowPainterPrivate(WindowShadowPainter *q);
+    ~WindowShadowPainterPrivate() override;
+
+    Q_NODISCARD static WindowShadowPainterPrivate *get(WindowShadowPainter *q);
+    Q_NODISCARD static const WindowShadowPainterPrivate *get(const WindowShadowPainter *q);
+
+    Q_NODISCARD static QImage shadowTile(const int radius, const int cornerRadius,
+        const QColor &color, const qreal devicePixelRatio);
+
+    Q_NODISCARD QMargins margins() const;
+
+    // The pieces of a tile of \a tileExtent device pixels which make up the shadow of a
+    // window of \a size: where they go (logical pixels) and where they come from in the
+    // tile. Nothing of them is under the window contents. For the painters which build
+    // their own scene out of the pieces "paint()" uses (Qt Quick).
+    Q_NODISCARD QList<QPair<QRectF, QRectF>> patches(const QSize &size,
+        const int tileExtent, const qreal devicePixelRatio) const;
+
+public Q_SLOTS:
+    void paint(QPainter *painter, const QSize &size, const bool active) const;
+
+private:
+    WindowShadowPainter *q_ptr = nullptr;
+    int m_radius = 0;
+    QPoint m_offset = {};
+    int m_cornerRadius = 0;
+    QColor m_activeColor = {};
+    QColor m_inactiveColor = {};
+};
+
+FRAMELESSHELPER_END_NAMESPACE
+
+Q_DECLARE_METATYPE2(FRAMELESSHELPER_PREPEND_NAMESPACE(WindowShadowPainterPrivate))
@@ -25,6 +25,7 @@
 #pragma once
 
 #include "framelesshelpercore_global.h"
+#include <QtCore/qmargins.h>
 
 FRAMELESSHELPER_BEGIN_NAMESPACE
 
@@ -65,6 +66,7 @@ FRAMELESSHELPER_CORE_API void moveWindowToDesktopCenter(
     setBlurBehindWindowEnabled(const WId windowId, const Global::BlurMode mode, const QColor &color);
 [[nodiscard]] FRAMELESSHELPER_CORE_API QString getWallpaperFilePath();
 [[nodiscard]] FRAMELESSHELPER_CORE_API Global::WallpaperAspectStyle getWallpaperAspectStyle();
+[[nodiscard]] FRAMELESSHELPER_CORE_API QString getWallpaperSlideshowDirPath();
 [[nodiscard]] FRAMELESSHELPER_CORE_API bool isBlurBehindWindowSupported();
 FRAMELESSHELPER_CORE_API void registerThemeChangeNotification();
 [[nodiscard]] FRAMELESSHELPER_CORE_API QColor getFrameBorderColor(const bool active);
@@ -141,6 +143,10 @@ FRAMELESSHELPER_CORE_API void bringWindowToFront(const WId windowId);
 #ifdef Q_OS_LINUX
 [[nodiscard]] FRAMELESSHELPER_CORE_API bool shouldAppsUseDarkMode_linux();
 [[nodiscard]] FRAMELESSHELPER_CORE_API QColor getWmThemeColor();
+FRAMELESSHELPER_CORE_API void registerWallpaperChangeNotification();
+FRAMELESSHELPER_CORE_API void setGtkFrameExtents(const WId windowId, const QMargins &margins);
+[[nodiscard]] FRAMELESSHELPER_CORE_API bool isCompositingManagerRunning();
+FRAMELESSHELPER_CORE_API void setX11InputShape(const WId windowId, const QRect &rect);
 #endif // Q_OS_LINUX
 
 #ifdef Q_OS_MACOS
@@ -200,6 +200,15 @@ public:
         FRAMELESSHELPER_QUICK_ENUM_VALUE(WindowCornerStyle, Round)
     };
     Q_ENUM(WindowCornerStyle)
+
+    enum class MicaMaterialQuality
+    {
+        FRAMELESSHELPER_QUICK_ENUM_VALUE(MicaMaterialQuality, Auto)
+        FRAMELESSHELPER_QUICK_ENUM_VALUE(MicaMaterialQuality, Low)
+        FRAMELESSHELPER_QUICK_ENUM_VALUE(MicaMaterialQuality, Medium)
+        FRAMELESSHELPER_QUICK_ENUM_VALUE(MicaMaterialQuality, High)
+    };
+    Q_ENUM(MicaMaterialQuality)
 };
 Q_DECLARE_OPERATORS_FOR_FLAGS(QuickGlobal::WindowEdges)
 
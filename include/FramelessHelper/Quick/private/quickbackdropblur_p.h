@@ -0,0 +1,120 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "framelesshelperquick_global.h"
+#include <QtCore/qsharedpointer.h>
+#include <QtGui/qimage.h>
+
+QT_BEGIN_NAMESPACE
+class QQuickItem;
+class QQuickItemGrabResult;
+QT_END_NAMESPACE
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+class BackdropBlur;
+class BackdropBlurNode;
+class QuickBackdropBlur;
+
+class FRAMELESSHELPER_QUICK_API QuickBackdropBlurPrivate : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(QuickBackdropBlurPrivate)
+    Q_DECLARE_PUBLIC(QuickBackdropBlur)
+
+public:
+    explicit QuickBackdropBlurPrivate(QuickBackdropBlur *q);
+    ~QuickBackdropBlurPrivate() override;
+
+    Q_NODISCARD static QuickBackdropBlurPrivate *get(QuickBackdropBlur *q);
+    Q_NODISCARD static const QuickBackdropBlurPrivate *get(const QuickBackdropBlur *q);
+
+#ifndef FRAMELESSHELPER_QUICK_NO_PRIVATE
+    // Called from "updatePaintNode()", on the render thread while the GUI thread is blocked.
+    void readBackSource(BackdropBlurNode *node);
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+
+public Q_SLOTS:
+    void rebindWindow();
+    void rebindSource(QQuickItem *source);
+    void scheduleUpdate();
+#ifdef FRAMELESSHELPER_QUICK_NO_PRIVATE
+    void handleFrameSwapped();
+    void handleGrabResult(const qreal devicePixelRatio);
+#else // !FRAMELESSHELPER_QUICK_NO_PRIVATE
+    void handleSourceChanged();
+    void handleReadback();
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+    void updateImage();
+
+private:
+    void initialize();
+    Q_NODISCARD QRect sourceGeometry() const;
+    void updateSnapshot(const QImage &snapshot, const QRect &geometry);
+
+private:
+    QuickBackdropBlur *q_ptr = nullptr;
+    BackdropBlur *m_backdropBlur = nullptr;
+#if (QT_VERSION < QT_VERSION_CHECK(5, 15, 0))
+    // Due to a Qt bug, we can't initialize the QPointer objects with nullptr.
+    // The bug was fixed in Qt 5.15.
+    QPointer<QQuickItem> m_source;
+#else
+    QPointer<QQuickItem> m_source = nullptr;
+#endif
+    bool m_live = true;
+#ifdef FRAMELESSHELPER_QUICK_NO_PRIVATE
+    QMetaObject::Connection m_frameSwappedConnection = {};
+    // At most one grab is in flight, requests in the meantime are merged into one.
+    // The result is only released by the next grab, it can't be deleted while it
+    // emits its "ready()" signal.
+    QSharedPointer<QQuickItemGrabResult> m_grabResult = {};
+    bool m_grabPending = false;
+    bool m_grabRequested = false;
+    // Grabbing the source renders a frame on its own, which must not trigger the next grab.
+    bool m_grabFrameSwapped = false;
+    bool m_skipNextFrame = false;
+#else // !FRAMELESSHELPER_QUICK_NO_PRIVATE
+    // What the layer renders, in the coordinates of the source, handed over to the
+    // render thread in "updatePaintNode()". Requests in the meantime are merged into one.
+    QRect m_layerGeometry = {};
+    qreal m_layerDpr = 1.0;
+    bool m_readbackRequested = false;
+    // Handed back to the GUI thread, see "handleReadback()".
+    QImage m_readbackImage = {};
+    QRect m_readbackGeometry = {};
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+    // The part of the source the snapshot covers, in its coordinates.
+    QRect m_sourceGeometry = {};
+    qreal m_sourceDpr = 0.0;
+    QImage m_image = {};
+    bool m_imageChanged = false;
+};
+
+FRAMELESSHELPER_END_NAMESPACE
+
+Q_DECLARE_METATYPE2(FRAMELESSHELPER_PREPEND_NAMESPACE(QuickBackdropBlurPrivate))
@@ -28,6 +28,7 @@
 
 FRAMELESSHELPER_BEGIN_NAMESPACE
 
+class MicaMaterial;
 class QuickMicaMaterial;
 class WallpaperImageNode;
 
@@ -48,6 +49,7 @@ public Q_SLOTS:
     void rebindWindow();
     void forceRegenerateWallpaperImageCache();
     void appendNode(WallpaperImageNode *node);
+    void applyMaterialSettings(MicaMaterial *material) const;
 
 private:
     void initialize();
@@ -56,7 +58,13 @@ private:
     QuickMicaMaterial *q_ptr = nullptr;
     QMetaObject::Connection m_rootWindowXChangedConnection = {};
     QMetaObject::Connection m_rootWindowYChangedConnection = {};
+    QMetaObject::Connection m_rootWindowScreenChangedConnection = {};
     QList<QPointer<WallpaperImageNode>> m_nodes = {};
+    bool m_noiseEnabled = true;
+    QuickGlobal::MicaMaterialQuality m_quality = QuickGlobal::MicaMaterialQuality::Auto;
+    qreal m_blurRadius = 0.0;
+    int m_downsampleFactor = 0;
+    int m_blurPasses = 0;
 };
 
 FRAMELESSHELPER_END_NAMESPACE
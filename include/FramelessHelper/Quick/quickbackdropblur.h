@@ -0,0 +1,96 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "framelesshelperquick_global.h"
+#include <QtQuick/qquickitem.h>
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(lcQuickBackdropBlur)
+
+class QuickBackdropBlurPrivate;
+
+/*
+    Shows a blurred copy of the part of the source item which is underneath this
+    item. The source item must not contain this item, use a sibling (or the
+    sibling of an ancestor) instead. Only the part of the source underneath this
+    item is captured. With "live" enabled, it's captured again whenever the
+    source changes (after every frame without the private Qt Quick API) and
+    only the parts that changed are blurred again, otherwise only when
+    "scheduleUpdate()" is called or the geometry of either item changes.
+ */
+class FRAMELESSHELPER_QUICK_API QuickBackdropBlur : public QQuickItem
+{
+    Q_OBJECT
+#ifdef QML_NAMED_ELEMENT
+    QML_NAMED_ELEMENT(BackdropBlur)
+#endif
+    Q_DISABLE_COPY_MOVE(QuickBackdropBlur)
+    Q_DECLARE_PRIVATE(QuickBackdropBlur)
+
+    Q_PROPERTY(QQuickItem* source READ source WRITE setSource NOTIFY sourceChanged FINAL)
+    Q_PROPERTY(qreal blurRadius READ blurRadius WRITE setBlurRadius NOTIFY blurRadiusChanged FINAL)
+    Q_PROPERTY(QColor tintColor READ tintColor WRITE setTintColor NOTIFY tintColorChanged FINAL)
+    Q_PROPERTY(bool live READ isLive WRITE setLive NOTIFY liveChanged FINAL)
+
+public:
+    explicit QuickBackdropBlur(QQuickItem *parent = nullptr);
+    ~QuickBackdropBlur() override;
+
+    Q_NODISCARD QQuickItem *source() const;
+    void setSource(QQuickItem *value);
+
+    Q_NODISCARD qreal blurRadius() const;
+    void setBlurRadius(const qreal value);
+
+    Q_NODISCARD QColor tintColor() const;
+    void setTintColor(const QColor &value);
+
+    Q_NODISCARD bool isLive() const;
+    void setLive(const bool value);
+
+public Q_SLOTS:
+    void scheduleUpdate();
+
+protected:
+    void itemChange(const ItemChange change, const ItemChangeData &value) override;
+    [[nodiscard]] QSGNode *updatePaintNode(QSGNode *old, UpdatePaintNodeData *data) override;
+
+Q_SIGNALS:
+    void sourceChanged();
+    void blurRadiusChanged();
+    void tintColorChanged();
+    void liveChanged();
+
+private:
+    QScopedPointer<QuickBackdropBlurPrivate> d_ptr;
+};
+
+FRAMELESSHELPER_END_NAMESPACE
+
+Q_DECLARE_METATYPE2(FRAMELESSHELPER_PREPEND_NAMESPACE(QuickBackdropBlur))
+QML_DECLARE_TYPE(FRAMELESSHELPER_PREPEND_NAMESPACE(QuickBackdropBlur))
@@ -42,16 +42,50 @@ class FRAMELESSHELPER_QUICK_API QuickMicaMaterial : public QQuickItem
     Q_DISABLE_COPY_MOVE(QuickMicaMaterial)
     Q_DECLARE_PRIVATE(QuickMicaMaterial)
 
+    Q_PROPERTY(bool noiseEnabled READ isNoiseEnabled WRITE setNoiseEnabled NOTIFY noiseEnabledChanged FINAL)
+    Q_PROPERTY(QuickGlobal::MicaMaterialQuality quality READ quality WRITE setQuality NOTIFY qualityChanged FINAL)
+    Q_PROPERTY(qreal blurRadius READ blurRadius WRITE setBlurRadius RESET resetBlurRadius NOTIFY blurRadiusChanged FINAL)
+    Q_PROPERTY(int downsampleFactor READ downsampleFactor WRITE setDownsampleFactor
+               RESET resetDownsampleFactor NOTIFY downsampleFactorChanged FINAL)
+    Q_PROPERTY(int blurPasses READ blurPasses WRITE setBlurPasses RESET resetBlurPasses NOTIFY blurPassesChanged FINAL)
+
 public:
     explicit QuickMicaMaterial(QQuickItem *parent = nullptr);
     ~QuickMicaMaterial() override;
 
+    Q_NODISCARD bool isNoiseEnabled() const;
+    void setNoiseEnabled(const bool value);
+
+    Q_NODISCARD QuickGlobal::MicaMaterialQuality quality() const;
+    void setQuality(const QuickGlobal::MicaMaterialQuality value);
+
+    // Zero (or less) means the value of the quality tier, other values are clamped
+    // to the ranges of "MicaMaterial" (see "kMaximumMicaMaterialBlurRadius" and friends).
+    Q_NODISCARD qreal blurRadius() const;
+    void setBlurRadius(const qreal value);
+    void resetBlurRadius();
+
+    Q_NODISCARD int downsampleFactor() const;
+    void setDownsampleFactor(const int value);
+    void resetDownsampleFactor();
+
+    Q_NODISCARD int blurPasses() const;
+    void setBlurPasses(const int value);
+    void resetBlurPasses();
+
 protected:
     void itemChange(const ItemChange change, const ItemChangeData &value) override;
     [[nodiscard]] QSGNode *updatePaintNode(QSGNode *old, UpdatePaintNodeData *data) override;
     void classBegin() override;
     void componentComplete() override;
 
+Q_SIGNALS:
+    void noiseEnabledChanged();
+    void qualityChanged();
+    void blurRadiusChanged();
+    void downsampleFactorChanged();
+    void blurPassesChanged();
+
 private:
     QScopedPointer<QuickMicaMaterialPrivate> d_ptr;
 };
@@ -0,0 +1,92 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "framelesshelperwidgets_global.h"
+#include <QtGui/qregion.h>
+
+QT_BEGIN_NAMESPACE
+class QPaintEvent;
+QT_END_NAMESPACE
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+class BackdropBlur;
+class BackdropBlurWidget;
+
+class FRAMELESSHELPER_WIDGETS_API BackdropBlurWidgetPrivate : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PUBLIC(BackdropBlurWidget)
+    Q_DISABLE_COPY_MOVE(BackdropBlurWidgetPrivate)
+
+public:
+    explicit BackdropBlurWidgetPrivate(BackdropBlurWidget *q);
+    ~BackdropBlurWidgetPrivate() override;
+
+    Q_NODISCARD static BackdropBlurWidgetPrivate *get(BackdropBlurWidget *pub);
+    Q_NODISCARD static const BackdropBlurWidgetPrivate *get(const BackdropBlurWidget *pub);
+
+    Q_NODISCARD BackdropBlur *backdropBlur() const;
+
+    void paintBackdrop(QPaintEvent *event);
+
+protected:
+    Q_NODISCARD bool eventFilter(QObject *object, QEvent *event) override;
+
+private:
+    void initialize();
+    void watchWidget(QWidget *widget);
+    void unwatchWidget(QWidget *widget);
+    void addDamagedRegion(QWidget *widget, const QRegion &region);
+    // Repaints the given part of us (all of us if it's empty), in our coordinates.
+    void requestRepaint(const QRect &rect = {});
+    // The area of the parent widget the snapshot is taken from, in its coordinates.
+    Q_NODISCARD QRect sourceGeometry() const;
+    Q_NODISCARD QImage grabBackdrop(const QRect &rect);
+
+private:
+    BackdropBlurWidget *q_ptr = nullptr;
+    BackdropBlur *m_backdropBlur = nullptr;
+#if (QT_VERSION < QT_VERSION_CHECK(5, 15, 0))
+    // Due to a Qt bug, we can't initialize the QPointer objects with nullptr.
+    // The bug was fixed in Qt 5.15.
+    QPointer<QWidget> m_watchedParent;
+#else
+    QPointer<QWidget> m_watchedParent = nullptr;
+#endif
+    QRect m_sourceGeometry = {};
+    qreal m_sourceDpr = 0.0;
+    // What has been repainted underneath the overlay since the last snapshot, in parent coordinates.
+    QRegion m_damagedRegion = {};
+    // What we asked to be repainted ourself since our last paint event, in parent coordinates.
+    QRegion m_ownUpdateRegion = {};
+    bool m_grabbing = false;
+};
+
+FRAMELESSHELPER_END_NAMESPACE
+
+Q_DECLARE_METATYPE2(FRAMELESSHELPER_PREPEND_NAMESPACE(BackdropBlurWidgetPrivate))
@@ -26,6 +26,8 @@
 
 #include "framelesshelperwidgets_global.h"
 #include <QtGui/qscreen.h>
+#include <QtGui/qpixmap.h>
+#include <QtCore/qtimer.h>
 
 QT_BEGIN_NAMESPACE
 class QPaintEvent;
@@ -35,6 +37,7 @@ FRAMELESSHELPER_BEGIN_NAMESPACE
 
 class MicaMaterial;
 class WindowBorderPainter;
+class WindowShadowPainter;
 
 class FRAMELESSHELPER_WIDGETS_API WidgetsSharedHelper : public QObject
 {
@@ -46,6 +49,7 @@ public:
     explicit WidgetsSharedHelper(QObject *parent = nullptr);
     ~WidgetsSharedHelper() override;
 
+    static void prepare(QWidget *widget);
     void setup(QWidget *widget);
 
     Q_NODISCARD bool isMicaEnabled() const;
@@ -53,17 +57,23 @@ public:
 
     Q_NODISCARD MicaMaterial *rawMicaMaterial() const;
     Q_NODISCARD WindowBorderPainter *rawWindowBorder() const;
+    Q_NODISCARD WindowShadowPainter *rawWindowShadow() const;
 
 protected:
     Q_NODISCARD bool eventFilter(QObject *object, QEvent *event) override;
 
 private Q_SLOTS:
     void updateContentsMargins();
+    void updateShadowMargins();
     void handleScreenChanged(QScreen *screen);
 
 private:
     void changeEventHandler(QEvent *event);
     void paintEventHandler(QPaintEvent *event);
+    void invalidateMicaLayer();
+    void scheduleMicaMoveRepaint();
+    Q_NODISCARD QRegion micaBackdropRegion() const;
+    void updateShadowFrameExtents();
 
 Q_SIGNALS:
     void micaEnabledChanged();
@@ -81,10 +91,22 @@ private:
     bool m_micaEnabled = false;
     MicaMaterial *m_micaMaterial = nullptr;
     QMetaObject::Connection m_micaRedrawConnection = {};
+    // The Mica material painted once for the current geometry of the widget,
+    // partial repaints only need to copy the dirty region out of it.
+    QPixmap m_micaLayer = {};
+    QPoint m_micaLayerPos = {};
+    // Coalesces the repaints caused by moving the window to at most one per frame.
+    QTimer m_micaMoveTimer;
     qreal m_screenDpr = 0.0;
     QMetaObject::Connection m_screenDpiChangeConnection = {};
     WindowBorderPainter *m_borderPainter = nullptr;
     QMetaObject::Connection m_borderRepaintConnection = {};
+    // Only used on platforms where a frameless window has no shadow at all.
+    WindowShadowPainter *m_shadowPainter = nullptr;
+    QMetaObject::Connection m_shadowRepaintConnection = {};
+    QMetaObject::Connection m_shadowMarginsConnection = {};
+    // The margins the window has been extended by to make room for the shadow.
+    QMargins m_shadowMargins = {};
     QMetaObject::Connection m_screenChangeConnection = {};
 };
 
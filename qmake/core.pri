@@ -20,6 +20,7 @@ DEPENDPATH += \
 
 HEADERS += \
     $$CORE_EXTRA_INC_DIR/framelesshelper.version \
+    $$CORE_PUB_INC_DIR/backdropblur.h \
     $$CORE_PUB_INC_DIR/chromepalette.h \
     $$CORE_PUB_INC_DIR/framelesshelper_qt.h \
     $$CORE_PUB_INC_DIR/framelesshelpercore_global.h \
@@ -27,14 +28,18 @@ HEADERS += \
     $$CORE_PUB_INC_DIR/micamaterial.h \
     $$CORE_PUB_INC_DIR/utils.h \
     $$CORE_PUB_INC_DIR/windowborderpainter.h \
+    $$CORE_PUB_INC_DIR/windowshadowpainter.h \
+    $$CORE_PRIV_INC_DIR/backdropblur_p.h \
     $$CORE_PRIV_INC_DIR/chromepalette_p.h \
     $$CORE_PRIV_INC_DIR/framelessconfig_p.h \
     $$CORE_PRIV_INC_DIR/framelessmanager_p.h \
     $$CORE_PRIV_INC_DIR/micamaterial_p.h \
     $$CORE_PRIV_INC_DIR/sysapiloader_p.h \
-    $$CORE_PRIV_INC_DIR/windowborderpainter_p.h
+    $$CORE_PRIV_INC_DIR/windowborderpainter_p.h \
+    $$CORE_PRIV_INC_DIR/windowshadowpainter_p.h
 
 SOURCES += \
+    $$CORE_SRC_DIR/backdropblur.cpp \
     $$CORE_SRC_DIR/chromepalette.cpp \
     $$CORE_SRC_DIR/framelessconfig.cpp \
     $$CORE_SRC_DIR/framelesshelper_qt.cpp \
@@ -43,7 +48,8 @@ SOURCES += \
     $$CORE_SRC_DIR/micamaterial.cpp \
     $$CORE_SRC_DIR/sysapiloader.cpp \
     $$CORE_SRC_DIR/utils.cpp \
-    $$CORE_SRC_DIR/windowborderpainter.cpp
+    $$CORE_SRC_DIR/windowborderpainter.cpp \
+    $$CORE_SRC_DIR/windowshadowpainter.cpp
 
 RESOURCES += \
     $$CORE_SRC_DIR/framelesshelpercore.qrc
@@ -65,7 +71,7 @@ win32 {
 
 unix:!macx {
     CONFIG += link_pkgconfig
-    PKGCONFIG += gtk+-3.0 xcb
+    PKGCONFIG += gtk+-3.0 xcb xcb-shape
     DEFINES += GDK_VERSION_MIN_REQUIRED=GDK_VERSION_3_6
     SOURCES += $$CORE_SRC_DIR/utils_linux.cpp
 }
@@ -27,6 +27,7 @@ HEADERS += \
     $$QUICK_PUB_INC_DIR/quickmicamaterial.h \
     $$QUICK_PUB_INC_DIR/quickimageitem.h \
     $$QUICK_PUB_INC_DIR/quickwindowborder.h \
+    $$QUICK_PUB_INC_DIR/quickbackdropblur.h \
     $$QUICK_PRIV_INC_DIR/quickstandardsystembutton_p.h \
     $$QUICK_PRIV_INC_DIR/quickstandardtitlebar_p.h \
     $$QUICK_PRIV_INC_DIR/framelessquickhelper_p.h \
@@ -36,7 +37,8 @@ HEADERS += \
     $$QUICK_PRIV_INC_DIR/framelessquickapplicationwindow_p_p.h \
     $$QUICK_PRIV_INC_DIR/quickmicamaterial_p.h \
     $$QUICK_PRIV_INC_DIR/quickimageitem_p.h \
-    $$QUICK_PRIV_INC_DIR/quickwindowborder_p.h
+    $$QUICK_PRIV_INC_DIR/quickwindowborder_p.h \
+    $$QUICK_PRIV_INC_DIR/quickbackdropblur_p.h
 
 SOURCES += \
     $$QUICK_SRC_DIR/quickstandardsystembutton.cpp \
@@ -50,4 +52,5 @@ SOURCES += \
     $$QUICK_SRC_DIR/framelesshelperquick_global.cpp \
     $$QUICK_SRC_DIR/quickmicamaterial.cpp \
     $$QUICK_SRC_DIR/quickimageitem.cpp \
-    $$QUICK_SRC_DIR/quickwindowborder.cpp
+    $$QUICK_SRC_DIR/quickwindowborder.cpp \
+    $$QUICK_SRC_DIR/quickbackdropblur.cpp
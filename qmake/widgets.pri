@@ -23,13 +23,15 @@ HEADERS += \
     $$WIDGETS_PUB_INC_DIR/framelesswidgetshelper.h \
     $$WIDGETS_PUB_INC_DIR/standardtitlebar.h \
     $$WIDGETS_PUB_INC_DIR/framelessdialog.h \
+    $$WIDGETS_PUB_INC_DIR/backdropblurwidget.h \
     $$WIDGETS_PRIV_INC_DIR/framelesswidgetshelper_p.h \
     $$WIDGETS_PRIV_INC_DIR/standardsystembutton_p.h \
     $$WIDGETS_PRIV_INC_DIR/standardtitlebar_p.h \
     $$WIDGETS_PRIV_INC_DIR/framelesswidget_p.h \
     $$WIDGETS_PRIV_INC_DIR/framelessmainwindow_p.h \
     $$WIDGETS_PRIV_INC_DIR/widgetssharedhelper_p.h \
-    $$WIDGETS_PRIV_INC_DIR/framelessdialog_p.h
+    $$WIDGETS_PRIV_INC_DIR/framelessdialog_p.h \
+    $$WIDGETS_PRIV_INC_DIR/backdropblurwidget_p.h
 
 SOURCES += \
     $$WIDGETS_SRC_DIR/framelessmainwindow.cpp \
@@ -39,4 +41,5 @@ SOURCES += \
     $$WIDGETS_SRC_DIR/standardtitlebar.cpp \
     $$WIDGETS_SRC_DIR/widgetssharedhelper.cpp \
     $$WIDGETS_SRC_DIR/framelesshelperwidgets_global.cpp \
-    $$WIDGETS_SRC_DIR/framelessdialog.cpp
+    $$WIDGETS_SRC_DIR/framelessdialog.cpp \
+    $$WIDGETS_SRC_DIR/backdropblurwidget.cpp
@@ -0,0 +1,365 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "backdropblur.h"
+#include "backdropblur_p.h"
+#include "micamaterial_p.h"
+#include <QtGui/qpainter.h>
+#include <cstring>
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+Q_LOGGING_CATEGORY(lcBackdropBlur, "wangwenx190.framelesshelper.core.backdropblur")
+
+#ifdef FRAMELESSHELPER_CORE_NO_DEBUG_OUTPUT
+#  define INFO QT_NO_QDEBUG_MACRO()
+#  define DEBUG QT_NO_QDEBUG_MACRO()
+#  define WARNING QT_NO_QDEBUG_MACRO()
+#  define CRITICAL QT_NO_QDEBUG_MACRO()
+#else
+#  define INFO qCInfo(lcBackdropBlur)
+#  define DEBUG qCDebug(lcBackdropBlur)
+#  define WARNING qCWarning(lcBackdropBlur)
+#  define CRITICAL qCCritical(lcBackdropBlur)
+#endif
+
+using namespace Global;
+
+static constexpr const qreal kDefaultBackdropBlurRadius = 30.0;
+// The snapshot is compared in tiles of this size (in device pixels), only the
+// tiles that really changed get blurred again.
+static constexpr const int kChangedTileSize = 64;
+// Blurring a lot of small rectangles one by one costs more than blurring the
+// rectangle around all of them once.
+static constexpr const int kMaximumDirtyRectCount = 16;
+
+// How far a pixel is spread by "expblur()" with the given radius, see "qt_blurExtent()".
+[[nodiscard]] static inline int blurExtent(const qreal radius)
+{
+    if (radius <= qreal(0)) {
+        return 0;
+    }
+    return (qCeil(radius) + 1);
+}
+
+[[nodiscard]] static inline QImage blurSourceImage(const QImage &image)
+{
+    if ((image.format() == QImage::Format_ARGB32_Premultiplied)
+        || (image.format() == QImage::Format_RGB32)) {
+        return image;
+    }
+    return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+// Copies 'rect' of 'source' to the same place in 'dest', both being 32-bit images.
+static inline void copyImageRect(const QImage &source, const QPoint &sourcePos, QImage &dest, const QRect &rect)
+{
+    Q_ASSERT((source.depth() == 32) && (dest.depth() == 32));
+    const qsizetype bytesPerLine = (qsizetype(rect.width()) * 4);
+    for (int row = 0; row != rect.height(); ++row) {
+        std::memcpy(dest.scanLine(rect.y() + row) + (qsizetype(rect.x()) * 4),
+            source.constScanLine(sourcePos.y() + row) + (qsizetype(sourcePos.x()) * 4), bytesPerLine);
+    }
+}
+
+BackdropBlurPrivate::BackdropBlurPrivate(BackdropBlur *q) : QObject(q)
+{
+    Q_ASSERT(q);
+    if (!q) {
+        return;
+    }
+    q_ptr = q;
+    m_radius = kDefaultBackdropBlurRadius;
+    m_tintColor = kDefaultTransparentColor;
+}
+
+BackdropBlurPrivate::~BackdropBlurPrivate() = default;
+
+BackdropBlurPrivate *BackdropBlurPrivate::get(BackdropBlur *q)
+{
+    Q_ASSERT(q);
+    if (!q) {
+        return nullptr;
+    }
+    return q->d_func();
+}
+
+const BackdropBlurPrivate *BackdropBlurPrivate::get(const BackdropBlur *q)
+{
+    Q_ASSERT(q);
+    if (!q) {
+        return nullptr;
+    }
+    return q->d_func();
+}
+
+QRegion BackdropBlurPrivate::changedRegion(const QImage &before, const QImage &after, const QPoint &pos)
+{
+    Q_ASSERT(before.format() == after.format());
+    Q_ASSERT(before.depth() == 32);
+    if ((before.format() != after.format()) || (before.depth() != 32)) {
+        return {};
+    }
+    const QRect target = (QRect(pos, after.size()) & before.rect());
+    if (target.isEmpty()) {
+        return {};
+    }
+    QRegion region = {};
+    for (int y = target.top(); y <= target.bottom(); y += kChangedTileSize) {
+        const int tileHeight = qMin(kChangedTileSize, (target.bottom() - y + 1));
+        for (int x = target.left(); x <= target.right(); x += kChangedTileSize) {
+            const int tileWidth = qMin(kChangedTileSize, (target.right() - x + 1));
+            const qsizetype bytesPerLine = (qsizetype(tileWidth) * 4);
+            for (int row = y; row != (y + tileHeight); ++row) {
+                const uchar * const oldPixels = (before.constScanLine(row) + (qsizetype(x) * 4));
+                const uchar * const newPixels = (after.constScanLine(row - pos.y()) + (qsizetype(x - pos.x()) * 4));
+                if (std::memcmp(oldPixels, newPixels, bytesPerLine) != 0) {
+                    region += QRect(x, y, tileWidth, tileHeight);
+                    break;
+                }
+            }
+        }
+    }
+    return region;
+}
+
+int BackdropBlurPrivate::margin() const
+{
+    // In device independent pixels, which covers the extent of the blur for
+    // any device pixel ratio of at least one.
+    return blurExtent(m_radius);
+}
+
+void BackdropBlurPrivate::setSource(const QImage &image)
+{
+    m_source = (image.isNull() ? QImage() : blurSourceImage(image));
+    m_blurred = {};
+    m_dirtyRegion = {};
+}
+
+bool BackdropBlurPrivate::updateSource(const QImage &image, const QPoint &pos)
+{
+    if (m_source.isNull() || image.isNull()) {
+        return false;
+    }
+    const QImage patch = ((image.format() == m_source.format()) ? image : image.convertToFormat(m_source.format()));
+    const QPoint devicePos = (QPointF(pos) * m_source.devicePixelRatio()).toPoint();
+    // Repainting the content below the overlay often doesn't change anything,
+    // there's no need to blur the parts which are still the same.
+    const QRegion region = changedRegion(m_source, patch, devicePos);
+    if (region.isEmpty()) {
+        return false;
+    }
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
+    const QRegion &rects = region;
+#else
+    const QVector<QRect> rects = region.rects();
+#endif
+    for (auto &&rect : rects) {
+        copyImageRect(patch, (rect.topLeft() - devicePos), m_source, rect);
+    }
+    m_dirtyRegion += region;
+    return true;
+}
+
+/*
+*  A changed pixel influences the blurred pixels up to the extent of the blur
+*  around it, and these pixels in turn are blurred from the source pixels up
+*  to the extent of the blur around them. So every dirty rectangle is grown
+*  by the extent once to get the pixels that have to be written, and these
+*  are blurred from a copy of the source which is grown by it once more.
+*  Everything is blurred again once that's about as much work anyway.
+*/
+void BackdropBlurPrivate::blurDirtyRegion()
+{
+    if (m_source.isNull()) {
+        return;
+    }
+    const qreal radius = (m_radius * m_source.devicePixelRatio());
+    if (radius <= qreal(0)) {
+        m_blurred = m_source;
+        m_dirtyRegion = {};
+        return;
+    }
+    const QRect bounds = m_source.rect();
+    const int extent = blurExtent(radius);
+    QRegion affectedRegion = {};
+    if (!m_blurred.isNull()) {
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
+        const QRegion &dirtyRects = m_dirtyRegion;
+#else
+        const QVector<QRect> dirtyRects = m_dirtyRegion.rects();
+#endif
+        for (auto &&rect : dirtyRects) {
+            affectedRegion += (rect.adjusted(-extent, -extent, extent, extent) & bounds);
+        }
+    }
+    m_dirtyRegion = {};
+    if (!m_blurred.isNull() && affectedRegion.isEmpty()) {
+        return;
+    }
+    if (affectedRegion.rectCount() > kMaximumDirtyRectCount) {
+        affectedRegion = affectedRegion.boundingRect();
+    }
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
+    const QRegion &affectedRects = affectedRegion;
+#else
+    const QVector<QRect> affectedRects = affectedRegion.rects();
+#endif
+    qint64 affectedArea = 0;
+    for (auto &&rect : affectedRects) {
+        affectedArea += (qint64(rect.width()) * qint64(rect.height()));
+    }
+    if (m_blurred.isNull() || ((affectedArea * 2) >= (qint64(bounds.width()) * qint64(bounds.height())))) {
+        m_blurred = m_source.copy();
+        MicaMaterialPrivate::expBlur(m_blurred, radius, true);
+        return;
+    }
+    for (auto &&rect : affectedRects) {
+        const QRect inputRect = (rect.adjusted(-extent, -extent, extent, extent) & bounds);
+        QImage input = m_source.copy(inputRect);
+        MicaMaterialPrivate::expBlur(input, radius, true);
+        copyImageRect(input, (rect.topLeft() - inputRect.topLeft()), m_blurred, rect);
+    }
+}
+
+void BackdropBlurPrivate::paint(QPainter *painter, const QRect &rect)
+{
+    Q_ASSERT(painter);
+    if (!painter || rect.isEmpty()) {
+        return;
+    }
+    blurDirtyRegion();
+    painter->save();
+    if (!m_blurred.isNull()) {
+        const int deviceMargin = qRound(qreal(margin()) * m_blurred.devicePixelRatio());
+        const QRect sourceRect = m_blurred.rect().adjusted(deviceMargin, deviceMargin, -deviceMargin, -deviceMargin);
+        painter->setRenderHints(QPainter::SmoothPixmapTransform);
+        painter->drawImage(rect, m_blurred, sourceRect);
+    }
+    if (m_tintColor.alpha() > 0) {
+        painter->fillRect(rect, m_tintColor);
+    }
+    painter->restore();
+}
+
+BackdropBlur::BackdropBlur(QObject *parent)
+    : QObject(parent), d_ptr(new BackdropBlurPrivate(this))
+{
+}
+
+BackdropBlur::~BackdropBlur() = default;
+
+qreal BackdropBlur::radius() const
+{
+    Q_D(const BackdropBlur);
+    return d->m_radius;
+}
+
+QColor BackdropBlur::tintColor() const
+{
+    Q_D(const BackdropBlur);
+    return d->m_tintColor;
+}
+
+int BackdropBlur::margin() const
+{
+    Q_D(const BackdropBlur);
+    return d->margin();
+}
+
+bool BackdropBlur::hasSource() const
+{
+    Q_D(const BackdropBlur);
+    return !d->m_source.isNull();
+}
+
+void BackdropBlur::setRadius(const qreal value)
+{
+    Q_ASSERT(value >= 0);
+    if (value < 0) {
+        return;
+    }
+    if (qFuzzyCompare(radius(), value)) {
+        return;
+    }
+    Q_D(BackdropBlur);
+    const int oldMargin = d->margin();
+    d->m_radius = value;
+    const bool marginHasChanged = (d->margin() != oldMargin);
+    if (marginHasChanged) {
+        // The snapshot doesn't cover the new extent of the blur.
+        d->setSource({});
+    } else {
+        d->m_blurred = {};
+        d->m_dirtyRegion = {};
+    }
+    Q_EMIT radiusChanged();
+    if (marginHasChanged) {
+        Q_EMIT marginChanged();
+    }
+    Q_EMIT shouldRepaint();
+}
+
+void BackdropBlur::setTintColor(const QColor &value)
+{
+    Q_ASSERT(value.isValid());
+    if (!value.isValid()) {
+        return;
+    }
+    if (tintColor() == value) {
+        return;
+    }
+    Q_D(BackdropBlur);
+    d->m_tintColor = value;
+    Q_EMIT tintColorChanged();
+    Q_EMIT shouldRepaint();
+}
+
+void BackdropBlur::setSource(const QImage &image)
+{
+    Q_D(BackdropBlur);
+    d->setSource(image);
+}
+
+bool BackdropBlur::updateSource(const QImage &image, const QPoint &pos)
+{
+    Q_D(BackdropBlur);
+    return d->updateSource(image, pos);
+}
+
+void BackdropBlur::clearSource()
+{
+    Q_D(BackdropBlur);
+    d->setSource({});
+}
+
+void BackdropBlur::paint(QPainter *painter, const QRect &rect)
+{
+    Q_D(BackdropBlur);
+    d->paint(painter, rect);
+}
+
+FRAMELESSHELPER_END_NAMESPACE
@@ -0,0 +1 @@
+#include "../../include/FramelessHelper/Core/backdropblur.h"
@@ -0,0 +1 @@
+#include "../../include/FramelessHelper/Core/private/backdropblur_p.h"
@@ -70,7 +70,17 @@ static const struct
     {FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_FORCE_NON_NATIVE_BACKGROUND_BLUR"),
       FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/ForceNonNativeBackgroundBlur")},
     {FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_DISABLE_LAZY_INITIALIZATION_FOR_MICA_MATERIAL"),
-      FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/DisableLazyInitializationForMicaMaterial")}
+      FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/DisableLazyInitializationForMicaMaterial")},
+    {FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_DISABLE_WALLPAPER_CACHE_FOR_MICA_MATERIAL"),
+      FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/DisableWallpaperCacheForMicaMaterial")},
+    {FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_USE_EXACT_BLUR_FOR_MICA_MATERIAL"),
+      FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/UseExactBlurForMicaMaterial")},
+    {FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_SHARE_WALLPAPER_BETWEEN_PROCESSES_FOR_MICA_MATERIAL"),
+      FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/ShareWallpaperBetweenProcessesForMicaMaterial")},
+    {FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_USE_PROGRESSIVE_BLUR_FOR_MICA_MATERIAL"),
+      FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/UseProgressiveBlurForMicaMaterial")},
+    {FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_ENABLE_WINDOW_SHADOW_ON_LINUX"),
+      FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/EnableWindowShadowOnLinux")}
 };
 
 static constexpr const auto OptionCount = std::size(OptionsTable);
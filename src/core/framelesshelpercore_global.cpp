@@ -233,6 +233,8 @@ void initialize()
     qRegisterMetaType<DpiAwareness>();
 #  endif
     qRegisterMetaType<WindowCornerStyle>();
+    qRegisterMetaType<BlurBackend>();
+    qRegisterMetaType<MicaMaterialQuality>();
     qRegisterMetaType<VersionNumber>();
     qRegisterMetaType<SystemParameters>();
     qRegisterMetaType<VersionInfo>();
@@ -291,12 +291,13 @@ void FramelessManagerPrivate::notifySystemThemeHasChangedOrNot()
     }
 }
 
-void FramelessManagerPrivate::notifyWallpaperHasChangedOrNot()
+void FramelessManagerPrivate::notifyWallpaperHasChangedOrNot(const bool force)
 {
     const QMutexLocker locker(&g_helper()->mutex);
     const QString currentWallpaper = Utils::getWallpaperFilePath();
     const WallpaperAspectStyle currentWallpaperAspectStyle = Utils::getWallpaperAspectStyle();
-    bool notify = false;
+    // The file itself may have been modified, even if the path is still the same.
+    bool notify = force;
     if (m_wallpaper != currentWallpaper) {
         m_wallpaper = currentWallpaper;
         notify = true;
@@ -359,6 +360,10 @@ void FramelessManagerPrivate::initialize()
         });
     }
 #endif // (QT_VERSION >= QT_VERSION_CHECK(6, 5, 0))
+#ifdef Q_OS_LINUX
+    // Windows tells us through WM_SETTINGCHANGE, on Linux we have to watch the files ourself.
+    Utils::registerWallpaperChangeNotification();
+#endif // Q_OS_LINUX
     static bool flagSet = false;
     if (!flagSet) {
         flagSet = true;
@@ -29,16 +29,61 @@
 #include "framelessconfig_p.h"
 #include <QtCore/qsysinfo.h>
 #include <QtCore/qmutex.h>
-#include <QtGui/qpixmap.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qthreadpool.h>
+#include <QtCore/qrunnable.h>
+#include <QtCore/qsemaphore.h>
+#include <QtCore/qwaitcondition.h>
+#include <QtCore/qvector.h>
+#include <QtCore/qcoreapplication.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qsavefile.h>
+#include <QtCore/qsharedmemory.h>
+#include <QtCore/qdatastream.h>
+#include <QtCore/qdatetime.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qset.h>
+#include <QtCore/qstandardpaths.h>
+#include <QtCore/qcryptographichash.h>
 #include <QtGui/qimage.h>
+#include <QtGui/qimagereader.h>
 #include <QtGui/qpainter.h>
 #include <QtGui/qscreen.h>
 #include <QtGui/qguiapplication.h>
+#include <cstring>
+#include <algorithm>
+#ifdef Q_OS_WINDOWS
+#  include "framelesshelper_windows.h"
+#else
+#  include <signal.h>
+#  include <cerrno>
+#endif
 #ifndef FRAMELESSHELPER_CORE_NO_PRIVATE
+#  include <QtCore/private/qsimd_p.h>
 #  include <QtGui/private/qguiapplication_p.h>
 #  include <QtGui/private/qmemrotate_p.h>
 #endif // FRAMELESSHELPER_CORE_NO_PRIVATE
 
+#ifndef FRAMELESSHELPER_CORE_NO_PRIVATE
+#  if (defined(Q_PROCESSOR_X86) && QT_COMPILER_SUPPORTS_HERE(SSE2))
+#    define FRAMELESSHELPER_BLUR_SSE2
+#  endif
+#  if (defined(Q_PROCESSOR_X86) && QT_COMPILER_SUPPORTS_HERE(AVX2))
+#    define FRAMELESSHELPER_BLUR_AVX2
+#  endif
+#  if (defined(FRAMELESSHELPER_BLUR_SSE2) || defined(FRAMELESSHELPER_BLUR_AVX2))
+#    include <immintrin.h>
+#  endif
+#  if ((defined(__ARM_NEON) || defined(__ARM_NEON__)) && (Q_BYTE_ORDER == Q_LITTLE_ENDIAN))
+#    include <arm_neon.h>
+#    define FRAMELESSHELPER_BLUR_NEON
+#  endif
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+
 #ifndef FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
 // The "Q_INIT_RESOURCE()" macro can't be used within a namespace,
 // so we wrap it into a separate function outside of the namespace and
@@ -71,22 +116,156 @@ using namespace Global;
 [[maybe_unused]] static constexpr const qreal kDefaultTintOpacity = 0.7;
 [[maybe_unused]] static constexpr const qreal kDefaultNoiseOpacity = 0.04;
 [[maybe_unused]] static constexpr const qreal kDefaultBlurRadius = 128.0;
+[[maybe_unused]] static constexpr const int kDefaultBlurPasses = 2;
+// The "Auto" quality steps down once generating a wallpaper takes longer than this.
+[[maybe_unused]] static constexpr const qint64 kAutoQualityStepDownThreshold = 250; // ms
 
 [[maybe_unused]] static Q_CONSTEXPR2 const QColor kDefaultSystemLightColor2 = {243, 243, 243}; // #F3F3F3
 
+FRAMELESSHELPER_STRING_CONSTANT2(WallpaperCacheDirName, "FramelessHelper/MicaMaterial")
+FRAMELESSHELPER_STRING_CONSTANT2(WallpaperCacheFileSuffix, ".wallpaper")
+FRAMELESSHELPER_STRING_CONSTANT2(WallpaperCacheFileFilter, "*.wallpaper")
+[[maybe_unused]] static constexpr const quint32 kWallpaperCacheMagic = 0x4D494341; // "MICA"
+[[maybe_unused]] static constexpr const quint32 kWallpaperCacheVersion = 1;
+[[maybe_unused]] static constexpr const qsizetype kMaximumWallpaperCacheFileCount = 5;
+[[maybe_unused]] static constexpr const qsizetype kMaximumMicaBrushCacheSize = 32;
+FRAMELESSHELPER_STRING_CONSTANT2(SharedWallpaperKeyPrefix, "org.wangwenx190.FramelessHelper.MicaMaterial.")
+[[maybe_unused]] static constexpr const quint32 kSharedWallpaperFailureMagic = 0x4641494C; // "FAIL"
+[[maybe_unused]] static constexpr const int kSharedWallpaperPollInterval = 20; // ms
+[[maybe_unused]] static constexpr const int kSharedWallpaperTimeout = 10000; // ms
+[[maybe_unused]] static constexpr const int kDefaultWallpaperDownscaleFactor = 4;
+[[maybe_unused]] static constexpr const int kDefaultMemoryBudget = 32; // MiB
+// The first, very coarse level of the progressive blur, see "generatePreviewWallpaper()".
+[[maybe_unused]] static constexpr const int kPreviewWallpaperScale = 32;
+
 #ifndef FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
 FRAMELESSHELPER_STRING_CONSTANT2(NoiseImageFilePath, ":/org.wangwenx190.FramelessHelper/resources/images/noise.png")
 #endif // FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
 
+struct ScreenWallpaperData
+{
+    // The blurred wallpaper, at a fraction of the native resolution of the screen.
+    // It has no detail left, so it's simply scaled up bilinearly when painted.
+    QImage image = {};
+    // Not stored in the image itself: changing it would detach the image,
+    // which may be a read-only mapping of a disk cache file.
+    qreal imageDevicePixelRatio = 0.0;
+    // What the latest request was made for.
+    QSize size = {};
+    qreal devicePixelRatio = 0.0;
+    // The size the wallpaper is stored at, a fraction of 'size'.
+    QSize storageSize = {};
+    int generation = 0;
+};
+
+/*
+    Everything the painters need to know about the blurred wallpapers. A snapshot
+    is never modified once it has been published, any change is made on a copy
+    which then replaces it, so holding a reference is all a painter needs.
+ */
+// The blurred wallpapers are generated per screen and per quality, see "wallpaperQualityKey()".
+using WallpaperKey = QPair<const QScreen *, quint32>;
+
+struct ScreenInfo
+{
+    QRect geometry = {};
+    qreal devicePixelRatio = 0.0;
+};
+
+struct WallpaperSnapshot
+{
+    // Only the screens which are hosting a Mica surface have an entry here.
+    QHash<WallpaperKey, ScreenWallpaperData> wallpapers = {};
+    // All screens, as the GUI thread saw them last (see "updateScreenSnapshot()"):
+    // the painters may run on another thread, where QScreen can't be used.
+    QHash<const QScreen *, ScreenInfo> screens = {};
+    int generation = 0;
+};
+
 struct MicaMaterialData
 {
     QMutex mutex;
-    QPixmap blurredWallpaper = {};
-    bool graphicsResourcesReady = false;
+    // Only replaced while holding the mutex, see publishWallpaperSnapshot().
+    WallpaperSnapshotPtr wallpaperSnapshot = QSharedPointer<WallpaperSnapshot>::create();
+    // The generation of the snapshot above. Painters compare it with the one of
+    // their own reference, so they only need the mutex once after each change.
+    QAtomicInt wallpaperSnapshotGeneration = 0;
+    // Set once, checked on every paint: without taking the mutex.
+    QAtomicInt graphicsResourcesReady = 0;
+    // Increased for every wallpaper generation request. A background job
+    // whose generation number is no longer the one of its screen has been cancelled.
+    QAtomicInt wallpaperGeneration = 0;
+    // The subscribers of the wallpaper generator, they are all notified once
+    // a new blurred wallpaper is ready, whoever requested it.
+    QList<QPointer<MicaMaterialPrivate>> instances = {};
+    // The wallpaper generator listens to the wallpaper changes once for the
+    // whole process, see setupWallpaperGenerator().
+    bool wallpaperGeneratorReady = false;
+    // Only accessed on the GUI thread.
+    bool wallpaperRegenerationPending = false;
+    // The tier the "Auto" quality currently stands for, see maybeLowerAutoQuality().
+    QAtomicInt autoQuality = int(MicaMaterialQuality::High);
+    // The Mica brushes are shared by all instances, see micaBrushKey().
+    // The most recently used one comes last, see cachedMicaBrush().
+    QList<QPair<quint64, QBrush>> micaBrushes = {};
+    // The blurred wallpapers generated lately, keyed by "wallpaperCacheKey()",
+    // the most recently used one comes last. See rememberRecentWallpaper().
+    QList<QPair<QString, QImage>> recentWallpapers = {};
 };
 
 Q_GLOBAL_STATIC(MicaMaterialData, g_micaMaterialData)
 
+// The mutex must be locked.
+static inline void publishWallpaperSnapshot(QHash<WallpaperKey, ScreenWallpaperData> &&wallpapers,
+    QHash<const QScreen *, ScreenInfo> &&screens)
+{
+    const auto snapshot = QSharedPointer<WallpaperSnapshot>::create();
+    snapshot->wallpapers = std::move(wallpapers);
+    snapshot->screens = std::move(screens);
+    snapshot->generation = (g_micaMaterialData()->wallpaperSnapshotGeneration.loadAcquire() + 1);
+    g_micaMaterialData()->wallpaperSnapshot = snapshot;
+    g_micaMaterialData()->wallpaperSnapshotGeneration.storeRelease(snapshot->generation);
+}
+
+// The mutex must be locked. Same as above, the screens stay the same.
+static inline void publishWallpaperSnapshot(QHash<WallpaperKey, ScreenWallpaperData> &&wallpapers)
+{
+    QHash<const QScreen *, ScreenInfo> screens = g_micaMaterialData()->wallpaperSnapshot->screens;
+    publishWallpaperSnapshot(std::move(wallpapers), std::move(screens));
+}
+
+// Doesn't lock anything unless a new snapshot has been published since the last call.
+static inline void updateWallpaperSnapshot(WallpaperSnapshotPtr &snapshot)
+{
+    if (g_micaMaterialData.isDestroyed()) {
+        return;
+    }
+    if (snapshot && (snapshot->generation == g_micaMaterialData()->wallpaperSnapshotGeneration.loadAcquire())) {
+        return;
+    }
+    const QMutexLocker locker(&g_micaMaterialData()->mutex);
+    snapshot = g_micaMaterialData()->wallpaperSnapshot;
+}
+
+class FunctionRunnable : public QRunnable
+{
+public:
+    explicit FunctionRunnable(const std::function<void()> &function) : m_function(function)
+    {
+        setAutoDelete(true);
+    }
+
+    ~FunctionRunnable() override = default;
+
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void()> m_function = nullptr;
+};
+
 #ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
 [[nodiscard]] static inline Qt::Alignment visualAlignment
     (const Qt::LayoutDirection direction, const Qt::Alignment alignment)
@@ -149,9 +328,8 @@ static inline void qt_blurinner_alphaOnly(uchar *bptr, int &z, const int alpha)
 }
 
 template<const int aprec, const int zprec, const bool alphaOnly>
-static inline void qt_blurrow(QImage &im, const int line, const int alpha)
+static inline void qt_blurrow(const QImage &im, uchar *bptr, const int alpha)
 {
-    uchar *bptr = im.scanLine(line);
 
     int zR = 0, zG = 0, zB = 0, zA = 0;
 
@@ -189,158 +367,802 @@ static inline void qt_blurrow(QImage &im, const int line, const int alpha)
     }
 }
 
+// Same as "qt_blurinner()", but for opaque (Format_RGB32) images: the alpha
+// channel is not blurred at all, it's always 0xFF.
+template<const int aprec, const int zprec>
+static inline void qt_blurinner_opaque(uchar *bptr, int &zR, int &zG, int &zB, const int alpha)
+{
+    const auto pixel = reinterpret_cast<QRgb *>(bptr);
+
+#define Z_MASK (0xff << zprec)
+    const int R_zprec = (qt_static_shift<zprec - 16>(*pixel) & Z_MASK);
+    const int G_zprec = (qt_static_shift<zprec - 8>(*pixel)  & Z_MASK);
+    const int B_zprec = (qt_static_shift<zprec>(*pixel)      & Z_MASK);
+#undef Z_MASK
+
+    const int zR_zprec = (zR >> aprec);
+    const int zG_zprec = (zG >> aprec);
+    const int zB_zprec = (zB >> aprec);
+
+    zR += (alpha * (R_zprec - zR_zprec));
+    zG += (alpha * (G_zprec - zG_zprec));
+    zB += (alpha * (B_zprec - zB_zprec));
+
+#define ZA_MASK (0xff << (zprec + aprec))
+    *pixel = (0xff000000
+        | qt_static_shift<16 - zprec - aprec>(zR & ZA_MASK)
+        | qt_static_shift<8 - zprec - aprec>(zG & ZA_MASK)
+        | qt_static_shift<-zprec - aprec>(zB & ZA_MASK));
+#undef ZA_MASK
+}
+
+template<const int aprec, const int zprec>
+static inline void qt_blurrow_opaque(uchar *bptr, const int width, const int alpha)
+{
+    int zR = 0, zG = 0, zB = 0;
+
+    for (int index = 0; index != width; ++index) {
+        qt_blurinner_opaque<aprec, zprec>(bptr, zR, zG, zB, alpha);
+        bptr += 4;
+    }
+
+    bptr -= 4;
+
+    for (int index = (width - 2); index >= 0; --index) {
+        bptr -= 4;
+        qt_blurinner_opaque<aprec, zprec>(bptr, zR, zG, zB, alpha);
+    }
+}
+
 /*
-*  expblur(QImage &img, int radius)
-*
-*  Based on exponential blur algorithm by Jani Huhtanen
-*
-*  In-place blur of image 'img' with kernel
-*  of approximate radius 'radius'.
+*  SIMD versions of "qt_blurrow()" for 32-bit images.
 *
-*  Blurs with two sided exponential impulse
-*  response.
+*  The four channels of a pixel live in four 32-bit lanes and go through
+*  exactly the same integer arithmetic as the scalar code, so the result
+*  is bit-for-bit identical to "qt_blurinner()" ("qt_blurinner_opaque()"
+*  for opaque images, whose alpha lane is simply overwritten with 0xFF).
+*  The exponential filter is a recurrence along the row, so instead of
+*  vectorizing within a row we blur several independent rows at the same
+*  time to hide the latency of the dependency chain.
 *
-*  aprec = precision of alpha parameter
-*  in fixed-point format 0.aprec
+*  The recurrence never leaves [0, 255 << (zprec + aprec)] (plus rounding
+*  slack below one output step), so the arithmetic right shift followed by
+*  a saturating pack gives the same bits as the masks of the scalar code.
 *
-*  zprec = precision of state parameters
-*  zR,zG,zB and zA in fp format 8.zprec
+*  The "qt_blurcolumns_*()" kernels blur the image vertically in place. They
+*  walk down a tile of adjacent columns row by row, so every access touches a
+*  few contiguous bytes of one scanline and each column keeps its own state,
+*  which replaces the old rotate, blur rows, rotate back sequence and its
+*  full size temporary image. A column is traversed bottom-up first and then
+*  top-down, the same order the rows of the rotated image were blurred in,
+*  so the result doesn't change at all.
 */
-template<const int aprec, const int zprec, const bool alphaOnly>
-static inline void expblur(QImage &img, qreal radius, const bool improvedQuality = false, const int transposed = 0)
+using BlurRowsFunction = void(*)(uchar *bits, const qsizetype bytesPerLine,
+    const int rowCount, const int width, const int alpha, const quint32 fill);
+using BlurColumnsFunction = void(*)(uchar *bits, const qsizetype bytesPerLine,
+    const int columnCount, const int height, const int alpha, const quint32 fill);
+
+struct BlurKernels
 {
-    Q_ASSERT((img.format() == QImage::Format_ARGB32_Premultiplied)
-             || (img.format() == QImage::Format_RGB32)
-             || (img.format() == QImage::Format_Indexed8)
-             || (img.format() == QImage::Format_Grayscale8));
-    if ((img.format() != QImage::Format_ARGB32_Premultiplied)
-        && (img.format() != QImage::Format_RGB32)
-        && (img.format() != QImage::Format_Indexed8)
-        && (img.format() != QImage::Format_Grayscale8)) {
-        return;
-    }
+    BlurRowsFunction rows = nullptr;
+    BlurColumnsFunction columns = nullptr;
+};
 
-    // halve the radius if we're using two passes
-    if (improvedQuality) {
-        radius *= 0.5;
+template<const int aprec, const int zprec>
+static inline void qt_blurrows_scalar(uchar *bits, const qsizetype bytesPerLine,
+    const int rowCount, const int width, const int alpha, const quint32 fill)
+{
+    for (int row = 0; row != rowCount; ++row, bits += bytesPerLine) {
+        if (fill) {
+            qt_blurrow_opaque<aprec, zprec>(bits, width, alpha);
+            continue;
+        }
+        uchar *bptr = bits;
+        int zR = 0, zG = 0, zB = 0, zA = 0;
+        for (int index = 0; index != width; ++index, bptr += 4) {
+            qt_blurinner<aprec, zprec>(bptr, zR, zG, zB, zA, alpha);
+        }
+        bptr -= 4;
+        for (int index = (width - 2); index >= 0; --index) {
+            bptr -= 4;
+            qt_blurinner<aprec, zprec>(bptr, zR, zG, zB, zA, alpha);
+        }
     }
+}
 
-    // choose the alpha such that pixels at radius distance from a fully
-    // saturated pixel will have an alpha component of no greater than
-    // the cutOffIntensity
-    static constexpr const qreal cutOffIntensity = 2.0;
-    const int alpha = ((radius <= qreal(1e-5)) ? ((1 << aprec) - 1) :
-        std::round((1 << aprec) * (1 - qPow(cutOffIntensity / qreal(255), qreal(1) / radius))));
-
-    int img_height = img.height();
-    for (int row = 0; row != img_height; ++row) {
-        for (int i = 0; i <= int(improvedQuality); ++i) {
-            qt_blurrow<aprec, zprec, alphaOnly>(img, row, alpha);
+template<const int aprec, const int zprec, const int lanes>
+static inline void qt_blurcolumns_scalar_impl(uchar *bits, const qsizetype bytesPerLine,
+    const int height, const int alpha, const quint32 fill)
+{
+    int z[lanes][4] = {};
+    const auto blurLine = [&z, alpha, fill](uchar *line){
+        for (int lane = 0; lane != lanes; ++lane, line += 4) {
+            if (fill) {
+                qt_blurinner_opaque<aprec, zprec>(line, z[lane][0], z[lane][1], z[lane][2], alpha);
+            } else {
+                qt_blurinner<aprec, zprec>(line, z[lane][0], z[lane][1], z[lane][2], z[lane][3], alpha);
+            }
         }
+    };
+    for (int row = (height - 1); row >= 0; --row) {
+        blurLine(bits + (bytesPerLine * row));
     }
+    for (int row = 1; row < height; ++row) {
+        blurLine(bits + (bytesPerLine * row));
+    }
+}
 
-    QImage temp(img.height(), img.width(), img.format());
-    temp.setDevicePixelRatio(img.devicePixelRatio());
+template<const int aprec, const int zprec>
+static inline void qt_blurcolumns_scalar(uchar *bits, const qsizetype bytesPerLine,
+    const int columnCount, const int height, const int alpha, const quint32 fill)
+{
+    static constexpr const int kColumnsPerTile = 8;
+    int column = 0;
+    for (; (column + kColumnsPerTile) <= columnCount; column += kColumnsPerTile, bits += (kColumnsPerTile * 4)) {
+        qt_blurcolumns_scalar_impl<aprec, zprec, kColumnsPerTile>(bits, bytesPerLine, height, alpha, fill);
+    }
+    for (; column != columnCount; ++column, bits += 4) {
+        qt_blurcolumns_scalar_impl<aprec, zprec, 1>(bits, bytesPerLine, height, alpha, fill);
+    }
+}
 
-    if (transposed >= 0) {
-        if (img.depth() == 8) {
-            qt_memrotate270(reinterpret_cast<const quint8 *>(img.bits()),
-                            img.width(), img.height(), img.bytesPerLine(),
-                            reinterpret_cast<quint8 *>(temp.bits()),
-                            temp.bytesPerLine());
-        } else {
-            qt_memrotate270(reinterpret_cast<const quint32 *>(img.bits()),
-                            img.width(), img.height(), img.bytesPerLine(),
-                            reinterpret_cast<quint32 *>(temp.bits()),
-                            temp.bytesPerLine());
+#ifdef FRAMELESSHELPER_BLUR_SSE2
+[[nodiscard]] static inline __m128i qt_mullo_epi32_sse2(const __m128i a, const __m128i b)
+{
+#  ifdef __SSE4_1__
+    return _mm_mullo_epi32(a, b);
+#  else
+    // The low 32 bits of a product don't depend on the signedness of the operands.
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#  endif
+}
+
+template<const int aprec, const int zprec>
+static inline void qt_blurinner_sse2(quint32 *pixel, __m128i &z, const __m128i alpha, const quint32 fill)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i source = _mm_cvtsi32_si128(int(*pixel));
+    const __m128i value = _mm_slli_epi32(_mm_unpacklo_epi16(_mm_unpacklo_epi8(source, zero), zero), zprec);
+    z = _mm_add_epi32(z, qt_mullo_epi32_sse2(alpha, _mm_sub_epi32(value, _mm_srai_epi32(z, aprec))));
+    __m128i result = _mm_srai_epi32(z, zprec + aprec);
+    result = _mm_packs_epi32(result, result);
+    result = _mm_packus_epi16(result, result);
+    *pixel = (quint32(_mm_cvtsi128_si32(result)) | fill);
+}
+
+template<const int aprec, const int zprec, const int lanes>
+static inline void qt_blurrows_sse2_impl(uchar *bits, const qsizetype bytesPerLine,
+    const int width, const __m128i alpha, const quint32 fill)
+{
+    quint32 *lines[lanes] = {};
+    __m128i z[lanes] = {};
+    for (int lane = 0; lane != lanes; ++lane) {
+        lines[lane] = reinterpret_cast<quint32 *>(bits + (bytesPerLine * lane));
+        z[lane] = _mm_setzero_si128();
+    }
+    for (int index = 0; index != width; ++index) {
+        for (int lane = 0; lane != lanes; ++lane) {
+            qt_blurinner_sse2<aprec, zprec>(lines[lane] + index, z[lane], alpha, fill);
         }
-    } else {
-        if (img.depth() == 8) {
-            qt_memrotate90(reinterpret_cast<const quint8 *>(img.bits()),
-                           img.width(), img.height(), img.bytesPerLine(),
-                           reinterpret_cast<quint8 *>(temp.bits()),
-                           temp.bytesPerLine());
-        } else {
-            qt_memrotate90(reinterpret_cast<const quint32 *>(img.bits()),
-                           img.width(), img.height(), img.bytesPerLine(),
-                           reinterpret_cast<quint32 *>(temp.bits()),
-                           temp.bytesPerLine());
+    }
+    for (int index = (width - 2); index >= 0; --index) {
+        for (int lane = 0; lane != lanes; ++lane) {
+            qt_blurinner_sse2<aprec, zprec>(lines[lane] + index, z[lane], alpha, fill);
         }
     }
+}
 
-    img_height = temp.height();
-    for (int row = 0; row != img_height; ++row) {
-        for (int i = 0; i <= int(improvedQuality); ++i) {
-            qt_blurrow<aprec, zprec, alphaOnly>(temp, row, alpha);
-        }
+template<const int aprec, const int zprec>
+static inline void qt_blurrows_sse2(uchar *bits, const qsizetype bytesPerLine,
+    const int rowCount, const int width, const int alpha, const quint32 fill)
+{
+    static constexpr const int kRowsPerBatch = 4;
+    const __m128i alphaVector = _mm_set1_epi32(alpha);
+    int row = 0;
+    for (; (row + kRowsPerBatch) <= rowCount; row += kRowsPerBatch, bits += (bytesPerLine * kRowsPerBatch)) {
+        qt_blurrows_sse2_impl<aprec, zprec, kRowsPerBatch>(bits, bytesPerLine, width, alphaVector, fill);
     }
+    for (; row != rowCount; ++row, bits += bytesPerLine) {
+        qt_blurrows_sse2_impl<aprec, zprec, 1>(bits, bytesPerLine, width, alphaVector, fill);
+    }
+}
 
-    if (transposed == 0) {
-        if (img.depth() == 8) {
-            qt_memrotate90(reinterpret_cast<const quint8 *>(temp.bits()),
-                           temp.width(), temp.height(), temp.bytesPerLine(),
-                           reinterpret_cast<quint8 *>(img.bits()),
-                           img.bytesPerLine());
-        } else {
-            qt_memrotate90(reinterpret_cast<const quint32 *>(temp.bits()),
-                           temp.width(), temp.height(), temp.bytesPerLine(),
-                           reinterpret_cast<quint32 *>(img.bits()),
-                           img.bytesPerLine());
+template<const int aprec, const int zprec, const int lanes>
+static inline void qt_blurcolumns_sse2_impl(uchar *bits, const qsizetype bytesPerLine,
+    const int height, const __m128i alpha, const quint32 fill)
+{
+    __m128i z[lanes] = {};
+    for (int lane = 0; lane != lanes; ++lane) {
+        z[lane] = _mm_setzero_si128();
+    }
+    for (int row = (height - 1); row >= 0; --row) {
+        const auto line = reinterpret_cast<quint32 *>(bits + (bytesPerLine * row));
+        for (int lane = 0; lane != lanes; ++lane) {
+            qt_blurinner_sse2<aprec, zprec>(line + lane, z[lane], alpha, fill);
+        }
+    }
+    for (int row = 1; row < height; ++row) {
+        const auto line = reinterpret_cast<quint32 *>(bits + (bytesPerLine * row));
+        for (int lane = 0; lane != lanes; ++lane) {
+            qt_blurinner_sse2<aprec, zprec>(line + lane, z[lane], alpha, fill);
         }
-    } else {
-        img = temp;
     }
 }
 
-#define AVG(a,b)  ( ((((a)^(b)) & 0xfefefefeUL) >> 1) + ((a)&(b)) )
-#define AVG16(a,b)  ( ((((a)^(b)) & 0xf7deUL) >> 1) + ((a)&(b)) )
-
-[[nodiscard]] static inline QImage qt_halfScaled(const QImage &source)
+template<const int aprec, const int zprec>
+static inline void qt_blurcolumns_sse2(uchar *bits, const qsizetype bytesPerLine,
+    const int columnCount, const int height, const int alpha, const quint32 fill)
 {
-    if ((source.width() < 2) || (source.height() < 2)) {
-        return {};
+    static constexpr const int kColumnsPerTile = 8;
+    const __m128i alphaVector = _mm_set1_epi32(alpha);
+    int column = 0;
+    for (; (column + kColumnsPerTile) <= columnCount; column += kColumnsPerTile, bits += (kColumnsPerTile * 4)) {
+        qt_blurcolumns_sse2_impl<aprec, zprec, kColumnsPerTile>(bits, bytesPerLine, height, alphaVector, fill);
     }
+    for (; column != columnCount; ++column, bits += 4) {
+        qt_blurcolumns_sse2_impl<aprec, zprec, 1>(bits, bytesPerLine, height, alphaVector, fill);
+    }
+}
+#endif // FRAMELESSHELPER_BLUR_SSE2
 
-    QImage srcImage = source;
-
-    if ((source.format() == QImage::Format_Indexed8)
-        || (source.format() == QImage::Format_Grayscale8)) {
-        // assumes grayscale
-        QImage dest(source.width() / 2, source.height() / 2, srcImage.format());
-        dest.setDevicePixelRatio(source.devicePixelRatio());
+#ifdef FRAMELESSHELPER_BLUR_AVX2
+// Two rows share one 256-bit register: the low half holds a pixel of the
+// first row and the high half holds the pixel at the same column of the
+// second row.
+template<const int aprec, const int zprec>
+static inline void QT_FUNCTION_TARGET(AVX2) qt_blurinner_avx2(quint32 *pixel1, quint32 *pixel2, __m256i &z, const __m256i alpha, const quint32 fill)
+{
+    const __m128i source = _mm_unpacklo_epi32(_mm_cvtsi32_si128(int(*pixel1)), _mm_cvtsi32_si128(int(*pixel2)));
+    const __m256i value = _mm256_slli_epi32(_mm256_cvtepu8_epi32(source), zprec);
+    z = _mm256_add_epi32(z, _mm256_mullo_epi32(alpha, _mm256_sub_epi32(value, _mm256_srai_epi32(z, aprec))));
+    const __m256i shifted = _mm256_srai_epi32(z, zprec + aprec);
+    __m128i result = _mm_packs_epi32(_mm256_castsi256_si128(shifted), _mm256_extracti128_si256(shifted, 1));
+    result = _mm_packus_epi16(result, result);
+    *pixel1 = (quint32(_mm_cvtsi128_si32(result)) | fill);
+    *pixel2 = (quint32(_mm_cvtsi128_si32(_mm_srli_si128(result, 4))) | fill);
+}
 
-        auto src = reinterpret_cast<const uchar *>(const_cast<const QImage &>(srcImage).bits());
-        const qsizetype sx = srcImage.bytesPerLine();
-        const qsizetype sx2 = (sx << 1);
+template<const int aprec, const int zprec, const int lanes>
+static inline void QT_FUNCTION_TARGET(AVX2) qt_blurrows_avx2_impl(uchar *bits, const qsizetype bytesPerLine,
+    const int width, const __m256i alpha, const quint32 fill)
+{
+    quint32 *lines[lanes * 2] = {};
+    __m256i z[lanes] = {};
+    for (int lane = 0; lane != lanes; ++lane) {
+        lines[lane * 2] = reinterpret_cast<quint32 *>(bits + (bytesPerLine * (lane * 2)));
+        lines[(lane * 2) + 1] = reinterpret_cast<quint32 *>(bits + (bytesPerLine * ((lane * 2) + 1)));
+        z[lane] = _mm256_setzero_si256();
+    }
+    for (int index = 0; index != width; ++index) {
+        for (int lane = 0; lane != lanes; ++lane) {
+            qt_blurinner_avx2<aprec, zprec>(lines[lane * 2] + index, lines[(lane * 2) + 1] + index, z[lane], alpha, fill);
+        }
+    }
+    for (int index = (width - 2); index >= 0; --index) {
+        for (int lane = 0; lane != lanes; ++lane) {
+            qt_blurinner_avx2<aprec, zprec>(lines[lane * 2] + index, lines[(lane * 2) + 1] + index, z[lane], alpha, fill);
+        }
+    }
+}
 
-        auto dst = reinterpret_cast<uchar *>(dest.bits());
-        const qsizetype dx = dest.bytesPerLine();
-        const int ww = dest.width();
-        const int hh = dest.height();
+template<const int aprec, const int zprec>
+static void QT_FUNCTION_TARGET(AVX2) qt_blurrows_avx2(uchar *bits, const qsizetype bytesPerLine,
+    const int rowCount, const int width, const int alpha, const quint32 fill)
+{
+    static constexpr const int kRegistersPerBatch = 4;
+    static constexpr const int kRowsPerBatch = (kRegistersPerBatch * 2);
+    const __m256i alphaVector = _mm256_set1_epi32(alpha);
+    int row = 0;
+    for (; (row + kRowsPerBatch) <= rowCount; row += kRowsPerBatch, bits += (bytesPerLine * kRowsPerBatch)) {
+        qt_blurrows_avx2_impl<aprec, zprec, kRegistersPerBatch>(bits, bytesPerLine, width, alphaVector, fill);
+    }
+    for (; (row + 2) <= rowCount; row += 2, bits += (bytesPerLine * 2)) {
+        qt_blurrows_avx2_impl<aprec, zprec, 1>(bits, bytesPerLine, width, alphaVector, fill);
+    }
+    if (row != rowCount) {
+        qt_blurrows_scalar<aprec, zprec>(bits, bytesPerLine, 1, width, alpha, fill);
+    }
+}
 
-        for (int y = hh; y; --y, dst += dx, src += sx2) {
-            const uchar *p1 = src;
-            const uchar *p2 = (src + sx);
-            uchar *q = dst;
-            for (int x = ww; x; --x, ++q, p1 += 2, p2 += 2) {
-                *q = (((int(p1[0]) + int(p1[1]) + int(p2[0]) + int(p2[1])) + 2) >> 2);
-            }
+// Here the two halves of a register hold two neighbouring columns instead.
+template<const int aprec, const int zprec, const int lanes>
+static inline void QT_FUNCTION_TARGET(AVX2) qt_blurcolumns_avx2_impl(uchar *bits, const qsizetype bytesPerLine,
+    const int height, const __m256i alpha, const quint32 fill)
+{
+    __m256i z[lanes] = {};
+    for (int lane = 0; lane != lanes; ++lane) {
+        z[lane] = _mm256_setzero_si256();
+    }
+    for (int row = (height - 1); row >= 0; --row) {
+        const auto line = reinterpret_cast<quint32 *>(bits + (bytesPerLine * row));
+        for (int lane = 0; lane != lanes; ++lane) {
+            qt_blurinner_avx2<aprec, zprec>(line + (lane * 2), line + (lane * 2) + 1, z[lane], alpha, fill);
         }
-
-        return dest;
     }
-    if (source.format() == QImage::Format_ARGB8565_Premultiplied) {
-        QImage dest(source.width() / 2, source.height() / 2, srcImage.format());
-        dest.setDevicePixelRatio(source.devicePixelRatio());
+    for (int row = 1; row < height; ++row) {
+        const auto line = reinterpret_cast<quint32 *>(bits + (bytesPerLine * row));
+        for (int lane = 0; lane != lanes; ++lane) {
+            qt_blurinner_avx2<aprec, zprec>(line + (lane * 2), line + (lane * 2) + 1, z[lane], alpha, fill);
+        }
+    }
+}
 
-        auto src = reinterpret_cast<const uchar *>(const_cast<const QImage &>(srcImage).bits());
-        const qsizetype sx = srcImage.bytesPerLine();
-        const qsizetype sx2 = (sx << 1);
+template<const int aprec, const int zprec>
+static void QT_FUNCTION_TARGET(AVX2) qt_blurcolumns_avx2(uchar *bits, const qsizetype bytesPerLine,
+    const int columnCount, const int height, const int alpha, const quint32 fill)
+{
+    // 16 columns of 32-bit pixels make up exactly one 64-byte cache line.
+    static constexpr const int kRegistersPerTile = 8;
+    static constexpr const int kColumnsPerTile = (kRegistersPerTile * 2);
+    const __m256i alphaVector = _mm256_set1_epi32(alpha);
+    int column = 0;
+    for (; (column + kColumnsPerTile) <= columnCount; column += kColumnsPerTile, bits += (kColumnsPerTile * 4)) {
+        qt_blurcolumns_avx2_impl<aprec, zprec, kRegistersPerTile>(bits, bytesPerLine, height, alphaVector, fill);
+    }
+    for (; (column + 2) <= columnCount; column += 2, bits += (2 * 4)) {
+        qt_blurcolumns_avx2_impl<aprec, zprec, 1>(bits, bytesPerLine, height, alphaVector, fill);
+    }
+    if (column != columnCount) {
+        qt_blurcolumns_scalar<aprec, zprec>(bits, bytesPerLine, 1, height, alpha, fill);
+    }
+}
+#endif // FRAMELESSHELPER_BLUR_AVX2
 
-        auto dst = reinterpret_cast<uchar *>(dest.bits());
-        const qsizetype dx = dest.bytesPerLine();
-        const int ww = dest.width();
-        const int hh = dest.height();
+#ifdef FRAMELESSHELPER_BLUR_NEON
+template<const int aprec, const int zprec>
+static inline void qt_blurinner_neon(quint32 *pixel, int32x4_t &z, const int32x4_t alpha, const quint32 fill)
+{
+    const uint8x8_t source = vreinterpret_u8_u32(vdup_n_u32(*pixel));
+    const int32x4_t value = vshlq_n_s32(vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(vmovl_u8(source)))), zprec);
+    z = vmlaq_s32(z, alpha, vsubq_s32(value, vshrq_n_s32(z, aprec)));
+    const uint16x4_t result16 = vqmovun_s32(vshrq_n_s32(z, zprec + aprec));
+    const uint8x8_t result8 = vqmovn_u16(vcombine_u16(result16, result16));
+    *pixel = (vget_lane_u32(vreinterpret_u32_u8(result8), 0) | fill);
+}
+
+template<const int aprec, const int zprec, const int lanes>
+static inline void qt_blurrows_neon_impl(uchar *bits, const qsizetype bytesPerLine,
+    const int width, const int32x4_t alpha, const quint32 fill)
+{
+    quint32 *lines[lanes] = {};
+    int32x4_t z[lanes] = {};
+    for (int lane = 0; lane != lanes; ++lane) {
+        lines[lane] = reinterpret_cast<quint32 *>(bits + (bytesPerLine * lane));
+        z[lane] = vdupq_n_s32(0);
+    }
+    for (int index = 0; index != width; ++index) {
+        for (int lane = 0; lane != lanes; ++lane) {
+            qt_blurinner_neon<aprec, zprec>(lines[lane] + index, z[lane], alpha, fill);
+        }
+    }
+    for (int index = (width - 2); index >= 0; --index) {
+        for (int lane = 0; lane != lanes; ++lane) {
+            qt_blurinner_neon<aprec, zprec>(lines[lane] + index, z[lane], alpha, fill);
+        }
+    }
+}
+
+template<const int aprec, const int zprec>
+static inline void qt_blurrows_neon(uchar *bits, const qsizetype bytesPerLine,
+    const int rowCount, const int width, const int alpha, const quint32 fill)
+{
+    static constexpr const int kRowsPerBatch = 4;
+    const int32x4_t alphaVector = vdupq_n_s32(alpha);
+    int row = 0;
+    for (; (row + kRowsPerBatch) <= rowCount; row += kRowsPerBatch, bits += (bytesPerLine * kRowsPerBatch)) {
+        qt_blurrows_neon_impl<aprec, zprec, kRowsPerBatch>(bits, bytesPerLine, width, alphaVector, fill);
+    }
+    for (; row != rowCount; ++row, bits += bytesPerLine) {
+        qt_blurrows_neon_impl<aprec, zprec, 1>(bits, bytesPerLine, width, alphaVector, fill);
+    }
+}
+
+template<const int aprec, const int zprec, const int lanes>
+static inline void qt_blurcolumns_neon_impl(uchar *bits, const qsizetype bytesPerLine,
+    const int height, const int32x4_t alpha, const quint32 fill)
+{
+    int32x4_t z[lanes] = {};
+    for (int lane = 0; lane != lanes; ++lane) {
+        z[lane] = vdupq_n_s32(0);
+    }
+    for (int row = (height - 1); row >= 0; --row) {
+        const auto line = reinterpret_cast<quint32 *>(bits + (bytesPerLine * row));
+        for (int lane = 0; lane != lanes; ++lane) {
+            qt_blurinner_neon<aprec, zprec>(line + lane, z[lane], alpha, fill);
+        }
+    }
+    for (int row = 1; row < height; ++row) {
+        const auto line = reinterpret_cast<quint32 *>(bits + (bytesPerLine * row));
+        for (int lane = 0; lane != lanes; ++lane) {
+            qt_blurinner_neon<aprec, zprec>(line + lane, z[lane], alpha, fill);
+        }
+    }
+}
+
+template<const int aprec, const int zprec>
+static inline void qt_blurcolumns_neon(uchar *bits, const qsizetype bytesPerLine,
+    const int columnCount, const int height, const int alpha, const quint32 fill)
+{
+    static constexpr const int kColumnsPerTile = 16;
+    const int32x4_t alphaVector = vdupq_n_s32(alpha);
+    int column = 0;
+    for (; (column + kColumnsPerTile) <= columnCount; column += kColumnsPerTile, bits += (kColumnsPerTile * 4)) {
+        qt_blurcolumns_neon_impl<aprec, zprec, kColumnsPerTile>(bits, bytesPerLine, height, alphaVector, fill);
+    }
+    for (; column != columnCount; ++column, bits += 4) {
+        qt_blurcolumns_neon_impl<aprec, zprec, 1>(bits, bytesPerLine, height, alphaVector, fill);
+    }
+}
+#endif // FRAMELESSHELPER_BLUR_NEON
+
+// Set this environment variable to a non-zero value to always use the scalar
+// blur kernel, mainly useful for verifying the output of the SIMD kernels.
+[[maybe_unused]] static constexpr const char kForceScalarBlurEnvVar[] = "FRAMELESSHELPER_MICA_FORCE_SCALAR_BLUR";
+// Same, but switchable at runtime, see "MicaMaterialPrivate::setScalarBlurForced()".
+static QAtomicInt g_scalarBlurForced = 0;
+
+// The pyramid blur stops halving the image once the radius left for the
+// coarsest level would become smaller than this, or after this many levels.
+[[maybe_unused]] static constexpr const qreal kMinimumPyramidBlurRadius = 8.0;
+[[maybe_unused]] static constexpr const int kMaximumPyramidLevelCount = 4;
+
+// The exact blur processes the wallpaper in strips of (at least) this many rows.
+[[maybe_unused]] static constexpr const int kWallpaperBlurStripHeight = 256;
+
+// Images smaller than this are not worth the overhead of multi-threading.
+[[maybe_unused]] static constexpr const qint64 kMinimumParallelBlurPixels = (256 * 256);
+[[maybe_unused]] static constexpr const int kMaximumBlurThreadCount = 64;
+
+template<const int aprec, const int zprec>
+[[nodiscard]] static inline BlurKernels qt_blurKernels()
+{
+    static const auto kernels = []() -> BlurKernels {
+        if (qEnvironmentVariableIntValue(kForceScalarBlurEnvVar)) {
+            DEBUG << "Using the scalar blur kernel.";
+            return { &qt_blurrows_scalar<aprec, zprec>, &qt_blurcolumns_scalar<aprec, zprec> };
+        }
+#ifdef FRAMELESSHELPER_BLUR_AVX2
+        if (qCpuHasFeature(AVX2)) {
+            DEBUG << "Using the AVX2 blur kernel.";
+            return { &qt_blurrows_avx2<aprec, zprec>, &qt_blurcolumns_avx2<aprec, zprec> };
+        }
+#endif // FRAMELESSHELPER_BLUR_AVX2
+#ifdef FRAMELESSHELPER_BLUR_SSE2
+        if (qCpuHasFeature(SSE2)) {
+            DEBUG << "Using the SSE2 blur kernel.";
+            return { &qt_blurrows_sse2<aprec, zprec>, &qt_blurcolumns_sse2<aprec, zprec> };
+        }
+#endif // FRAMELESSHELPER_BLUR_SSE2
+#ifdef FRAMELESSHELPER_BLUR_NEON
+        DEBUG << "Using the NEON blur kernel.";
+        return { &qt_blurrows_neon<aprec, zprec>, &qt_blurcolumns_neon<aprec, zprec> };
+#else // !FRAMELESSHELPER_BLUR_NEON
+        DEBUG << "Using the scalar blur kernel.";
+        return { &qt_blurrows_scalar<aprec, zprec>, &qt_blurcolumns_scalar<aprec, zprec> };
+#endif // FRAMELESSHELPER_BLUR_NEON
+    }();
+    if (g_scalarBlurForced.loadAcquire()) {
+        return { &qt_blurrows_scalar<aprec, zprec>, &qt_blurcolumns_scalar<aprec, zprec> };
+    }
+    return kernels;
+}
+
+[[nodiscard]] static inline int qt_blurThreadCount()
+{
+    static const int environmentValue = qEnvironmentVariableIntValue(kMicaMaterialBlurThreadCountVar.constData());
+    int count = FramelessConfig::instance()->getInternal<int>(kMicaMaterialBlurThreadCountKey).value_or(environmentValue);
+    if (count <= 0) {
+        count = QThread::idealThreadCount();
+    }
+    return qBound(1, count, kMaximumBlurThreadCount);
+}
+
+Q_GLOBAL_STATIC(QThreadPool, g_blurThreadPool)
+
+/*
+    The blur threads are shared by all the blurs running at the same time (the
+    wallpapers of several screens, for example), so the pool is sized once and
+    never touched again. The calling thread always does its share of the work.
+ */
+[[nodiscard]] static inline QThreadPool *qt_blurThreadPool()
+{
+    if (g_blurThreadPool.isDestroyed()) {
+        return nullptr;
+    }
+    static QThreadPool * const pool = []() -> QThreadPool * {
+        QThreadPool * const threadPool = g_blurThreadPool();
+        threadPool->setMaxThreadCount(qMax(1, (qt_blurThreadCount() - 1)));
+        return threadPool;
+    }();
+    return pool;
+}
+
+// What the calling thread of "qt_blurParallel()" shares with the helpers it started.
+struct BlurBandState
+{
+    QMutex mutex;
+    QWaitCondition finished;
+    int runningHelperCount = 0;
+    // Set once the caller is done: the helpers which only start now have nothing left to do.
+    bool closed = false;
+};
+
+/*
+*  Splits the rows [firstRow, firstRow + rowCount) into bands and lets the
+*  calling thread and up to 'threadCount - 1' blur threads pick them up one
+*  by one until all of them are done. There are more bands than threads, so
+*  a thread which finishes early simply takes over the remaining work of the
+*  others. Band boundaries are multiples of 'alignment' rows (or columns) to
+*  keep the SIMD kernels busy. The caller doesn't wait for the helpers which
+*  are still queued behind other blurs once all bands are done.
+*/
+static inline void qt_blurParallel(const int firstRow, const int rowCount, const int width, const int threadCount,
+    const std::function<void(const int, const int)> &function, const int alignment = 8)
+{
+    static constexpr const int kBandsPerThread = 4;
+    QThreadPool * const pool = qt_blurThreadPool();
+    const int usedThreadCount = ((!pool || ((qint64(rowCount) * qint64(width)) < kMinimumParallelBlurPixels))
+        ? 1 : qMin(threadCount, (rowCount / alignment)));
+    if (usedThreadCount <= 1) {
+        function(firstRow, rowCount);
+        return;
+    }
+    const int bandCount = qMin((usedThreadCount * kBandsPerThread), (rowCount / alignment));
+    const int bandRows = ((((rowCount + bandCount - 1) / bandCount) + alignment - 1) / alignment) * alignment;
+    QAtomicInt nextBand = 0;
+    const std::function<void()> worker = [&nextBand, &function, firstRow, rowCount, bandRows](){
+        for (int band = nextBand.fetchAndAddRelaxed(1); (band * bandRows) < rowCount; band = nextBand.fetchAndAddRelaxed(1)) {
+            const int bandFirstRow = (band * bandRows);
+            function(firstRow + bandFirstRow, qMin(bandRows, (rowCount - bandFirstRow)));
+        }
+    };
+    // The helpers may start after we returned, they only touch the state then.
+    const auto state = QSharedPointer<BlurBandState>::create();
+    const std::function<void()> * const work = &worker;
+    for (int i = 1; i != usedThreadCount; ++i) {
+        pool->start(new FunctionRunnable([state, work](){
+            {
+                const QMutexLocker locker(&state->mutex);
+                if (state->closed) {
+                    return;
+                }
+                ++state->runningHelperCount;
+            }
+            (*work)();
+            const QMutexLocker locker(&state->mutex);
+            if (--state->runningHelperCount == 0) {
+                state->finished.wakeAll();
+            }
+        }));
+    }
+    worker(); // The calling thread does its share of the work too.
+    const QMutexLocker locker(&state->mutex);
+    state->closed = true;
+    while (state->runningHelperCount > 0) {
+        state->finished.wait(&state->mutex);
+    }
+}
+
+/*
+*  Blurs the rows [firstRow, firstRow + rowCount) of 'im' horizontally,
+*  dispatching to the fastest kernel available on the current CPU for
+*  32-bit images and to "qt_blurrow()" for everything else. The rows
+*  are independent of each other, so they are spread over several threads
+*  for large images.
+*/
+template<const int aprec, const int zprec, const bool alphaOnly>
+static inline void qt_blurrows(QImage &im, const int firstRow, const int rowCount,
+    const int alpha, const bool improvedQuality, const int threadCount)
+{
+    // Detach (if needed) once here, the worker threads must only use raw pointers.
+    const qsizetype bytesPerLine = im.bytesPerLine();
+    uchar * const bits = im.bits();
+    const QImage &image = im;
+    if (alphaOnly || (im.depth() != 32)) {
+        qt_blurParallel(firstRow, rowCount, im.width(), threadCount, [&image, bits, bytesPerLine, alpha, improvedQuality]
+            (const int bandFirstRow, const int bandRowCount){
+            const int lastRow = (bandFirstRow + bandRowCount);
+            for (int row = bandFirstRow; row != lastRow; ++row) {
+                for (int i = 0; i <= int(improvedQuality); ++i) {
+                    qt_blurrow<aprec, zprec, alphaOnly>(image, (bits + (bytesPerLine * row)), alpha);
+                }
+            }
+        });
+        return;
+    }
+    const quint32 fill = ((im.format() == QImage::Format_RGB32) ? 0xff000000 : 0);
+    const int width = im.width();
+    const BlurRowsFunction blurRows = qt_blurKernels<aprec, zprec>().rows;
+    qt_blurParallel(firstRow, rowCount, width, threadCount, [blurRows, bits, bytesPerLine, width, alpha, fill, improvedQuality]
+        (const int bandFirstRow, const int bandRowCount){
+        uchar * const bandBits = (bits + (bytesPerLine * bandFirstRow));
+        for (int i = 0; i <= int(improvedQuality); ++i) {
+            blurRows(bandBits, bytesPerLine, bandRowCount, width, alpha, fill);
+        }
+    });
+}
+
+/*
+*  Blurs the columns [firstColumn, firstColumn + columnCount) of the 32-bit
+*  image 'im' vertically, in place. The bands handed out to the threads are
+*  whole cache lines wide so that no two threads ever write to the same line.
+*/
+template<const int aprec, const int zprec>
+static inline void qt_blurcolumns(QImage &im, const int firstColumn, const int columnCount,
+    const int alpha, const bool improvedQuality, const int threadCount)
+{
+    Q_ASSERT(im.depth() == 32);
+    static constexpr const int kColumnAlignment = 16;
+    const qsizetype bytesPerLine = im.bytesPerLine();
+    uchar * const bits = im.bits();
+    const quint32 fill = ((im.format() == QImage::Format_RGB32) ? 0xff000000 : 0);
+    const int height = im.height();
+    const BlurColumnsFunction blurColumns = qt_blurKernels<aprec, zprec>().columns;
+    qt_blurParallel(firstColumn, columnCount, height, threadCount, [blurColumns, bits, bytesPerLine, height, alpha, fill, improvedQuality]
+        (const int bandFirstColumn, const int bandColumnCount){
+        uchar * const bandBits = (bits + (bandFirstColumn * 4));
+        for (int i = 0; i <= int(improvedQuality); ++i) {
+            blurColumns(bandBits, bytesPerLine, bandColumnCount, height, alpha, fill);
+        }
+    }, kColumnAlignment);
+}
+
+/*
+*  expblur(QImage &img, int radius)
+*
+*  Based on exponential blur algorithm by Jani Huhtanen
+*
+*  In-place blur of image 'img' with kernel
+*  of approximate radius 'radius'.
+*
+*  Blurs with two sided exponential impulse
+*  response.
+*
+*  aprec = precision of alpha parameter
+*  in fixed-point format 0.aprec
+*
+*  zprec = precision of state parameters
+*  zR,zG,zB and zA in fp format 8.zprec
+*
+*  threadCount = how many threads (including
+*  the calling one) the blur may use
+*/
+template<const int aprec, const int zprec, const bool alphaOnly>
+static inline void expblur(QImage &img, qreal radius, const bool improvedQuality, const int transposed, const int threadCount)
+{
+    Q_ASSERT((img.format() == QImage::Format_ARGB32_Premultiplied)
+             || (img.format() == QImage::Format_RGB32)
+             || (img.format() == QImage::Format_Indexed8)
+             || (img.format() == QImage::Format_Grayscale8));
+    if ((img.format() != QImage::Format_ARGB32_Premultiplied)
+        && (img.format() != QImage::Format_RGB32)
+        && (img.format() != QImage::Format_Indexed8)
+        && (img.format() != QImage::Format_Grayscale8)) {
+        return;
+    }
+
+    // halve the radius if we're using two passes
+    if (improvedQuality) {
+        radius *= 0.5;
+    }
+
+    // choose the alpha such that pixels at radius distance from a fully
+    // saturated pixel will have an alpha component of no greater than
+    // the cutOffIntensity
+    static constexpr const qreal cutOffIntensity = 2.0;
+    const int alpha = ((radius <= qreal(1e-5)) ? ((1 << aprec) - 1) :
+        std::round((1 << aprec) * (1 - qPow(cutOffIntensity / qreal(255), qreal(1) / radius))));
+
+    qt_blurrows<aprec, zprec, alphaOnly>(img, 0, img.height(), alpha, improvedQuality, threadCount);
+
+    // The common case: blur the columns in place, without a transposed copy.
+    if constexpr (!alphaOnly) {
+        if ((transposed == 0) && (img.depth() == 32)) {
+            qt_blurcolumns<aprec, zprec>(img, 0, img.width(), alpha, improvedQuality, threadCount);
+            return;
+        }
+    }
+
+    QImage temp(img.height(), img.width(), img.format());
+    temp.setDevicePixelRatio(img.devicePixelRatio());
+
+    if (transposed >= 0) {
+        if (img.depth() == 8) {
+            qt_memrotate270(reinterpret_cast<const quint8 *>(img.bits()),
+                            img.width(), img.height(), img.bytesPerLine(),
+                            reinterpret_cast<quint8 *>(temp.bits()),
+                            temp.bytesPerLine());
+        } else {
+            qt_memrotate270(reinterpret_cast<const quint32 *>(img.bits()),
+                            img.width(), img.height(), img.bytesPerLine(),
+                            reinterpret_cast<quint32 *>(temp.bits()),
+                            temp.bytesPerLine());
+        }
+    } else {
+        if (img.depth() == 8) {
+            qt_memrotate90(reinterpret_cast<const quint8 *>(img.bits()),
+                           img.width(), img.height(), img.bytesPerLine(),
+                           reinterpret_cast<quint8 *>(temp.bits()),
+                           temp.bytesPerLine());
+        } else {
+            qt_memrotate90(reinterpret_cast<const quint32 *>(img.bits()),
+                           img.width(), img.height(), img.bytesPerLine(),
+                           reinterpret_cast<quint32 *>(temp.bits()),
+                           temp.bytesPerLine());
+        }
+    }
+
+    qt_blurrows<aprec, zprec, alphaOnly>(temp, 0, temp.height(), alpha, improvedQuality, threadCount);
+
+    if (transposed == 0) {
+        if (img.depth() == 8) {
+            qt_memrotate90(reinterpret_cast<const quint8 *>(temp.bits()),
+                           temp.width(), temp.height(), temp.bytesPerLine(),
+                           reinterpret_cast<quint8 *>(img.bits()),
+                           img.bytesPerLine());
+        } else {
+            qt_memrotate90(reinterpret_cast<const quint32 *>(temp.bits()),
+                           temp.width(), temp.height(), temp.bytesPerLine(),
+                           reinterpret_cast<quint32 *>(img.bits()),
+                           img.bytesPerLine());
+        }
+    } else {
+        img = temp;
+    }
+}
+
+#define AVG(a,b)  ( ((((a)^(b)) & 0xfefefefeUL) >> 1) + ((a)&(b)) )
+#define AVG16(a,b)  ( ((((a)^(b)) & 0xf7deUL) >> 1) + ((a)&(b)) )
+
+[[nodiscard]] static inline QImage qt_halfScaled(const QImage &source, const int threadCount)
+{
+    if ((source.width() < 2) || (source.height() < 2)) {
+        return {};
+    }
+
+    QImage srcImage = source;
+
+    if ((source.format() == QImage::Format_Indexed8)
+        || (source.format() == QImage::Format_Grayscale8)) {
+        // assumes grayscale
+        QImage dest(source.width() / 2, source.height() / 2, srcImage.format());
+        dest.setDevicePixelRatio(source.devicePixelRatio());
+
+        auto src = reinterpret_cast<const uchar *>(const_cast<const QImage &>(srcImage).bits());
+        const qsizetype sx = srcImage.bytesPerLine();
+        const qsizetype sx2 = (sx << 1);
+
+        auto dst = reinterpret_cast<uchar *>(dest.bits());
+        const qsizetype dx = dest.bytesPerLine();
+        const int ww = dest.width();
+        const int hh = dest.height();
+
+        for (int y = hh; y; --y, dst += dx, src += sx2) {
+            const uchar *p1 = src;
+            const uchar *p2 = (src + sx);
+            uchar *q = dst;
+            for (int x = ww; x; --x, ++q, p1 += 2, p2 += 2) {
+                *q = (((int(p1[0]) + int(p1[1]) + int(p2[0]) + int(p2[1])) + 2) >> 2);
+            }
+        }
+
+        return dest;
+    }
+    if (source.format() == QImage::Format_ARGB8565_Premultiplied) {
+        QImage dest(source.width() / 2, source.height() / 2, srcImage.format());
+        dest.setDevicePixelRatio(source.devicePixelRatio());
+
+        auto src = reinterpret_cast<const uchar *>(const_cast<const QImage &>(srcImage).bits());
+        const qsizetype sx = srcImage.bytesPerLine();
+        const qsizetype sx2 = (sx << 1);
+
+        auto dst = reinterpret_cast<uchar *>(dest.bits());
+        const qsizetype dx = dest.bytesPerLine();
+        const int ww = dest.width();
+        const int hh = dest.height();
 
         for (int y = hh; y; --y, dst += dx, src += sx2) {
             const uchar *p1 = src;
@@ -374,25 +1196,101 @@ static inline void expblur(QImage &img, qreal radius, const bool improvedQuality
     const qsizetype sx = (srcImage.bytesPerLine() >> 2);
     const qsizetype sx2 = (sx << 1);
 
-    auto dst = reinterpret_cast<quint32 *>(dest.bits());
+    const auto dst = reinterpret_cast<quint32 *>(dest.bits());
     const qsizetype dx = (dest.bytesPerLine() >> 2);
     const int ww = dest.width();
     const int hh = dest.height();
 
-    for (int y = hh; y; --y, dst += dx, src += sx2) {
-        const quint32 *p1 = src;
-        const quint32 *p2 = (src + sx);
-        quint32 *q = dst;
-        for (int x = ww; x; --x, q++, p1 += 2, p2 += 2) {
-            *q = AVG(AVG(p1[0], p1[1]), AVG(p2[0], p2[1]));
+    // This is the first step of the blur pyramid and it reads the whole full
+    // resolution image, so spread it over the blur threads as well.
+    qt_blurParallel(0, hh, ww, threadCount, [src, sx, sx2, dst, dx, ww](const int firstRow, const int rowCount){
+        for (int y = firstRow; y != (firstRow + rowCount); ++y) {
+            const quint32 *p1 = (src + (sx2 * y));
+            const quint32 *p2 = (p1 + sx);
+            quint32 *q = (dst + (dx * y));
+            for (int x = ww; x; --x, q++, p1 += 2, p2 += 2) {
+                *q = AVG(AVG(p1[0], p1[1]), AVG(p2[0], p2[1]));
+            }
         }
-    }
+    });
+
+    return dest;
+}
+
+// Blends two pixels channel by channel, 'weight' (0~256) is the weight of 'b'.
+[[nodiscard]] static inline quint32 qt_interpolatePixel(const quint32 a, const quint32 b, const quint32 weight)
+{
+    const quint32 inverse = (256 - weight);
+    const quint32 rb = (((((a & 0x00ff00ff) * inverse) + ((b & 0x00ff00ff) * weight)) >> 8) & 0x00ff00ff);
+    const quint32 ag = (((((a >> 8) & 0x00ff00ff) * inverse) + (((b >> 8) & 0x00ff00ff) * weight)) & 0xff00ff00);
+    return (rb | ag);
+}
+
+// Maps the destination pixel 'index' to the first of the two source pixels
+// it's interpolated from, sampling at pixel centers like QPainter does.
+static inline void qt_bilinearSourcePosition(const int index, const int sourceLength,
+    const int destinationLength, int &first, quint32 &weight)
+{
+    const qint64 position = qMax(qint64(0), ((((qint64(index) * 2) + 1) * sourceLength * 128) / destinationLength) - 128);
+    first = qMin(int(position >> 8), (sourceLength - 1));
+    weight = ((first == (sourceLength - 1)) ? 0 : quint32(position & 0xff));
+}
 
+/*
+*  Scales the 32-bit image 'source' up to 'size' with bilinear filtering.
+*  This is only used on heavily blurred images, so it's fine to keep just
+*  8 bits of sub-pixel precision. Each output row is interpolated from one
+*  vertically blended row of the (much smaller) source image.
+*/
+[[nodiscard]] static inline QImage qt_bilinearUpscaled(const QImage &source, const QSize &size, const int threadCount)
+{
+    Q_ASSERT(source.depth() == 32);
+    if (source.isNull() || size.isEmpty()) {
+        return {};
+    }
+    QImage dest(size, source.format());
+    dest.setDevicePixelRatio(source.devicePixelRatio());
+    const int sourceWidth = source.width();
+    const int sourceHeight = source.height();
+    const int destWidth = dest.width();
+    const int destHeight = dest.height();
+    QVector<int> columns(destWidth);
+    QVector<quint32> columnWeights(destWidth);
+    for (int x = 0; x != destWidth; ++x) {
+        qt_bilinearSourcePosition(x, sourceWidth, destWidth, columns[x], columnWeights[x]);
+    }
+    const auto src = source.constBits();
+    const qsizetype sourceBytesPerLine = source.bytesPerLine();
+    uchar * const dst = dest.bits();
+    const qsizetype destBytesPerLine = dest.bytesPerLine();
+    const int * const columnIndexes = columns.constData();
+    const quint32 * const weights = columnWeights.constData();
+    qt_blurParallel(0, destHeight, destWidth, threadCount, [columnIndexes, weights, src, sourceBytesPerLine, sourceHeight,
+        sourceWidth, dst, destBytesPerLine, destWidth, destHeight](const int firstRow, const int rowCount){
+        QVector<quint32> buffer(sourceWidth + 1);
+        quint32 * const line = buffer.data();
+        for (int y = firstRow; y != (firstRow + rowCount); ++y) {
+            int sourceRow = 0;
+            quint32 rowWeight = 0;
+            qt_bilinearSourcePosition(y, sourceHeight, destHeight, sourceRow, rowWeight);
+            const auto p1 = reinterpret_cast<const quint32 *>(src + (sourceBytesPerLine * sourceRow));
+            const auto p2 = reinterpret_cast<const quint32 *>(src + (sourceBytesPerLine * qMin(sourceRow + 1, sourceHeight - 1)));
+            for (int x = 0; x != sourceWidth; ++x) {
+                line[x] = qt_interpolatePixel(p1[x], p2[x], rowWeight);
+            }
+            line[sourceWidth] = line[sourceWidth - 1]; // The right neighbour of the last pixel.
+            const auto q = reinterpret_cast<quint32 *>(dst + (destBytesPerLine * y));
+            for (int x = 0; x != destWidth; ++x) {
+                const int column = columnIndexes[x];
+                q[x] = qt_interpolatePixel(line[column], line[column + 1], weights[x]);
+            }
+        }
+    });
     return dest;
 }
 
 [[maybe_unused]] static inline void qt_blurImage(QPainter *p, QImage &blurImage,
-    qreal radius, const bool quality, const bool alphaOnly, const int transposed = 0)
+    qreal radius, const bool quality, const bool alphaOnly, const int threadCount, const int transposed = 0)
 {
     if ((blurImage.format() != QImage::Format_ARGB32_Premultiplied)
         && (blurImage.format() != QImage::Format_RGB32)) {
@@ -401,15 +1299,15 @@ static inline void expblur(QImage &img, qreal radius, const bool improvedQuality
 
     qreal scale = 1.0;
     if ((radius >= 4) && (blurImage.width() >= 2) && (blurImage.height() >= 2)) {
-        blurImage = qt_halfScaled(blurImage);
+        blurImage = qt_halfScaled(blurImage, threadCount);
         scale = 2.0;
         radius *= 0.5;
     }
 
     if (alphaOnly) {
-        expblur<12, 10, true>(blurImage, radius, quality, transposed);
+        expblur<12, 10, true>(blurImage, radius, quality, transposed, threadCount);
     } else {
-        expblur<12, 10, false>(blurImage, radius, quality, transposed);
+        expblur<12, 10, false>(blurImage, radius, quality, transposed, threadCount);
     }
 
     if (p) {
@@ -428,20 +1326,420 @@ static inline void expblur(QImage &img, qreal radius, const bool improvedQuality
 }
 
 [[maybe_unused]] static inline void qt_blurImage(QImage &blurImage,
-    const qreal radius, const bool quality, const int transposed = 0)
+    const qreal radius, const bool quality, const int threadCount, const int transposed = 0)
 {
     if ((blurImage.format() == QImage::Format_Indexed8)
         || (blurImage.format() == QImage::Format_Grayscale8)) {
-        expblur<12, 10, true>(blurImage, radius, quality, transposed);
+        expblur<12, 10, true>(blurImage, radius, quality, transposed, threadCount);
     } else {
-        expblur<12, 10, false>(blurImage, radius, quality, transposed);
+        expblur<12, 10, false>(blurImage, radius, quality, transposed, threadCount);
     }
 }
 
-/*!
-    Transforms an \a alignment of Qt::AlignLeft or Qt::AlignRight
-    without Qt::AlignAbsolute into Qt::AlignLeft or Qt::AlignRight with
-    Qt::AlignAbsolute according to the layout \a direction. The other
+/*
+*  Blur backends.
+*
+*  Every backend blurs a 32-bit (Format_RGB32 or Format_ARGB32_Premultiplied)
+*  image in place and costs the same per pixel no matter how large the radius
+*  is. The radius has the meaning of "expblur()": the other backends derive a
+*  standard deviation from it which matches the spread of the exponential
+*  blur, so switching the backend doesn't change how blurry the result is.
+*  Only the exponential blur honors the number of passes, the other ones
+*  already approximate a gaussian blur with a fixed number of passes. They
+*  use up to 'threadCount' threads, including the calling one.
+*/
+class AbstractBlurBackend
+{
+    Q_DISABLE_COPY_MOVE(AbstractBlurBackend)
+
+public:
+    AbstractBlurBackend() = default;
+    virtual ~AbstractBlurBackend() = default;
+
+    virtual void blur(QImage &image, const qreal radius, const int passes, const int threadCount) const = 0;
+};
+
+// The standard deviation of the kernel of "expblur()" (with improved quality,
+// that is two passes of half the radius each) for the given radius.
+[[nodiscard]] static inline qreal qt_exponentialBlurSigma(const qreal radius)
+{
+    if (radius <= qreal(1e-5)) {
+        return 0.0;
+    }
+    // One forward and backward pass of the first order recursive filter has
+    // a variance of 2 * (1 - a) / (a * a), where a is the alpha of "expblur()".
+    const qreal decay = qPow(qreal(2) / qreal(255), qreal(1) / (radius * qreal(0.5)));
+    return (qSqrt(qreal(4) * decay) / (qreal(1) - decay));
+}
+
+/*
+*  Runs 'function' on every row and then on every column of the image. The
+*  function receives the first pixel of the line, the distance between two
+*  pixels of the line (in pixels) and the line length. Lines are independent
+*  of each other, so they are spread over the blur threads.
+*/
+template<typename Function>
+static inline void qt_blurLines(QImage &image, const int threadCount, const Function &function)
+{
+    Q_ASSERT(image.depth() == 32);
+    const qsizetype stride = (image.bytesPerLine() / 4);
+    const auto bits = reinterpret_cast<quint32 *>(image.bits());
+    const int width = image.width();
+    const int height = image.height();
+    qt_blurParallel(0, height, width, threadCount, [&function, bits, stride, width](const int firstRow, const int rowCount){
+        for (int row = firstRow; row != (firstRow + rowCount); ++row) {
+            function(bits + (stride * row), 1, width);
+        }
+    });
+    qt_blurParallel(0, width, height, threadCount, [&function, bits, stride, height](const int firstColumn, const int columnCount){
+        for (int column = firstColumn; column != (firstColumn + columnCount); ++column) {
+            function(bits + column, stride, height);
+        }
+    }, 16);
+}
+
+class ExponentialBlurBackend final : public AbstractBlurBackend
+{
+public:
+    void blur(QImage &image, const qreal radius, const int passes, const int threadCount) const override
+    {
+        if (passes == 2) {
+            expblur<12, 10, false>(image, radius, true, 0, threadCount);
+            return;
+        }
+        // Two passes of half the radius each is what "expblur()" does with improved
+        // quality, keep the same spread for any other number of passes.
+        const qreal passRadius = (radius * qreal(0.5) * qSqrt(qreal(2) / qreal(qMax(passes, 1))));
+        for (int pass = 0; pass < qMax(passes, 1); ++pass) {
+            expblur<12, 10, false>(image, passRadius, false, 0, threadCount);
+        }
+    }
+};
+
+/*
+*  Three passes of a running sum box filter, the box widths are chosen such
+*  that the result approximates a gaussian blur of the given deviation:
+*  "Fast Almost-Gaussian Filtering" by Peter Kovesi.
+*/
+class BoxBlurBackend final : public AbstractBlurBackend
+{
+public:
+    void blur(QImage &image, const qreal radius, const int passes, const int threadCount) const override
+    {
+        Q_UNUSED(passes);
+        static constexpr const int kPassCount = 3;
+        static constexpr const int kMaximumBoxRadius = 127;
+        const qreal sigma = qt_exponentialBlurSigma(radius);
+        if (sigma <= qreal(0.5)) {
+            return;
+        }
+        int radii[kPassCount] = {};
+        const qreal idealWidth = qSqrt(((qreal(12) * sigma * sigma) / kPassCount) + 1);
+        int lowerWidth = qFloor(idealWidth);
+        if ((lowerWidth % 2) == 0) {
+            --lowerWidth;
+        }
+        const int lowerCount = qRound(((qreal(12) * sigma * sigma) - (kPassCount * lowerWidth * lowerWidth)
+            - (4 * kPassCount * lowerWidth) - (3 * kPassCount)) / qreal((-4 * lowerWidth) - 4));
+        for (int pass = 0; pass != kPassCount; ++pass) {
+            // The fixed point arithmetic of "boxBlurLine()" is exact up to this radius.
+            radii[pass] = qMin(((((pass < lowerCount) ? lowerWidth : (lowerWidth + 2)) - 1) / 2), kMaximumBoxRadius);
+        }
+        const quint32 fill = ((image.format() == QImage::Format_RGB32) ? 0xff000000 : 0);
+        qt_blurLines(image, threadCount, [&radii, fill](quint32 *line, const qsizetype step, const int length){
+            QVector<quint32> buffer(length * 2);
+            quint32 *source = buffer.data();
+            quint32 *destination = (source + length);
+            for (int index = 0; index != length; ++index) {
+                source[index] = line[step * index];
+            }
+            for (int pass = 0; pass != kPassCount; ++pass) {
+                boxBlurLine(source, destination, length, radii[pass]);
+                qSwap(source, destination);
+            }
+            for (int index = 0; index != length; ++index) {
+                line[step * index] = (source[index] | fill);
+            }
+        });
+    }
+
+private:
+    // Clamps at the edges, just like the other backends.
+    static void boxBlurLine(const quint32 *source, quint32 *destination, const int length, const int radius)
+    {
+        // Rounded up, so that a constant signal stays exactly the same.
+        const quint32 width = ((radius * 2) + 1);
+        const quint32 scale = ((65536 + width - 1) / width);
+        const int last = (length - 1);
+        quint32 sum[4] = {};
+        const auto add = [&sum](const quint32 pixel, const quint32 weight){
+            sum[0] += ((pixel & 0xff) * weight);
+            sum[1] += (((pixel >> 8) & 0xff) * weight);
+            sum[2] += (((pixel >> 16) & 0xff) * weight);
+            sum[3] += ((pixel >> 24) * weight);
+        };
+        const auto subtract = [&sum](const quint32 pixel){
+            sum[0] -= (pixel & 0xff);
+            sum[1] -= ((pixel >> 8) & 0xff);
+            sum[2] -= ((pixel >> 16) & 0xff);
+            sum[3] -= (pixel >> 24);
+        };
+        add(source[0], (radius + 1));
+        for (int index = 1; index <= radius; ++index) {
+            add(source[qMin(index, last)], 1);
+        }
+        for (int index = 0; index != length; ++index) {
+            destination[index] = (((sum[0] * scale) >> 16)
+                | (((sum[1] * scale) >> 16) << 8)
+                | (((sum[2] * scale) >> 16) << 16)
+                | (((sum[3] * scale) >> 16) << 24));
+            add(source[qMin(index + radius + 1, last)], 1);
+            subtract(source[qMax(index - radius, 0)]);
+        }
+    }
+};
+
+/*
+*  Stack blur by Mario Klingemann: the kernel is a triangle (two box filters
+*  convolved), maintained incrementally with one running sum for the pixels
+*  entering the stack and one for the pixels leaving it.
+*/
+class StackBlurBackend final : public AbstractBlurBackend
+{
+public:
+    void blur(QImage &image, const qreal radius, const int passes, const int threadCount) const override
+    {
+        Q_UNUSED(passes);
+        static constexpr const int kMaximumStackRadius = 254;
+        const qreal sigma = qt_exponentialBlurSigma(radius);
+        // The triangle of radius r has a variance of ((r + 1)^2 - 1) / 6.
+        const int stackRadius = qMin(qRound(qSqrt((qreal(6) * sigma * sigma) + 1) - 1), kMaximumStackRadius);
+        if (stackRadius < 1) {
+            return;
+        }
+        const quint32 fill = ((image.format() == QImage::Format_RGB32) ? 0xff000000 : 0);
+        qt_blurLines(image, threadCount, [stackRadius, fill](quint32 *line, const qsizetype step, const int length){
+            stackBlurLine(line, step, length, stackRadius, fill);
+        });
+    }
+
+private:
+    static void stackBlurLine(quint32 *line, const qsizetype step, const int length, const int radius, const quint32 fill)
+    {
+        const int stackSize = ((radius * 2) + 1);
+        const quint64 divisor = quint64((radius + 1) * (radius + 1));
+        const quint64 scale = (((quint64(1) << 32) + divisor - 1) / divisor); // Rounded up, see "boxBlurLine()".
+        const int last = (length - 1);
+        QVector<quint32> buffer(length + stackSize);
+        quint32 * const source = buffer.data();
+        quint32 * const stack = (source + length);
+        for (int index = 0; index != length; ++index) {
+            source[index] = line[step * index];
+        }
+        quint32 sum[4] = {}, sumIn[4] = {}, sumOut[4] = {};
+        const auto accumulate = [](quint32 *target, const quint32 pixel, const quint32 weight){
+            target[0] += ((pixel & 0xff) * weight);
+            target[1] += (((pixel >> 8) & 0xff) * weight);
+            target[2] += (((pixel >> 16) & 0xff) * weight);
+            target[3] += ((pixel >> 24) * weight);
+        };
+        const auto remove = [](quint32 *target, const quint32 pixel){
+            target[0] -= (pixel & 0xff);
+            target[1] -= ((pixel >> 8) & 0xff);
+            target[2] -= ((pixel >> 16) & 0xff);
+            target[3] -= (pixel >> 24);
+        };
+        for (int offset = -radius; offset <= radius; ++offset) {
+            const quint32 pixel = source[qBound(0, offset, last)];
+            stack[offset + radius] = pixel;
+            accumulate(sum, pixel, quint32(radius + 1 - qAbs(offset)));
+            accumulate(((offset > 0) ? sumIn : sumOut), pixel, 1);
+        }
+        int stackPointer = radius;
+        for (int index = 0; index != length; ++index) {
+            line[step * index] = (quint32((sum[0] * scale) >> 32)
+                | (quint32((sum[1] * scale) >> 32) << 8)
+                | (quint32((sum[2] * scale) >> 32) << 16)
+                | (quint32((sum[3] * scale) >> 32) << 24) | fill);
+            for (int channel = 0; channel != 4; ++channel) {
+                sum[channel] -= sumOut[channel];
+            }
+            // The oldest entry leaves the stack and the next pixel takes its place.
+            quint32 &oldest = stack[(stackPointer + radius + 1) % stackSize];
+            remove(sumOut, oldest);
+            oldest = source[qMin(index + radius + 1, last)];
+            accumulate(sumIn, oldest, 1);
+            for (int channel = 0; channel != 4; ++channel) {
+                sum[channel] += sumIn[channel];
+            }
+            // The new center moves from the incoming half to the outgoing one.
+            stackPointer = ((stackPointer + 1) % stackSize);
+            const quint32 center = stack[stackPointer];
+            accumulate(sumOut, center, 1);
+            remove(sumIn, center);
+        }
+    }
+};
+
+/*
+*  Recursive gaussian filter: "Recursive implementation of the Gaussian
+*  filter" by Ian T. Young and Lucas J. van Vliet. A third order causal
+*  filter followed by the same filter backwards, in floating point.
+*/
+class RecursiveGaussianBlurBackend final : public AbstractBlurBackend
+{
+public:
+    void blur(QImage &image, const qreal radius, const int passes, const int threadCount) const override
+    {
+        Q_UNUSED(passes);
+        const qreal sigma = qt_exponentialBlurSigma(radius);
+        if (sigma <= qreal(0.5)) {
+            return;
+        }
+        const qreal q = ((sigma >= qreal(2.5)) ? ((qreal(0.98711) * sigma) - qreal(0.96330))
+            : (qreal(3.97156) - (qreal(4.14554) * qSqrt(qreal(1) - (qreal(0.26891) * sigma)))));
+        const qreal q2 = (q * q);
+        const qreal q3 = (q2 * q);
+        const qreal b0 = (qreal(1.57825) + (qreal(2.44413) * q) + (qreal(1.4281) * q2) + (qreal(0.422205) * q3));
+        Coefficients coefficients = {};
+        coefficients.b1 = float(((qreal(2.44413) * q) + (qreal(2.85619) * q2) + (qreal(1.26661) * q3)) / b0);
+        coefficients.b2 = float(-((qreal(1.4281) * q2) + (qreal(1.26661) * q3)) / b0);
+        coefficients.b3 = float((qreal(0.422205) * q3) / b0);
+        coefficients.b = (1.0f - (coefficients.b1 + coefficients.b2 + coefficients.b3));
+        const bool premultiplied = (image.format() == QImage::Format_ARGB32_Premultiplied);
+        qt_blurLines(image, threadCount, [&coefficients, premultiplied](quint32 *line, const qsizetype step, const int length){
+            recursiveBlurLine(line, step, length, coefficients, premultiplied);
+        });
+    }
+
+private:
+    struct Coefficients
+    {
+        float b = 0.0f;
+        float b1 = 0.0f;
+        float b2 = 0.0f;
+        float b3 = 0.0f;
+    };
+
+    static void recursiveBlurLine(quint32 *line, const qsizetype step, const int length,
+        const Coefficients &c, const bool premultiplied)
+    {
+        QVector<float> buffer(length * 4);
+        float * const values = buffer.data();
+        for (int index = 0; index != length; ++index) {
+            const quint32 pixel = line[step * index];
+            float * const value = (values + (index * 4));
+            value[0] = float(pixel & 0xff);
+            value[1] = float((pixel >> 8) & 0xff);
+            value[2] = float((pixel >> 16) & 0xff);
+            value[3] = float(pixel >> 24);
+        }
+        for (int channel = 0; channel != 4; ++channel) {
+            // Start from the steady state of a constant signal equal to the edge pixel.
+            float w1 = values[channel], w2 = w1, w3 = w1;
+            for (int index = 0; index != length; ++index) {
+                float &value = values[(index * 4) + channel];
+                const float w0 = ((c.b * value) + (c.b1 * w1) + (c.b2 * w2) + (c.b3 * w3));
+                value = w0;
+                w3 = w2;
+                w2 = w1;
+                w1 = w0;
+            }
+            w1 = values[((length - 1) * 4) + channel], w2 = w1, w3 = w1;
+            for (int index = (length - 1); index >= 0; --index) {
+                float &value = values[(index * 4) + channel];
+                const float w0 = ((c.b * value) + (c.b1 * w1) + (c.b2 * w2) + (c.b3 * w3));
+                value = w0;
+                w3 = w2;
+                w2 = w1;
+                w1 = w0;
+            }
+        }
+        for (int index = 0; index != length; ++index) {
+            const float * const value = (values + (index * 4));
+            const quint32 alpha = (premultiplied ? quint32(qBound(0, qRound(value[3]), 255)) : 255);
+            const auto channel = [alpha](const float v) -> quint32 {
+                return quint32(qBound(0, qRound(v), int(alpha)));
+            };
+            line[step * index] = (channel(value[0]) | (channel(value[1]) << 8)
+                | (channel(value[2]) << 16) | (alpha << 24));
+        }
+    }
+};
+
+[[nodiscard]] static inline const AbstractBlurBackend *qt_blurBackend(const BlurBackend backend)
+{
+    static const ExponentialBlurBackend exponential = {};
+    static const BoxBlurBackend box = {};
+    static const StackBlurBackend stack = {};
+    static const RecursiveGaussianBlurBackend recursiveGaussian = {};
+    switch (backend) {
+    case BlurBackend::Box:
+        return &box;
+    case BlurBackend::Stack:
+        return &stack;
+    case BlurBackend::RecursiveGaussian:
+        return &recursiveGaussian;
+    case BlurBackend::Exponential:
+        break;
+    }
+    return &exponential;
+}
+
+/*
+*  The fast alternative to "qt_blurImage()" for large radii: with a radius
+*  of hundred pixels or so, the result has no high-frequency detail left at
+*  all, so we can just as well blur a much smaller version of the image.
+*  The image is halved with "qt_halfScaled()" until the radius left for the
+*  coarsest level reaches "kMinimumPyramidBlurRadius" (at most 1/16 of the
+*  original size), blurred there by 'backend' with the equivalent radius (in
+*  'passes' passes) and scaled to 'size' (the original size if it's empty) bilinearly,
+*  on up to 'threadCount' threads.
+*/
+[[nodiscard]] static inline int qt_pyramidLevelCount(QSize size, qreal radius)
+{
+    int level = 0;
+    while ((level < kMaximumPyramidLevelCount) && ((radius * 0.5) >= kMinimumPyramidBlurRadius)
+           && (size.width() >= 4) && (size.height() >= 4)) {
+        size = QSize((size.width() / 2), (size.height() / 2)); // Same as "qt_halfScaled()".
+        radius *= 0.5;
+        ++level;
+    }
+    return level;
+}
+
+[[nodiscard]] static inline QImage qt_pyramidBlurImage(QImage image, qreal radius,
+    const AbstractBlurBackend *backend, const int passes, const int threadCount, QSize size = {})
+{
+    Q_ASSERT(backend);
+    if ((image.format() != QImage::Format_ARGB32_Premultiplied)
+        && (image.format() != QImage::Format_RGB32)) {
+        image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    if (size.isEmpty()) {
+        size = image.size();
+    }
+    const int levelCount = qt_pyramidLevelCount(image.size(), radius);
+    for (int level = 0; level != levelCount; ++level) {
+        // Reassigning releases the previous level right away.
+        image = qt_halfScaled(image, threadCount);
+        radius *= 0.5;
+    }
+    backend->blur(image, radius, passes, threadCount);
+    if (image.size() == size) {
+        return image;
+    }
+    if ((image.width() > size.width()) || (image.height() > size.height())) {
+        // Only happens for small radii, bilinear filtering would alias here.
+        return image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    return qt_bilinearUpscaled(image, size, threadCount);
+}
+
+/*!
+    Transforms an \a alignment of Qt::AlignLeft or Qt::AlignRight
+    without Qt::AlignAbsolute into Qt::AlignLeft or Qt::AlignRight with
+    Qt::AlignAbsolute according to the layout \a direction. The other
     alignment flags are left untouched.
 
     If no horizontal alignment was specified, the function returns the
@@ -460,25 +1758,1640 @@ static inline void expblur(QImage &img, qreal radius, const bool improvedQuality
     Returns a new rectangle of the specified \a size that is aligned to the given
     \a rectangle according to the specified \a alignment and \a direction.
  */
-[[nodiscard]] static inline QRect alignedRect(const Qt::LayoutDirection direction,
-    Qt::Alignment alignment, const QSize &size, const QRect &rectangle)
+[[nodiscard]] static inline QRect alignedRect(const Qt::LayoutDirection direction,
+    Qt::Alignment alignment, const QSize &size, const QRect &rectangle)
+{
+    alignment = visualAlignment(direction, alignment);
+    int x = rectangle.x();
+    int y = rectangle.y();
+    int w = size.width();
+    int h = size.height();
+    if ((alignment & Qt::AlignVCenter) == Qt::AlignVCenter) {
+        y += ((rectangle.size().height() / 2) - (h / 2));
+    } else if ((alignment & Qt::AlignBottom) == Qt::AlignBottom) {
+        y += (rectangle.size().height() - h);
+    }
+    if ((alignment & Qt::AlignRight) == Qt::AlignRight) {
+        x += (rectangle.size().width() - w);
+    } else if ((alignment & Qt::AlignHCenter) == Qt::AlignHCenter) {
+        x += ((rectangle.size().width() / 2) - (w / 2));
+    }
+    return {x, y, w, h};
+}
+
+struct WallpaperCacheHeader
+{
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 width = 0;
+    qint32 height = 0;
+    qint64 bytesPerLine = 0;
+    qint32 format = 0;
+    // Only used by the shared wallpapers: the process which generates the
+    // wallpaper, and since when (in milliseconds since the epoch).
+    quint32 creatorProcessId = 0;
+    qint64 creationTime = 0;
+    quint32 reserved[6] = {};
+};
+// Keep the pixel data that follows the header nicely aligned.
+static_assert(sizeof(WallpaperCacheHeader) == 64);
+
+[[nodiscard]] static inline QString wallpaperCacheDirPath()
+{
+    static const QString path = []() -> QString {
+        const QString root = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+        if (root.isEmpty()) {
+            return {};
+        }
+        return QDir(root).filePath(kWallpaperCacheDirName);
+    }();
+    return path;
+}
+
+/*
+    Returns the name of the cache entry for the given parameters. Everything
+    that can change the result of the blur must be part of the key, including
+    the version of FramelessHelper itself, because the blur algorithm may
+    change between versions.
+ */
+[[nodiscard]] static inline QString wallpaperCacheKey(const QString &wallpaperFilePath,
+    const WallpaperAspectStyle aspectStyle, const QSize &size, const QSize &storageSize,
+    const qreal blurRadius, const bool exactBlur, const BlurBackend blurBackend, const int blurPasses)
+{
+    const QFileInfo fileInfo(wallpaperFilePath);
+    if (!fileInfo.exists()) {
+        return {};
+    }
+    QByteArray data = {};
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << fileInfo.absoluteFilePath() << fileInfo.lastModified().toMSecsSinceEpoch()
+           << fileInfo.size() << int(aspectStyle) << size << storageSize << blurRadius << exactBlur << int(blurBackend) << blurPasses
+           << QByteArray(FRAMELESSHELPER_VERSION_STR) << QByteArray(FRAMELESSHELPER_COMMIT_STR);
+    return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+}
+
+// Whether \a header describes a complete blurred wallpaper of \a size which fits into \a totalSize bytes.
+[[nodiscard]] static inline bool isWallpaperCacheHeaderValid(const WallpaperCacheHeader &header,
+    const QSize &size, const qint64 totalSize)
+{
+    return ((header.magic == kWallpaperCacheMagic)
+        && (header.version == kWallpaperCacheVersion)
+        && (header.width == size.width()) && (header.height == size.height())
+        && ((header.format == int(QImage::Format_RGB32)) || (header.format == int(QImage::Format_ARGB32_Premultiplied)))
+        && (header.bytesPerLine >= (qint64(header.width) * 4))
+        && ((qint64(sizeof(WallpaperCacheHeader)) + (header.bytesPerLine * header.height)) <= totalSize));
+}
+
+/*
+    Maps the cache entry into memory and wraps it into a QImage without copying
+    anything. The file is unmapped once the last copy of the image is gone.
+ */
+[[nodiscard]] static inline QImage loadCachedWallpaper(const QString &key, const QSize &size)
+{
+    const QString dirPath = wallpaperCacheDirPath();
+    if (key.isEmpty() || dirPath.isEmpty()) {
+        return {};
+    }
+    auto file = new QFile(QDir(dirPath).filePath(key + kWallpaperCacheFileSuffix));
+    if (!file->open(QFile::ReadOnly)) {
+        delete file;
+        return {};
+    }
+    const qint64 fileSize = file->size();
+    const uchar * const data = ((fileSize > qint64(sizeof(WallpaperCacheHeader)))
+        ? file->map(0, fileSize, QFileDevice::MapPrivateOption) : nullptr);
+    if (!data) {
+        delete file;
+        return {};
+    }
+    const auto header = reinterpret_cast<const WallpaperCacheHeader *>(data);
+    if (!isWallpaperCacheHeaderValid(*header, size, fileSize)) {
+        WARNING << "Ignoring the invalid wallpaper cache file:" << file->fileName();
+        delete file;
+        return {};
+    }
+    return QImage(data + sizeof(WallpaperCacheHeader), header->width, header->height,
+        int(header->bytesPerLine), static_cast<QImage::Format>(header->format),
+        [](void *info){ delete static_cast<QFile *>(info); }, file);
+}
+
+static inline void saveCachedWallpaper(const QString &key, const QImage &image)
+{
+    const QString dirPath = wallpaperCacheDirPath();
+    if (key.isEmpty() || dirPath.isEmpty() || image.isNull()) {
+        return;
+    }
+    QDir dir(dirPath);
+    if (!dir.exists() && !QDir().mkpath(dirPath)) {
+        WARNING << "Failed to create the wallpaper cache directory:" << dirPath;
+        return;
+    }
+    WallpaperCacheHeader header = {};
+    header.magic = kWallpaperCacheMagic;
+    header.version = kWallpaperCacheVersion;
+    header.width = image.width();
+    header.height = image.height();
+    header.bytesPerLine = image.bytesPerLine();
+    header.format = int(image.format());
+    // QSaveFile writes into a temporary file and renames it at last, so other
+    // processes will never see a half-written cache file.
+    QSaveFile file(dir.filePath(key + kWallpaperCacheFileSuffix));
+    if (!file.open(QFile::WriteOnly)) {
+        WARNING << "Failed to create the wallpaper cache file:" << file.fileName();
+        return;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(image.constBits()), image.sizeInBytes());
+    if (!file.commit()) {
+        WARNING << "Failed to write the wallpaper cache file:" << file.fileName();
+        return;
+    }
+    // Only keep the most recently written entries, the older ones are most
+    // likely about a wallpaper or a screen configuration which is gone.
+    const QFileInfoList entries = dir.entryInfoList({kWallpaperCacheFileFilter}, QDir::Files, QDir::Time);
+    for (qsizetype index = kMaximumWallpaperCacheFileCount; index < entries.size(); ++index) {
+        QFile::remove(entries.at(index).absoluteFilePath());
+    }
+}
+
+// Wraps the pixels of an attached segment into a QImage, the segment is detached with the last copy of it.
+[[nodiscard]] static inline QImage sharedWallpaperImage(QSharedMemory *memory)
+{
+    Q_ASSERT(memory);
+    if (!memory) {
+        return {};
+    }
+    const auto data = static_cast<const uchar *>(memory->constData());
+    const auto header = reinterpret_cast<const WallpaperCacheHeader *>(data);
+    return QImage(data + sizeof(WallpaperCacheHeader), header->width, header->height,
+        int(header->bytesPerLine), static_cast<QImage::Format>(header->format),
+        [](void *info){ delete static_cast<QSharedMemory *>(info); }, memory);
+}
+
+// Whether the process \a pid is still there, the process ID may have been reused by now though.
+[[nodiscard]] static inline bool isProcessRunning(const quint32 pid)
+{
+    if (pid == 0) {
+        return false;
+    }
+#ifdef Q_OS_WINDOWS
+    const HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, DWORD(pid));
+    if (!process) {
+        return (GetLastError() == ERROR_ACCESS_DENIED);
+    }
+    DWORD exitCode = 0;
+    const bool running = (GetExitCodeProcess(process, &exitCode) && (exitCode == STILL_ACTIVE));
+    CloseHandle(process);
+    return running;
+#else // !Q_OS_WINDOWS
+    return ((::kill(pid_t(pid), 0) == 0) || (errno == EPERM));
+#endif // Q_OS_WINDOWS
+}
+
+// Marks the (locked) segment as being generated by us.
+static inline void claimSharedWallpaper(QSharedMemory *memory)
+{
+    Q_ASSERT(memory);
+    if (!memory) {
+        return;
+    }
+    const auto header = static_cast<WallpaperCacheHeader *>(memory->data());
+    header->creatorProcessId = quint32(QCoreApplication::applicationPid());
+    header->creationTime = QDateTime::currentMSecsSinceEpoch();
+}
+
+// Whether the creator of a segment which isn't ready yet (after waiting for \a elapsed milliseconds) is gone.
+[[nodiscard]] static inline bool isSharedWallpaperStale(const WallpaperCacheHeader &header, const int elapsed)
+{
+    if (header.magic != 0) {
+        return false;
+    }
+    // A creator which crashed before it could claim the segment leaves nothing
+    // to check, just wait for as long as a live one would get.
+    if (header.creatorProcessId == 0) {
+        return (elapsed >= kSharedWallpaperTimeout);
+    }
+    const qint64 age = (QDateTime::currentMSecsSinceEpoch() - header.creationTime);
+    return (!isProcessRunning(header.creatorProcessId) || (age >= kSharedWallpaperTimeout));
+}
+
+/*
+    The waiting processes only attach to the segment \a segmentKey for reading:
+    the one which takes a stale segment over attaches once more to write to it,
+    and claims it if nobody else was faster. Returns the writable segment, or
+    nullptr if it can't be claimed.
+ */
+[[nodiscard]] static inline QSharedMemory *claimStaleSharedWallpaper(const QString &segmentKey, const int elapsed)
+{
+    auto memory = new QSharedMemory(segmentKey);
+    if (!memory->attach(QSharedMemory::ReadWrite)) {
+        WARNING << "Failed to attach to the shared wallpaper for writing:" << memory->errorString();
+        delete memory;
+        return nullptr;
+    }
+    memory->lock();
+    // Under the lock, so only one of the waiting processes takes over.
+    const bool stale = isSharedWallpaperStale(*static_cast<const WallpaperCacheHeader *>(memory->constData()), elapsed);
+    if (stale) {
+        claimSharedWallpaper(memory);
+    }
+    memory->unlock();
+    if (!stale) {
+        delete memory;
+        return nullptr;
+    }
+    return memory;
+}
+
+/*
+    Calls \a generate and publishes the result in the segment we claimed, or
+    marks the segment as failed if there's no usable result.
+ */
+[[nodiscard]] static inline QImage publishSharedWallpaper(QSharedMemory *memory, const QSize &size,
+    const std::function<QImage()> &generate)
+{
+    Q_ASSERT(memory);
+    if (!memory) {
+        return generate();
+    }
+    const qint64 bytesPerLine = (qint64(size.width()) * 4);
+    QImage image = generate();
+    const bool valid = (!image.isNull() && (image.size() == size) && (image.bytesPerLine() == bytesPerLine)
+        && ((image.format() == QImage::Format_RGB32) || (image.format() == QImage::Format_ARGB32_Premultiplied))
+        && ((qint64(sizeof(WallpaperCacheHeader)) + (bytesPerLine * size.height())) <= memory->size()));
+    memory->lock();
+    const auto header = static_cast<WallpaperCacheHeader *>(memory->data());
+    if (valid) {
+        std::memcpy(static_cast<uchar *>(memory->data()) + sizeof(WallpaperCacheHeader),
+            image.constBits(), size_t(bytesPerLine * size.height()));
+        header->version = kWallpaperCacheVersion;
+        header->width = image.width();
+        header->height = image.height();
+        header->bytesPerLine = image.bytesPerLine();
+        header->format = int(image.format());
+        header->magic = kWallpaperCacheMagic;
+    } else {
+        // Don't let the other processes wait for something that will never come.
+        header->magic = kSharedWallpaperFailureMagic;
+    }
+    memory->unlock();
+    if (!valid) {
+        delete memory;
+        return image;
+    }
+    // Only keep the shared copy, so that the suite holds one copy in RAM.
+    return sharedWallpaperImage(memory);
+}
+
+/*
+    Several processes of the same application suite usually show the same
+    wallpaper on the same screens, so the first one which needs a blurred
+    wallpaper creates a shared memory segment named after its cache \a key,
+    calls \a generate and publishes the result there. The other processes
+    attach to the segment instead of blurring the wallpaper themselves, and
+    wait for the first one if it's not done yet. The header is written last,
+    so it tells whether the segment is ready to be used. The segment is
+    destroyed once the last process has detached from it.
+
+    A segment can outlive the process which created it (SysV segments survive
+    a crash), so the creator leaves its process ID and a timestamp in the
+    header. If it's gone, or takes longer than a blur could ever take, the
+    waiting process takes the segment over and publishes its own result.
+
+    Falls back to \a generate if the segment can't be used for any reason.
+ */
+[[nodiscard]] static inline QImage loadSharedWallpaper(const QString &key, const QSize &size,
+    const std::function<QImage()> &generate, const std::function<bool()> &isCancelled)
+{
+    if (key.isEmpty() || size.isEmpty()) {
+        return generate();
+    }
+    const QString segmentKey = (kSharedWallpaperKeyPrefix + key);
+    const qint64 bytesPerLine = (qint64(size.width()) * 4);
+    const qint64 totalSize = (qint64(sizeof(WallpaperCacheHeader)) + (bytesPerLine * size.height()));
+    auto memory = new QSharedMemory(segmentKey);
+    if (memory->create(int(totalSize))) {
+        memory->lock();
+        claimSharedWallpaper(memory);
+        memory->unlock();
+        return publishSharedWallpaper(memory, size, generate);
+    }
+    if (memory->error() != QSharedMemory::AlreadyExists) {
+        WARNING << "Failed to create the shared wallpaper:" << memory->errorString();
+        delete memory;
+        return generate();
+    }
+    // Read only: nobody but the creator ever writes to the segment.
+    if (!memory->attach(QSharedMemory::ReadOnly)) {
+        // The segment may have been destroyed in the mean time, don't bother.
+        WARNING << "Failed to attach to the shared wallpaper:" << memory->errorString();
+        delete memory;
+        return generate();
+    }
+    for (int elapsed = 0; ; elapsed += kSharedWallpaperPollInterval) {
+        if (isCancelled()) {
+            delete memory;
+            return {};
+        }
+        memory->lock();
+        const auto header = static_cast<const WallpaperCacheHeader *>(memory->constData());
+        const quint32 magic = header->magic;
+        const bool valid = isWallpaperCacheHeaderValid(*header, size, memory->size());
+        const bool stale = isSharedWallpaperStale(*header, elapsed);
+        memory->unlock();
+        if (valid) {
+            DEBUG << "Attached to the blurred wallpaper of another process.";
+            return sharedWallpaperImage(memory);
+        }
+        if (stale) {
+            // Otherwise another process took over, or we can't write to the segment: keep waiting.
+            if (const auto writable = claimStaleSharedWallpaper(segmentKey, elapsed)) {
+                WARNING << "The process sharing the wallpaper is gone, taking over.";
+                delete memory;
+                return publishSharedWallpaper(writable, size, generate);
+            }
+        }
+        if ((magic != 0) || (elapsed >= kSharedWallpaperTimeout)) {
+            break;
+        }
+        QThread::msleep(kSharedWallpaperPollInterval);
+    }
+    WARNING << "The shared wallpaper is not available, generating our own one.";
+    delete memory;
+    return generate();
+}
+
+/*
+    Describes how a wallpaper is put on the screen, see "wallpaperPlacement()":
+    only 'sourceRect' of the wallpaper is visible, it's scaled to 'scaledSize'
+    and drawn at 'targetPos' of the canvas, or repeated all over it if 'tiled'.
+ */
+struct WallpaperPlacement
+{
+    QRect sourceRect = {};
+    QSize scaledSize = {};
+    QPoint targetPos = {};
+    bool tiled = false;
+};
+
+/*
+    Computes where a wallpaper of \a imageSize pixels goes on a screen of
+    \a screenSize pixels for the given \a aspectStyle, mapped to a canvas of
+    \a canvasSize pixels (the canvas may be smaller than the screen).
+ */
+[[nodiscard]] static inline WallpaperPlacement wallpaperPlacement(const QSize &imageSize,
+    const QSize &screenSize, const QSize &canvasSize, const WallpaperAspectStyle aspectStyle)
+{
+    if (imageSize.isEmpty() || screenSize.isEmpty() || canvasSize.isEmpty()) {
+        return {};
+    }
+    static constexpr const QPoint originPoint = {0, 0};
+    const QRect screenRect = {originPoint, screenSize};
+    const qreal scaleX = (qreal(canvasSize.width()) / qreal(screenSize.width()));
+    const qreal scaleY = (qreal(canvasSize.height()) / qreal(screenSize.height()));
+    const auto toCanvas = [scaleX, scaleY](const QRect &rect) -> QRect {
+        const QPoint topLeft = {qRound(qreal(rect.x()) * scaleX), qRound(qreal(rect.y()) * scaleY)};
+        const QPoint bottomRight = {qRound(qreal(rect.x() + rect.width()) * scaleX),
+            qRound(qreal(rect.y() + rect.height()) * scaleY)};
+        return {topLeft, QSize(qMax(1, (bottomRight.x() - topLeft.x())), qMax(1, (bottomRight.y() - topLeft.y())))};
+    };
+    WallpaperPlacement placement = {};
+    if (aspectStyle == WallpaperAspectStyle::Tile) {
+        placement.tiled = true;
+        // The tiles start at the top left corner, if the wallpaper is larger
+        // than the screen there's only one of them and it's clipped.
+        const bool singleTile = ((imageSize.width() >= screenSize.width()) && (imageSize.height() >= screenSize.height()));
+        placement.sourceRect = (singleTile ? screenRect : QRect(originPoint, imageSize));
+        placement.scaledSize = toCanvas(placement.sourceRect).size();
+        return placement;
+    }
+    QSize placedSize = imageSize;
+    if (aspectStyle != WallpaperAspectStyle::Center) {
+        Qt::AspectRatioMode mode = Qt::KeepAspectRatioByExpanding;
+        if (aspectStyle == WallpaperAspectStyle::Stretch) {
+            mode = Qt::IgnoreAspectRatio;
+        } else if (aspectStyle == WallpaperAspectStyle::Fit) {
+            mode = Qt::KeepAspectRatio;
+        }
+        placedSize.scale(screenSize, mode);
+    }
+    const QRect placedRect = alignedRect(Qt::LeftToRight, Qt::AlignCenter, placedSize, screenRect);
+    const QRect visibleRect = placedRect.intersected(screenRect);
+    if (placedSize.isEmpty() || visibleRect.isEmpty()) {
+        return {};
+    }
+    // Map the visible part back to the pixels of the wallpaper.
+    const qreal imageScaleX = (qreal(imageSize.width()) / qreal(placedSize.width()));
+    const qreal imageScaleY = (qreal(imageSize.height()) / qreal(placedSize.height()));
+    const QPoint sourceTopLeft = {qRound(qreal(visibleRect.x() - placedRect.x()) * imageScaleX),
+        qRound(qreal(visibleRect.y() - placedRect.y()) * imageScaleY)};
+    const QPoint sourceBottomRight = {qRound(qreal(visibleRect.x() + visibleRect.width() - placedRect.x()) * imageScaleX),
+        qRound(qreal(visibleRect.y() + visibleRect.height() - placedRect.y()) * imageScaleY)};
+    placement.sourceRect = QRect(sourceTopLeft, QSize(qMax(1, (sourceBottomRight.x() - sourceTopLeft.x())),
+        qMax(1, (sourceBottomRight.y() - sourceTopLeft.y())))).intersected(QRect(originPoint, imageSize));
+    const QRect targetRect = toCanvas(visibleRect);
+    placement.targetPos = targetRect.topLeft();
+    placement.scaledSize = targetRect.size();
+    return placement;
+}
+
+// Puts the already cropped and scaled wallpaper \a image on a canvas of \a size pixels.
+[[nodiscard]] static inline QImage composeWallpaperImage(const QImage &image,
+    const WallpaperPlacement &placement, const QSize &size)
+{
+    static constexpr const QPoint originPoint = {0, 0};
+    // The wallpaper covers the whole canvas already (Stretch & Fill), no need to copy it again.
+    if (!placement.tiled && (placement.targetPos == originPoint) && (image.size() == size) && !image.hasAlphaChannel()) {
+        return image.convertToFormat(QImage::Format_RGB32);
+    }
+    // The desktop is always opaque, so use Format_RGB32 to let the blur
+    // kernels skip the alpha channel completely. The areas which are not
+    // covered by the wallpaper (Center & Fit) are black, just like Windows.
+    QImage buffer(size, QImage::Format_RGB32);
+    buffer.fill(kDefaultBlackColor);
+    if (image.isNull()) {
+        return buffer;
+    }
+    QPainter bufferPainter(&buffer);
+    bufferPainter.setRenderHints(QPainter::Antialiasing |
+        QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
+    if (placement.tiled) {
+        bufferPainter.fillRect(QRect(originPoint, size), QBrush(image));
+    } else {
+        bufferPainter.drawImage(placement.targetPos, image);
+    }
+    return buffer;
+}
+
+/*
+    Scales and places \a image on an opaque canvas, the same way the desktop
+    shows the wallpaper on a screen of the given \a size (in device pixels)
+    with the given \a aspectStyle. The canvas is \a canvasSize pixels large,
+    which may be smaller than the screen (empty means the size of the screen).
+ */
+[[nodiscard]] static inline QImage placeWallpaperImage(QImage image, const QSize &size,
+    const WallpaperAspectStyle aspectStyle, QSize canvasSize = {})
+{
+    if (canvasSize.isEmpty()) {
+        canvasSize = size;
+    }
+    const WallpaperPlacement placement = wallpaperPlacement(image.size(), size, canvasSize, aspectStyle);
+    if (placement.sourceRect != QRect(QPoint(0, 0), image.size())) {
+        image = image.copy(placement.sourceRect);
+    }
+    if (image.size() != placement.scaledSize) {
+        image = image.scaled(placement.scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    return composeWallpaperImage(image, placement, canvasSize);
+}
+
+/*
+    Decodes the part of the wallpaper file which is visible on the screen,
+    straight at the size it's needed, and stores where it goes in \a placement.
+    JPEG photos are scaled down in the DCT domain by the decoder, which is
+    much cheaper than decoding all pixels of a 8K photo and scaling them.
+    The result still has to be put on the canvas, see "composeWallpaperImage()".
+ */
+[[nodiscard]] static inline QImage readWallpaperImage(const QString &wallpaperFilePath, const QSize &size,
+    const WallpaperAspectStyle aspectStyle, const QSize &canvasSize, WallpaperPlacement &placement)
+{
+    QImageReader reader(wallpaperFilePath);
+    const QSize imageSize = reader.size();
+    // The clip rect and the scaled size are applied before the orientation
+    // of the image, don't bother with these rare cases.
+    const bool rotated = (reader.autoTransform() && (reader.transformation() & QImageIOHandler::TransformationRotate90));
+    if (!imageSize.isValid() || rotated) {
+        QImage image = reader.read();
+        if (image.isNull()) {
+            WARNING << "Failed to read the wallpaper:" << reader.errorString();
+            return {};
+        }
+        placement = wallpaperPlacement(image.size(), size, canvasSize, aspectStyle);
+        if (placement.scaledSize.isEmpty()) {
+            return {};
+        }
+        if (placement.sourceRect != QRect(QPoint(0, 0), image.size())) {
+            image = image.copy(placement.sourceRect);
+        }
+        if (image.size() != placement.scaledSize) {
+            image = image.scaled(placement.scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+        return image;
+    }
+    placement = wallpaperPlacement(imageSize, size, canvasSize, aspectStyle);
+    if (placement.scaledSize.isEmpty()) {
+        return {};
+    }
+    if (placement.sourceRect != QRect(QPoint(0, 0), imageSize)) {
+        reader.setClipRect(placement.sourceRect);
+    }
+    reader.setScaledSize(placement.scaledSize);
+    const QImage image = reader.read();
+    if (image.isNull()) {
+        WARNING << "Failed to read the wallpaper:" << reader.errorString();
+        return {};
+    }
+    return image;
+}
+
+// How many threads the blur of a wallpaper may use when nothing asks for less.
+[[nodiscard]] static inline int wallpaperBlurThreadCount()
+{
+#ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
+    return 1;
+#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
+    return qt_blurThreadCount();
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+}
+
+#ifndef FRAMELESSHELPER_CORE_NO_PRIVATE
+// Scales a blurred wallpaper to the size it's stored at, bilinearly if it gets larger.
+[[nodiscard]] static inline QImage scaledBlurredWallpaper(QImage image, const QSize &size, const int threadCount)
+{
+    if (image.size() == size) {
+        return image;
+    }
+    if ((image.width() > size.width()) || (image.height() > size.height())) {
+        return image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    return qt_bilinearUpscaled(image, size, threadCount);
+}
+
+// How far a pixel is spread by a blur of the given radius: beyond it,
+// "expblur()" leaves less than 2/255 of it and the other backends even less.
+[[nodiscard]] static inline int qt_blurExtent(const qreal radius)
+{
+    return (qCeil(radius) + 1);
+}
+
+/*
+*  Blurs the 32-bit 'image' in place, one horizontal strip of (at least)
+*  'stripHeight' rows after the other. Each strip is copied together with
+*  'halo' rows above and below it, blurred by 'function' (which may replace
+*  it with an image of the same size and format), and only its own rows are
+*  written back. The original rows the next strip needs above it are saved
+*  before they are overwritten, so no second copy of the image is ever made.
+*/
+template<typename Function>
+static inline void qt_blurImageInStrips(QImage &image, const int halo, int stripHeight, const Function &function)
+{
+    Q_ASSERT(image.depth() == 32);
+    const int width = image.width();
+    const int height = image.height();
+    const qsizetype bytesPerLine = (qsizetype(width) * 4);
+    // The rows above the next strip must all come from the current one.
+    stripHeight = qMax(stripHeight, halo);
+    QImage previousRows = {};
+    for (int y = 0; y < height; y += stripHeight) {
+        const int rowCount = qMin(stripHeight, (height - y));
+        const int top = qMin(halo, y);
+        const int bottom = qMin(halo, (height - y - rowCount));
+        QImage strip(width, (top + rowCount + bottom), image.format());
+        for (int row = 0; row != top; ++row) {
+            std::memcpy(strip.scanLine(row), previousRows.constScanLine(previousRows.height() - top + row), bytesPerLine);
+        }
+        for (int row = 0; row != (rowCount + bottom); ++row) {
+            std::memcpy(strip.scanLine(top + row), image.constScanLine(y + row), bytesPerLine);
+        }
+        const int nextTop = qMin(halo, (y + rowCount));
+        previousRows = strip.copy(0, (top + rowCount - nextTop), width, nextTop);
+        function(strip);
+        Q_ASSERT(strip.height() == (top + rowCount + bottom));
+        for (int row = 0; row != rowCount; ++row) {
+            std::memcpy(image.scanLine(y + row), strip.constScanLine(top + row), bytesPerLine);
+        }
+    }
+}
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+
+/*
+    Blurs the placed wallpaper \a buffer (see "placeWallpaperImage()") and
+    returns it at \a storageSize, which may be smaller than the buffer:
+    there's no detail left after a blur this large, so the result is scaled
+    up again when it's painted. An empty \a storageSize keeps the size.
+    The buffer may already be \a reducedLevelCount pyramid levels smaller
+    than the screen, \a blurRadius is always in pixels of the screen.
+    The blur uses up to \a threadCount threads, including the calling one.
+ */
+[[nodiscard]] static inline QImage blurWallpaperImage(QImage buffer, const qreal blurRadius,
+    const bool exactBlur, const BlurBackend blurBackend, const int blurPasses, const int threadCount,
+    QSize storageSize = {}, const int reducedLevelCount = 0)
+{
+    if (storageSize.isEmpty()) {
+        storageSize = buffer.size();
+    }
+#ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
+    Q_UNUSED(blurRadius);
+    Q_UNUSED(exactBlur);
+    Q_UNUSED(blurBackend);
+    Q_UNUSED(blurPasses);
+    Q_UNUSED(threadCount);
+    Q_UNUSED(reducedLevelCount);
+    if (buffer.size() == storageSize) {
+        return buffer;
+    }
+    return buffer.scaled(storageSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
+    const AbstractBlurBackend * const backend = qt_blurBackend(blurBackend);
+    if (!exactBlur) {
+        if (reducedLevelCount > 0) {
+            // Don't go down any further, the buffer is at the coarsest level already.
+            const qreal radius = (blurRadius / qreal(1 << reducedLevelCount));
+            backend->blur(buffer, radius, blurPasses, threadCount);
+            return scaledBlurredWallpaper(std::move(buffer), storageSize, threadCount);
+        }
+        return qt_pyramidBlurImage(std::move(buffer), blurRadius, backend, blurPasses, threadCount, storageSize);
+    }
+    if ((buffer.format() != QImage::Format_ARGB32_Premultiplied)
+        && (buffer.format() != QImage::Format_RGB32)) {
+        buffer = buffer.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    // The exact blur works at full resolution: do it in strips, so that at most
+    // a few strips are needed on top of the buffer itself. The halo is even to
+    // keep the strips of the exponential blur aligned to its half scaled copy.
+    const int halo = ((qt_blurExtent(blurRadius) + 1) & ~1);
+    qt_blurImageInStrips(buffer, halo, kWallpaperBlurStripHeight, [backend, blurBackend, blurRadius, blurPasses, threadCount](QImage &strip){
+        if (blurBackend != BlurBackend::Exponential) {
+            backend->blur(strip, blurRadius, blurPasses, threadCount);
+            return;
+        }
+        // Same as "qt_blurImage()": half of the radius at half of the resolution.
+        if ((blurRadius >= 4) && (strip.width() >= 2) && (strip.height() >= 2)) {
+            QImage half = qt_halfScaled(strip, threadCount);
+            expblur<12, 10, false>(half, (blurRadius * 0.5), (blurPasses >= 2), 0, threadCount);
+            strip = qt_bilinearUpscaled(half, strip.size(), threadCount);
+        } else {
+            expblur<12, 10, false>(strip, blurRadius, (blurPasses >= 2), 0, threadCount);
+        }
+    });
+    return scaledBlurredWallpaper(std::move(buffer), storageSize, threadCount);
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+}
+
+#ifndef FRAMELESSHELPER_CORE_NO_PRIVATE
+/*
+    A tiled wallpaper (Tile) is periodic, and so is its blur: blur one \a tile
+    with wrap-around edges and repeat it, instead of blurring the whole canvas.
+    The clamping blur backends see the neighbouring tiles through a halo of the
+    tile's own pixels. Returns a null image if that's not cheaper than the canvas.
+ */
+[[nodiscard]] static inline QImage blurWallpaperTile(const QImage &tile, const QSize &canvasSize,
+    const qreal blurRadius, const bool exactBlur, const BlurBackend blurBackend, const int blurPasses,
+    const int threadCount, const int reducedLevelCount)
+{
+    const int halo = qt_blurExtent(blurRadius / qreal(1 << reducedLevelCount));
+    const QSize paddedSize = {(tile.width() + (halo * 2)), (tile.height() + (halo * 2))};
+    if ((qint64(paddedSize.width()) * qint64(paddedSize.height() * 2)) > (qint64(canvasSize.width()) * qint64(canvasSize.height()))) {
+        return {};
+    }
+    QImage padded(paddedSize, QImage::Format_RGB32);
+    padded.fill(kDefaultBlackColor);
+    QPainter painter(&padded);
+    painter.setBrushOrigin(halo, halo);
+    painter.fillRect(QRect(QPoint(0, 0), paddedSize), QBrush(tile));
+    painter.end();
+    const QImage blurred = blurWallpaperImage(std::move(padded), blurRadius,
+        exactBlur, blurBackend, blurPasses, threadCount, {}, reducedLevelCount);
+    return blurred.copy(QRect(QPoint(halo, halo), tile.size()));
+}
+
+// The bounding rectangle of all pixels of the (opaque) \a image which are not \a color.
+[[nodiscard]] static inline QRect qt_nonConstantRect(const QImage &image, const QRgb color)
+{
+    Q_ASSERT(image.depth() == 32);
+    const int width = image.width();
+    const int height = image.height();
+    const auto row = [&image](const int y) -> const QRgb * {
+        return reinterpret_cast<const QRgb *>(image.constScanLine(y));
+    };
+    const auto isConstantRow = [&row, width, color](const int y) -> bool {
+        const QRgb * const line = row(y);
+        return std::all_of(line, (line + width), [color](const QRgb pixel){ return (pixel == color); });
+    };
+    int top = 0;
+    while ((top != height) && isConstantRow(top)) {
+        ++top;
+    }
+    if (top == height) {
+        return {};
+    }
+    int bottom = (height - 1);
+    while (isConstantRow(bottom)) {
+        --bottom;
+    }
+    const auto isConstantColumn = [&row, top, bottom, color](const int x) -> bool {
+        for (int y = top; y <= bottom; ++y) {
+            if (row(y)[x] != color) {
+                return false;
+            }
+        }
+        return true;
+    };
+    int left = 0;
+    while (isConstantColumn(left)) {
+        ++left;
+    }
+    int right = (width - 1);
+    while (isConstantColumn(right)) {
+        --right;
+    }
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+/*
+    The placed wallpaper often has large areas of one single color: the black
+    bars around a centered or fitted wallpaper (Center & Fit), or the plain
+    background of a small logo. Blurring them doesn't change anything, so only
+    the rest (plus the reach of the blur) is blurred and they are just filled.
+    The \a buffer is blurred in place. Returns false (and leaves it alone) if
+    that's not much cheaper than blurring the whole canvas.
+ */
+[[nodiscard]] static inline bool blurWallpaperContent(QImage &buffer,
+    const qreal blurRadius, const bool exactBlur, const BlurBackend blurBackend, const int blurPasses,
+    const int threadCount, const int reducedLevelCount)
+{
+    // Always the case for a placed wallpaper, see "composeWallpaperImage()".
+    if (buffer.format() != QImage::Format_RGB32) {
+        return false;
+    }
+    const QRgb color = reinterpret_cast<const QRgb *>(buffer.constScanLine(0))[0];
+    const QRect contentRect = qt_nonConstantRect(buffer, color);
+    if (contentRect.isEmpty()) {
+        return true;
+    }
+    const int halo = qt_blurExtent(blurRadius / qreal(1 << reducedLevelCount));
+    // The content spreads up to one halo around it, and these pixels in turn need
+    // one more halo of their neighbours, because the blur fades in from black at
+    // the edges of the input instead of clamping to the constant color.
+    const QRect blurRect = contentRect.adjusted(-halo, -halo, halo, halo).intersected(buffer.rect());
+    const QRect inputRect = blurRect.adjusted(-halo, -halo, halo, halo).intersected(buffer.rect());
+    if ((qint64(inputRect.width()) * qint64(inputRect.height() * 4)) > (qint64(buffer.width()) * qint64(buffer.height() * 3))) {
+        return false;
+    }
+    // Blur the input where it is, through an image which shares its pixels with the
+    // buffer: the exact blur goes through it in strips, the others blur it in place.
+    uchar * const inputBits = (buffer.bits() + (qsizetype(inputRect.y()) * buffer.bytesPerLine()) + (qsizetype(inputRect.x()) * 4));
+    const QImage blurred = blurWallpaperImage(QImage(inputBits, inputRect.width(), inputRect.height(), buffer.bytesPerLine(), buffer.format()),
+        blurRadius, exactBlur, blurBackend, blurPasses, threadCount, {}, reducedLevelCount);
+    QPainter painter(&buffer);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    if (blurred.constBits() != inputBits) {
+        // A backend which didn't blur in place.
+        painter.drawImage(blurRect.topLeft(), blurred, QRect((blurRect.topLeft() - inputRect.topLeft()), blurRect.size()));
+    }
+    // Only the pixels within the reach of the content keep the blur, the halo around
+    // them was only there to feed it and goes back to the constant color.
+    painter.setClipRegion(QRegion(inputRect).subtracted(QRegion(blurRect)));
+    painter.fillRect(inputRect, QColor::fromRgba(color));
+    painter.end();
+    return true;
+}
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+
+/*
+    Decodes, places and blurs the wallpaper for a screen of the given \a size
+    (in device pixels), with a blur of \a blurRadius device pixels in
+    \a blurPasses passes on up to \a threadCount threads, and
+    returns it at \a storageSize. This function doesn't touch anything but
+    QImage, so it's safe to call it from any thread. It returns a null image
+    on failure or if \a isCancelled returns true at any point.
+ */
+[[nodiscard]] static inline QImage generateBlurredWallpaper(const QSize &size, const QSize &storageSize,
+    const QString &wallpaperFilePath, const WallpaperAspectStyle aspectStyle,
+    const qreal blurRadius, const bool exactBlur, const BlurBackend blurBackend, const int blurPasses,
+    const int threadCount, const std::function<bool()> &isCancelled)
+{
+    // The fast blur would halve the placed wallpaper a few times before
+    // blurring it anyway, so decode and place it at the coarsest level
+    // right away and skip the full resolution buffer altogether.
+#ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
+    const int levelCount = 0;
+#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
+    const int levelCount = (exactBlur ? 0 : qt_pyramidLevelCount(size, blurRadius));
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+    QSize canvasSize = size;
+    for (int level = 0; level != levelCount; ++level) {
+        canvasSize = QSize((canvasSize.width() / 2), (canvasSize.height() / 2));
+    }
+    WallpaperPlacement placement = {};
+    QImage image = readWallpaperImage(wallpaperFilePath, size, aspectStyle, canvasSize, placement);
+    if (image.isNull()) {
+        WARNING << "Failed to load the wallpaper:" << wallpaperFilePath;
+        return {};
+    }
+    if (isCancelled()) {
+        return {};
+    }
+#ifndef FRAMELESSHELPER_CORE_NO_PRIVATE
+    // Only if the tile is repeated in both directions: a clipped tile is not periodic.
+    // The last row and column of tiles may still be clipped by the edges of the screen,
+    // the blur treats them as complete tiles there, which looks just as good.
+    if (placement.tiled && (image.width() <= canvasSize.width()) && (image.height() <= canvasSize.height())) {
+        const QImage tile = blurWallpaperTile(image, canvasSize, blurRadius,
+            exactBlur, blurBackend, blurPasses, threadCount, levelCount);
+        if (!tile.isNull()) {
+            return scaledBlurredWallpaper(composeWallpaperImage(tile, placement, canvasSize), storageSize, threadCount);
+        }
+    }
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+    QImage buffer = composeWallpaperImage(image, placement, canvasSize);
+    // The buffer may share its pixels with the decoded image (Stretch & Fill):
+    // drop the image, or blurring the buffer in place would copy all of them.
+    image = {};
+#ifndef FRAMELESSHELPER_CORE_NO_PRIVATE
+    if (!placement.tiled) {
+        if (blurWallpaperContent(buffer, blurRadius, exactBlur, blurBackend, blurPasses, threadCount, levelCount)) {
+            return scaledBlurredWallpaper(std::move(buffer), storageSize, threadCount);
+        }
+        if (isCancelled()) {
+            return {};
+        }
+    }
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+    return blurWallpaperImage(std::move(buffer), blurRadius, exactBlur, blurBackend, blurPasses, threadCount, storageSize, levelCount);
+}
+
+/*
+    The first level of the progressive blur: the wallpaper is decoded, placed and
+    blurred at 1/32 of the size of the screen, which costs next to nothing, so
+    that there's a plausible backdrop to paint until the real one is ready.
+ */
+[[nodiscard]] static inline QImage generatePreviewWallpaper(const QSize &size, const QString &wallpaperFilePath,
+    const WallpaperAspectStyle aspectStyle, const qreal blurRadius, const BlurBackend blurBackend, const int blurPasses)
+{
+    const QSize canvasSize = {qMax(1, (size.width() / kPreviewWallpaperScale)), qMax(1, (size.height() / kPreviewWallpaperScale))};
+    WallpaperPlacement placement = {};
+    const QImage image = readWallpaperImage(wallpaperFilePath, size, aspectStyle, canvasSize, placement);
+    if (image.isNull()) {
+        return {};
+    }
+    QImage buffer = composeWallpaperImage(image, placement, canvasSize);
+#ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
+    Q_UNUSED(blurRadius);
+    Q_UNUSED(blurBackend);
+    Q_UNUSED(blurPasses);
+#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
+    // Far too small to be worth any other thread.
+    qt_blurBackend(blurBackend)->blur(buffer, (blurRadius / qreal(kPreviewWallpaperScale)), blurPasses, 1);
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+    return buffer;
+}
+
+/*
+    The Mica brush only depends on the theme, the tint color and the two opacities,
+    so pack them into one number and share the brushes between all instances.
+    QPainter only has 8 bits of precision for the opacity, so do we.
+ */
+[[nodiscard]] static inline quint64 micaBrushKey(const bool dark, const QColor &tintColor,
+    const qreal tintOpacity, const qreal noiseOpacity)
+{
+    const auto opacity = [](const qreal value) -> quint64 {
+        return quint64(qRound(qBound(qreal(0), value, qreal(1)) * qreal(255)));
+    };
+    return ((quint64(tintColor.rgba()) << 17) | (opacity(tintOpacity) << 9) | (opacity(noiseOpacity) << 1) | quint64(dark));
+}
+
+[[nodiscard]] static inline QBrush createMicaBrush(const quint64 key)
+{
+#ifndef FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
+    initResource();
+    static const QImage noiseTexture = QImage(kNoiseImageFilePath);
+#endif // FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
+    const bool dark = (key & 1);
+    const qreal noiseOpacity = (qreal((key >> 1) & 0xFF) / qreal(255));
+    const qreal tintOpacity = (qreal((key >> 9) & 0xFF) / qreal(255));
+    const QColor tintColor = QColor::fromRgba(QRgb(key >> 17));
+    QImage micaTexture = QImage(QSize(64, 64), QImage::Format_ARGB32_Premultiplied);
+    QColor fillColor = (dark ? kDefaultSystemDarkColor : kDefaultSystemLightColor2);
+    fillColor.setAlphaF(0.9f);
+    micaTexture.fill(fillColor);
+    QPainter painter(&micaTexture);
+    painter.setRenderHints(QPainter::Antialiasing |
+        QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
+    painter.setOpacity(tintOpacity);
+    const QRect rect = {QPoint(0, 0), micaTexture.size()};
+    painter.fillRect(rect, tintColor);
+    painter.setOpacity(noiseOpacity);
+#ifndef FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
+    painter.fillRect(rect, QBrush(noiseTexture));
+#endif // FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
+    painter.end();
+    return QBrush(micaTexture);
+}
+
+static inline QBrush cachedMicaBrush(const quint64 key)
+{
+    {
+        const QMutexLocker locker(&g_micaMaterialData()->mutex);
+        QList<QPair<quint64, QBrush>> &brushes = g_micaMaterialData()->micaBrushes;
+        for (qsizetype index = 0; index != brushes.size(); ++index) {
+            if (brushes.at(index).first == key) {
+                brushes.append(brushes.takeAt(index));
+                return brushes.constLast().second;
+            }
+        }
+    }
+    // Painting the texture doesn't need the lock. In the unlikely case that two
+    // threads create the same brush at the same time, both end up in the cache
+    // and the older one is evicted eventually.
+    const QBrush brush = createMicaBrush(key);
+    const QMutexLocker locker(&g_micaMaterialData()->mutex);
+    QList<QPair<quint64, QBrush>> &brushes = g_micaMaterialData()->micaBrushes;
+    // The tint color is rarely changed, but don't let an animated one grow the cache
+    // forever: evict the least recently used brushes, the others are still wanted.
+    while (brushes.size() >= kMaximumMicaBrushCacheSize) {
+        brushes.removeFirst();
+    }
+    brushes.append(qMakePair(key, brush));
+    return brush;
+}
+
+// Always called on the GUI thread, after a new wallpaper (or a screen change) has been published.
+static inline void notifyBlurredWallpaperReady()
+{
+    if (g_micaMaterialData.isDestroyed()) {
+        return;
+    }
+    g_micaMaterialData()->mutex.lock();
+    const QList<QPointer<MicaMaterialPrivate>> instances = g_micaMaterialData()->instances;
+    g_micaMaterialData()->mutex.unlock();
+    for (auto &&instance : std::as_const(instances)) {
+        if (instance) {
+            instance->emitShouldRedraw();
+        }
+    }
+}
+
+[[nodiscard]] static inline BlurBackend micaMaterialBlurBackend()
+{
+    static const int environmentValue = qEnvironmentVariableIntValue(kMicaMaterialBlurBackendVar.constData());
+    const int value = FramelessConfig::instance()->getInternal<int>(kMicaMaterialBlurBackendKey).value_or(environmentValue);
+    if ((value < int(BlurBackend::Exponential)) || (value > int(BlurBackend::RecursiveGaussian))) {
+        WARNING << "Unknown blur backend:" << value;
+        return BlurBackend::Exponential;
+    }
+    return static_cast<BlurBackend>(value);
+}
+
+[[nodiscard]] static inline int micaMaterialWallpaperDownscaleFactor()
+{
+    static const int environmentValue = qEnvironmentVariableIntValue(kMicaMaterialWallpaperDownscaleFactorVar.constData());
+    int factor = FramelessConfig::instance()->getInternal<int>(kMicaMaterialWallpaperDownscaleFactorKey).value_or(environmentValue);
+    if (factor <= 0) {
+        factor = kDefaultWallpaperDownscaleFactor;
+    }
+    return qMin(factor, kMaximumMicaMaterialDownsampleFactor);
+}
+
+// In bytes.
+[[nodiscard]] static inline qint64 micaMaterialMemoryBudget()
+{
+    static const int environmentValue = qEnvironmentVariableIntValue(kMicaMaterialMemoryBudgetVar.constData());
+    int budget = FramelessConfig::instance()->getInternal<int>(kMicaMaterialMemoryBudgetKey).value_or(environmentValue);
+    if (budget <= 0) {
+        budget = kDefaultMemoryBudget;
+    }
+    return (qint64(budget) * 1024 * 1024);
+}
+
+/*
+    Returns the recently generated blurred wallpaper of \a key (see "wallpaperCacheKey()")
+    and marks it as the most recently used one, or a null image if there's none.
+ */
+[[nodiscard]] static inline QImage recentWallpaper(const QString &key)
+{
+    if (key.isEmpty() || g_micaMaterialData.isDestroyed()) {
+        return {};
+    }
+    const QMutexLocker locker(&g_micaMaterialData()->mutex);
+    QList<QPair<QString, QImage>> &wallpapers = g_micaMaterialData()->recentWallpapers;
+    for (qsizetype index = 0; index != wallpapers.size(); ++index) {
+        if (wallpapers.at(index).first == key) {
+            wallpapers.append(wallpapers.takeAt(index));
+            return wallpapers.constLast().second;
+        }
+    }
+    return {};
+}
+
+/*
+    Keeps \a image around, so that switching back to a recent wallpaper (which
+    is what slideshows do all the time) doesn't have to blur anything. The least
+    recently used ones go once they take more than the memory budget together.
+ */
+static inline void rememberRecentWallpaper(const QString &key, const QImage &image)
+{
+    if (key.isEmpty() || image.isNull() || g_micaMaterialData.isDestroyed()) {
+        return;
+    }
+    const qint64 budget = micaMaterialMemoryBudget();
+    const QMutexLocker locker(&g_micaMaterialData()->mutex);
+    QList<QPair<QString, QImage>> &wallpapers = g_micaMaterialData()->recentWallpapers;
+    for (qsizetype index = 0; index != wallpapers.size(); ++index) {
+        if (wallpapers.at(index).first == key) {
+            wallpapers.removeAt(index);
+            break;
+        }
+    }
+    wallpapers.append(qMakePair(key, image));
+    qint64 usedBytes = 0;
+    for (auto &&wallpaper : std::as_const(wallpapers)) {
+        usedBytes += wallpaper.second.sizeInBytes();
+    }
+    // The most recent one always stays, whatever its size.
+    while ((usedBytes > budget) && (wallpapers.size() > 1)) {
+        usedBytes -= wallpapers.takeFirst().second.sizeInBytes();
+    }
+}
+
+/*
+    The image the slideshow of \a dirPath most likely shows after \a filePath:
+    the next one in alphabetical order, like the desktop environments do unless
+    they are told to shuffle. Returns an empty string if there's none.
+ */
+[[nodiscard]] static inline QString nextSlideshowWallpaper(const QString &dirPath, const QString &filePath)
+{
+    if (dirPath.isEmpty() || filePath.isEmpty()) {
+        return {};
+    }
+    static const QStringList nameFilters = []() -> QStringList {
+        QStringList filters = {};
+        const QList<QByteArray> formats = QImageReader::supportedImageFormats();
+        for (auto &&format : std::as_const(formats)) {
+            filters.append(FRAMELESSHELPER_STRING_LITERAL("*.") + QString::fromLatin1(format));
+        }
+        return filters;
+    }();
+    const QFileInfoList entries = QDir(dirPath).entryInfoList(nameFilters, QDir::Files, (QDir::Name | QDir::IgnoreCase));
+    if (entries.size() < 2) {
+        return {};
+    }
+    const QString absoluteFilePath = QFileInfo(filePath).absoluteFilePath();
+    for (qsizetype index = 0; index != entries.size(); ++index) {
+        if (entries.at(index).absoluteFilePath() == absoluteFilePath) {
+            return entries.at((index + 1) % entries.size()).absoluteFilePath();
+        }
+    }
+    return {};
+}
+
+/*
+    Chooses the fraction of the screen resolution a blurred wallpaper of \a size
+    device pixels is stored at: \a preferredFactor, or a smaller one if the
+    wallpaper wouldn't fit into the \a availableBytes of the memory budget.
+ */
+[[nodiscard]] static inline int wallpaperDownscaleFactor(const QSize &size, const qint64 availableBytes,
+    const int preferredFactor)
+{
+    int factor = qBound(1, preferredFactor, kMaximumMicaMaterialDownsampleFactor);
+    while (factor < kMaximumMicaMaterialDownsampleFactor) {
+        const qint64 width = ((size.width() + factor - 1) / factor);
+        const qint64 height = ((size.height() + factor - 1) / factor);
+        if ((width * height * 4) <= availableBytes) {
+            break;
+        }
+        factor = qMin((factor * 2), kMaximumMicaMaterialDownsampleFactor);
+    }
+    return factor;
+}
+
+struct WallpaperQuality
+{
+    qreal blurRadius = 0.0; // In device independent pixels.
+    int downscaleFactor = 0;
+    int blurPasses = 0;
+};
+
+/*
+    Packs the quality settings of a MicaMaterial into one number, so that all
+    the instances using the same settings share their blurred wallpapers:
+    bits 0-1 hold the tier, bits 2-4 the number of passes, bits 5-9 the
+    downscale factor and bits 10-20 the blur radius, rounded to whole pixels
+    (a fraction of a pixel makes no visible difference to a blur this large,
+    so it isn't worth a wallpaper of its own). The last three are zero unless
+    they have been set explicitly, in which case they override the ones of
+    the tier.
+ */
+[[nodiscard]] static inline quint32 wallpaperQualityKey(const MicaMaterialQuality quality,
+    const std::optional<qreal> &blurRadius, const std::optional<int> &downscaleFactor,
+    const std::optional<int> &blurPasses)
+{
+    return (quint32(int(quality) & 0x3) | (quint32(blurPasses.value_or(0) & 0x7) << 2)
+        | (quint32(downscaleFactor.value_or(0) & 0x1F) << 5)
+        | (quint32(qRound(blurRadius.value_or(0.0)) & 0x7FF) << 10));
+}
+
+// The tier the quality \a key currently stands for, never "Auto".
+[[nodiscard]] static inline MicaMaterialQuality effectiveQualityTier(const quint32 key)
+{
+    const auto tier = static_cast<MicaMaterialQuality>(key & 0x3);
+    if (tier != MicaMaterialQuality::Auto) {
+        return tier;
+    }
+    if (g_micaMaterialData.isDestroyed()) {
+        return MicaMaterialQuality::High;
+    }
+    return static_cast<MicaMaterialQuality>(g_micaMaterialData()->autoQuality.loadAcquire());
+}
+
+[[nodiscard]] static inline WallpaperQuality resolveWallpaperQuality(const quint32 key)
+{
+    // The configured downscale factor is the one of the high quality, the other
+    // tiers trade the resolution of the wallpaper and the passes for speed.
+    const int configuredFactor = micaMaterialWallpaperDownscaleFactor();
+    WallpaperQuality quality = {};
+    switch (effectiveQualityTier(key)) {
+    case MicaMaterialQuality::Low:
+        quality = {kDefaultBlurRadius, kMaximumMicaMaterialDownsampleFactor, 1};
+        break;
+    case MicaMaterialQuality::Medium:
+        quality = {kDefaultBlurRadius, qMin(qMax((configuredFactor * 2), 8), kMaximumMicaMaterialDownsampleFactor), kDefaultBlurPasses};
+        break;
+    case MicaMaterialQuality::Auto:
+    case MicaMaterialQuality::High:
+        quality = {kDefaultBlurRadius, configuredFactor, kDefaultBlurPasses};
+        break;
+    }
+    if (const int blurPasses = int((key >> 2) & 0x7); blurPasses > 0) {
+        quality.blurPasses = blurPasses;
+    }
+    if (const int downscaleFactor = int((key >> 5) & 0x1F); downscaleFactor > 0) {
+        quality.downscaleFactor = downscaleFactor;
+    }
+    if (const int blurRadius = int((key >> 10) & 0x7FF); blurRadius > 0) {
+        quality.blurRadius = qreal(blurRadius);
+    }
+    return quality;
+}
+
+/*
+    The "Auto" quality starts with the high one and steps down a tier each time
+    generating a wallpaper with \a tier took longer than it should have. It only
+    applies to the wallpapers generated from now on: regenerating the current
+    ones right away would only make a slow machine even busier.
+ */
+static inline void maybeLowerAutoQuality(const MicaMaterialQuality tier, const qint64 elapsed)
+{
+    if ((elapsed <= kAutoQualityStepDownThreshold) || (tier == MicaMaterialQuality::Low)
+        || g_micaMaterialData.isDestroyed()) {
+        return;
+    }
+    const MicaMaterialQuality lower = ((tier == MicaMaterialQuality::High)
+        ? MicaMaterialQuality::Medium : MicaMaterialQuality::Low);
+    if (g_micaMaterialData()->autoQuality.testAndSetOrdered(int(tier), int(lower))) {
+        INFO << "Generating the blurred wallpaper took" << elapsed << "ms, the automatic quality is lowered to" << lower;
+    }
+}
+
+// The mutex must be locked. Forgets about the wallpapers of the qualities no
+// instance uses anymore, except the one of \a key which is about to be requested.
+static inline void pruneUnusedWallpapers(QHash<WallpaperKey, ScreenWallpaperData> &wallpapers, const WallpaperKey &key)
+{
+    QSet<quint32> qualities = {key.second};
+    for (auto &&instance : std::as_const(g_micaMaterialData()->instances)) {
+        if (instance) {
+            qualities.insert(instance->wallpaperQuality());
+        }
+    }
+    for (auto it = wallpapers.begin(); it != wallpapers.end();) {
+        if (qualities.contains(it.key().second)) {
+            ++it;
+        } else {
+            it = wallpapers.erase(it);
+        }
+    }
+}
+
+// The size of the blurred wallpaper of a screen, in device pixels.
+[[nodiscard]] static inline QSize screenWallpaperSize(const ScreenInfo &info)
+{
+    return (QSizeF(info.geometry.size()) * info.devicePixelRatio).toSize();
+}
+
+// Only call it on the GUI thread, the painters use the screens of their snapshot.
+[[nodiscard]] static inline ScreenInfo currentScreenInfo(const QScreen *screen)
+{
+    Q_ASSERT(screen);
+    if (!screen) {
+        return {};
+    }
+    return {screen->geometry(), screen->devicePixelRatio()};
+}
+
+// Whether the wallpaper of \a screen has been requested for the screen \a info and \a quality already.
+[[nodiscard]] static inline bool isScreenWallpaperRequested(const WallpaperSnapshot &snapshot,
+    const QScreen *screen, const ScreenInfo &info, const quint32 quality)
+{
+    Q_ASSERT(screen);
+    if (!screen) {
+        return false;
+    }
+    const auto it = snapshot.wallpapers.constFind({screen, quality});
+    if (it == snapshot.wallpapers.constEnd()) {
+        return false;
+    }
+    return ((it->size == screenWallpaperSize(info)) && qFuzzyCompare(it->devicePixelRatio, info.devicePixelRatio));
+}
+
+// Background work gets threads of its own: the threads of the global pool are
+// shared with the application, and on Linux their priority can't even be set
+// back once it has been lowered (the idle scheduling policy sticks).
+Q_GLOBAL_STATIC(QThreadPool, g_idleThreadPool)
+
+/*
+    Runs \a function at idle priority and waits for it to finish. The blur it
+    runs must not wake up the blur threads (they run at normal priority), so
+    it has to ask for a single thread, see "qt_blurParallel()".
+ */
+template<typename Function>
+[[nodiscard]] static inline QImage runAtIdlePriority(const Function &function)
+{
+    if (g_idleThreadPool.isDestroyed()) {
+        return {};
+    }
+    QThreadPool * const pool = g_idleThreadPool();
+    if (pool->maxThreadCount() != 1) {
+        pool->setMaxThreadCount(1);
+    }
+    QImage result = {};
+    QSemaphore finished = {};
+    pool->start(new FunctionRunnable([&function, &result, &finished](){
+        // Nothing else ever runs on the threads of this pool.
+        QThread::currentThread()->setPriority(QThread::IdlePriority);
+        result = function();
+        finished.release();
+    }));
+    finished.acquire();
+    return result;
+}
+
+/*
+    Slideshows change the wallpaper every few minutes: blur the next image of the
+    slideshow of \a slideshowDirPath in advance (with the same parameters as the
+    current one) and keep it in the recent wallpapers, so that the switch is
+    instant. It runs at idle priority, on a single thread only, and stops as
+    soon as \a isCancelled returns true. Nothing is written to the disk cache.
+ */
+static inline void prefetchSlideshowWallpaper(const QString &slideshowDirPath, const QString &wallpaperFilePath,
+    const QSize &size, const QSize &storageSize, const WallpaperAspectStyle aspectStyle, const qreal blurRadius,
+    const bool exactBlur, const BlurBackend blurBackend, const int blurPasses, const std::function<bool()> &isCancelled)
+{
+    const QString nextFilePath = nextSlideshowWallpaper(slideshowDirPath, wallpaperFilePath);
+    if (nextFilePath.isEmpty() || isCancelled()) {
+        return;
+    }
+    const QString key = wallpaperCacheKey(nextFilePath, aspectStyle, size, storageSize, blurRadius, exactBlur, blurBackend, blurPasses);
+    if (key.isEmpty() || !recentWallpaper(key).isNull()) {
+        return;
+    }
+    const QImage image = runAtIdlePriority([&]() -> QImage {
+        return generateBlurredWallpaper(size, storageSize, nextFilePath, aspectStyle,
+            blurRadius, exactBlur, blurBackend, blurPasses, 1, isCancelled);
+    });
+    if (image.isNull() || isCancelled()) {
+        return;
+    }
+    DEBUG << "Prefetched the next wallpaper of the slideshow:" << nextFilePath;
+    rememberRecentWallpaper(key, image);
+}
+
+/*
+    Hands the blurred wallpaper of \a key over to the painters, unless the request
+    of \a generation has been superseded by a newer one (or the screen is gone).
+    Returns whether it has been published.
+ */
+static inline bool publishScreenWallpaper(const WallpaperKey &key, const int generation,
+    const QImage &image, const qreal imageDevicePixelRatio)
+{
+    if (g_micaMaterialData.isDestroyed()) {
+        return false;
+    }
+    {
+        const QMutexLocker locker(&g_micaMaterialData()->mutex);
+        QHash<WallpaperKey, ScreenWallpaperData> wallpapers = g_micaMaterialData()->wallpaperSnapshot->wallpapers;
+        const auto it = wallpapers.find(key);
+        if ((it == wallpapers.end()) || (it->generation != generation)) {
+            return false;
+        }
+        it->image = image;
+        it->imageDevicePixelRatio = imageDevicePixelRatio;
+        publishWallpaperSnapshot(std::move(wallpapers));
+    }
+    if (QCoreApplication * const app = QCoreApplication::instance()) {
+        QMetaObject::invokeMethod(app, [](){ notifyBlurredWallpaperReady(); }, Qt::QueuedConnection);
+    }
+    return true;
+}
+
+/*
+    Makes sure the blurred wallpaper of \a screen is available (or is being
+    generated) at the current resolution and device pixel ratio of the screen,
+    with the given \a quality (see "wallpaperQualityKey()").
+    Nothing happens if it's already the case, unless \a force is true, which
+    means the wallpaper itself has changed. Must be called on the GUI thread.
+ */
+static inline void requestScreenWallpaper(const QScreen *screen, const quint32 quality, const bool force)
+{
+    Q_ASSERT(screen);
+    if (!screen || g_micaMaterialData.isDestroyed()) {
+        return;
+    }
+    const WallpaperKey key = {screen, quality};
+    const MicaMaterialQuality tier = effectiveQualityTier(quality);
+    const WallpaperQuality parameters = resolveWallpaperQuality(quality);
+    const ScreenInfo info = currentScreenInfo(screen);
+    const qreal devicePixelRatio = info.devicePixelRatio;
+    const QSize size = screenWallpaperSize(info);
+    int generation = 0;
+    int downscaleFactor = 1;
+    QSize storageSize = {};
+    {
+        const QMutexLocker locker(&g_micaMaterialData()->mutex);
+        if (!force && isScreenWallpaperRequested(*g_micaMaterialData()->wallpaperSnapshot, screen, info, quality)) {
+            return;
+        }
+        QHash<WallpaperKey, ScreenWallpaperData> wallpapers = g_micaMaterialData()->wallpaperSnapshot->wallpapers;
+        pruneUnusedWallpapers(wallpapers, key);
+        // The memory budget is shared by all screens and qualities.
+        qint64 availableBytes = micaMaterialMemoryBudget();
+        for (auto it = wallpapers.constBegin(); it != wallpapers.constEnd(); ++it) {
+            if (it.key() != key) {
+                availableBytes -= (qint64(it->storageSize.width()) * qint64(it->storageSize.height()) * 4);
+            }
+        }
+        downscaleFactor = wallpaperDownscaleFactor(size, availableBytes, parameters.downscaleFactor);
+        storageSize = QSize(((size.width() + downscaleFactor - 1) / downscaleFactor),
+            ((size.height() + downscaleFactor - 1) / downscaleFactor));
+        ScreenWallpaperData &data = wallpapers[key];
+        // A new request always cancels the previous one of the same screen (if it's still running).
+        generation = (g_micaMaterialData()->wallpaperGeneration.fetchAndAddOrdered(1) + 1);
+        data.size = size;
+        data.devicePixelRatio = devicePixelRatio;
+        data.storageSize = storageSize;
+        data.generation = generation;
+        publishWallpaperSnapshot(std::move(wallpapers));
+    }
+    // Everything that needs the GUI thread is collected here, the job itself
+    // only deals with QImage and can run on any thread.
+    const QString wallpaperFilePath = Utils::getWallpaperFilePath();
+    if (wallpaperFilePath.isEmpty()) {
+        WARNING << "Failed to retrieve the wallpaper file path.";
+        g_micaMaterialData()->mutex.lock();
+        QHash<WallpaperKey, ScreenWallpaperData> wallpapers = g_micaMaterialData()->wallpaperSnapshot->wallpapers;
+        const auto it = wallpapers.find(key);
+        if (it != wallpapers.end()) {
+            it->image = {};
+            publishWallpaperSnapshot(std::move(wallpapers));
+        }
+        g_micaMaterialData()->mutex.unlock();
+        notifyBlurredWallpaperReady();
+        return;
+    }
+    const WallpaperAspectStyle aspectStyle = Utils::getWallpaperAspectStyle();
+    const bool cacheEnabled = !FramelessConfig::instance()->isSet(Option::DisableWallpaperCacheForMicaMaterial);
+    const bool exactBlur = FramelessConfig::instance()->isSet(Option::UseExactBlurForMicaMaterial);
+    const bool shareEnabled = FramelessConfig::instance()->isSet(Option::ShareWallpaperBetweenProcessesForMicaMaterial);
+    const bool progressive = FramelessConfig::instance()->isSet(Option::UseProgressiveBlurForMicaMaterial);
+    const BlurBackend blurBackend = micaMaterialBlurBackend();
+    // Keep the blur the same physical size on high DPI screens.
+    const qreal blurRadius = (parameters.blurRadius * devicePixelRatio);
+    const int blurPasses = parameters.blurPasses;
+    const bool autoQuality = (static_cast<MicaMaterialQuality>(quality & 0x3) == MicaMaterialQuality::Auto);
+    // Maps the logical coordinates of the screen to the pixels of the stored wallpaper.
+    const qreal imageDevicePixelRatio = (devicePixelRatio / qreal(downscaleFactor));
+    const QString cacheKey = wallpaperCacheKey(wallpaperFilePath, aspectStyle, size, storageSize, blurRadius, exactBlur, blurBackend, blurPasses);
+    // Switching back to a recent wallpaper doesn't need any background work at all.
+    if (const QImage image = recentWallpaper(cacheKey); !image.isNull()) {
+        DEBUG << "Reusing a recently blurred wallpaper.";
+        publishScreenWallpaper(key, generation, image, imageDevicePixelRatio);
+        return;
+    }
+    const QString slideshowDirPath = Utils::getWallpaperSlideshowDirPath();
+    QThreadPool::globalInstance()->start(new FunctionRunnable([key, tier, autoQuality, generation, size, storageSize,
+        imageDevicePixelRatio, blurRadius, blurPasses, wallpaperFilePath, slideshowDirPath, aspectStyle, cacheKey,
+        cacheEnabled, shareEnabled, progressive, exactBlur, blurBackend](){
+        const auto isCancelled = [key, generation]() -> bool {
+            if (g_micaMaterialData.isDestroyed()) {
+                return true;
+            }
+            const QMutexLocker locker(&g_micaMaterialData()->mutex);
+            const QHash<WallpaperKey, ScreenWallpaperData> &wallpapers = g_micaMaterialData()->wallpaperSnapshot->wallpapers;
+            const auto it = wallpapers.constFind(key);
+            return ((it == wallpapers.constEnd()) || (it->generation != generation));
+        };
+        /*
+            Publishes a very coarse wallpaper right away, then refines it at idle priority:
+            with the exact blur, the fast one comes in between. Every level is painted as
+            soon as it's ready. The refinements say nothing about the speed of the machine,
+            so the automatic quality is left alone.
+         */
+        const auto generateProgressively = [&]() -> QImage {
+            const QImage preview = generatePreviewWallpaper(size, wallpaperFilePath, aspectStyle, blurRadius, blurBackend, blurPasses);
+            if (preview.isNull() || isCancelled()) {
+                return {};
+            }
+            publishScreenWallpaper(key, generation, preview,
+                (imageDevicePixelRatio * qreal(preview.width()) / qreal(storageSize.width())));
+            return runAtIdlePriority([&]() -> QImage {
+                if (exactBlur) {
+                    const QImage fast = generateBlurredWallpaper(size, storageSize, wallpaperFilePath, aspectStyle,
+                        blurRadius, false, blurBackend, blurPasses, 1, isCancelled);
+                    if (fast.isNull()) {
+                        return {};
+                    }
+                    publishScreenWallpaper(key, generation, fast, imageDevicePixelRatio);
+                }
+                return generateBlurredWallpaper(size, storageSize, wallpaperFilePath, aspectStyle,
+                    blurRadius, exactBlur, blurBackend, blurPasses, 1, isCancelled);
+            });
+        };
+        // Whether we blurred the wallpaper ourself, and thus have to save it to the disk cache.
+        bool generated = false;
+        const auto generate = [&]() -> QImage {
+            QImage result = (cacheEnabled ? loadCachedWallpaper(cacheKey, storageSize) : QImage{});
+            if (!result.isNull()) {
+                DEBUG << "Loaded the blurred wallpaper from the disk cache.";
+                return result;
+            }
+            generated = true;
+            if (progressive) {
+                return generateProgressively();
+            }
+            QElapsedTimer timer = {};
+            timer.start();
+            result = generateBlurredWallpaper(size, storageSize, wallpaperFilePath, aspectStyle,
+                blurRadius, exactBlur, blurBackend, blurPasses, wallpaperBlurThreadCount(), isCancelled);
+            if (autoQuality && !result.isNull()) {
+                maybeLowerAutoQuality(tier, timer.elapsed());
+            }
+            return result;
+        };
+        const QImage image = ((shareEnabled && !cacheKey.isEmpty()) ? loadSharedWallpaper(cacheKey, storageSize, generate, isCancelled) : generate());
+        if (image.isNull() || !publishScreenWallpaper(key, generation, image, imageDevicePixelRatio)) {
+            return;
+        }
+        rememberRecentWallpaper(cacheKey, image);
+        if (cacheEnabled && generated) {
+            saveCachedWallpaper(cacheKey, image);
+        }
+        if (!slideshowDirPath.isEmpty()) {
+            prefetchSlideshowWallpaper(slideshowDirPath, wallpaperFilePath, size, storageSize,
+                aspectStyle, blurRadius, exactBlur, blurBackend, blurPasses, isCancelled);
+        }
+    }));
+}
+
+// Runs \a function right away on the GUI thread, or queues it there from any other thread.
+static inline void runOnGuiThread(const std::function<void()> &function)
+{
+    QCoreApplication * const app = QCoreApplication::instance();
+    if (!app) {
+        return;
+    }
+    if (QThread::currentThread() == app->thread()) {
+        function();
+        return;
+    }
+    QMetaObject::invokeMethod(app, function, Qt::QueuedConnection);
+}
+
+/*
+    Same as "requestScreenWallpaper()" without forcing anything, but can be
+    called on any thread: a MicaMaterial used by Qt Quick paints on the render
+    thread. The request is queued to the GUI thread in this case.
+ */
+static inline void requestScreenWallpaperOnGuiThread(const QScreen *screen, const quint32 quality)
+{
+    Q_ASSERT(screen);
+    if (!screen) {
+        return;
+    }
+    runOnGuiThread([screen, quality](){
+        // The screen may be gone by the time the GUI thread gets to it,
+        // so don't touch it before we know it's still there.
+        const QList<QScreen *> screens = QGuiApplication::screens();
+        if (std::find(screens.cbegin(), screens.cend(), screen) != screens.cend()) {
+            requestScreenWallpaper(screen, quality, false);
+        }
+    });
+}
+
+/*
+    Publishes the geometry of all screens, except \a removedScreen which is about
+    to go away, and forgets about the wallpapers of the screens which are gone
+    (this also cancels their pending jobs). GUI thread only.
+ */
+static inline void updateScreenSnapshot(const QScreen *removedScreen = nullptr)
+{
+    if (g_micaMaterialData.isDestroyed()) {
+        return;
+    }
+    QHash<const QScreen *, ScreenInfo> screens = {};
+    const QList<QScreen *> screenList = QGuiApplication::screens();
+    for (auto &&screen : std::as_const(screenList)) {
+        if (screen != removedScreen) {
+            screens.insert(screen, currentScreenInfo(screen));
+        }
+    }
+    {
+        const QMutexLocker locker(&g_micaMaterialData()->mutex);
+        QHash<WallpaperKey, ScreenWallpaperData> wallpapers = g_micaMaterialData()->wallpaperSnapshot->wallpapers;
+        for (auto it = wallpapers.begin(); it != wallpapers.end();) {
+            if (screens.contains(it.key().first)) {
+                ++it;
+            } else {
+                it = wallpapers.erase(it);
+            }
+        }
+        publishWallpaperSnapshot(std::move(wallpapers), std::move(screens));
+    }
+    // Let the painters check whether their wallpapers still match the screens.
+    notifyBlurredWallpaperReady();
+}
+
+// GUI thread only.
+static inline void watchScreen(QScreen *screen)
+{
+    Q_ASSERT(screen);
+    if (!screen) {
+        return;
+    }
+    const auto update = [](){ updateScreenSnapshot(); };
+    QObject::connect(screen, &QScreen::geometryChanged, qGuiApp, update);
+    QObject::connect(screen, &QScreen::logicalDotsPerInchChanged, qGuiApp, update);
+    QObject::connect(screen, &QScreen::physicalDotsPerInchChanged, qGuiApp, update);
+}
+
+// Keeps the screens of the snapshot up to date from now on. GUI thread only.
+static inline void setupScreenSnapshot()
+{
+    if (!qGuiApp) {
+        return;
+    }
+    QObject::connect(qGuiApp, &QGuiApplication::screenAdded, qGuiApp, [](QScreen *screen){
+        watchScreen(screen);
+        updateScreenSnapshot();
+    });
+    QObject::connect(qGuiApp, &QGuiApplication::screenRemoved, qGuiApp, [](QScreen *screen){
+        updateScreenSnapshot(screen);
+    });
+    const QList<QScreen *> screens = QGuiApplication::screens();
+    for (auto &&screen : std::as_const(screens)) {
+        watchScreen(screen);
+    }
+    updateScreenSnapshot();
+}
+
+// Regenerates the blurred wallpaper of every screen hosting a Mica surface. GUI thread only.
+static inline void regenerateBlurredWallpapers()
+{
+    if (g_micaMaterialData.isDestroyed()) {
+        return;
+    }
+    g_micaMaterialData()->wallpaperRegenerationPending = false;
+    g_micaMaterialData()->mutex.lock();
+    const QList<WallpaperKey> keys = g_micaMaterialData()->wallpaperSnapshot->wallpapers.keys();
+    g_micaMaterialData()->mutex.unlock();
+    for (auto &&key : std::as_const(keys)) {
+        requestScreenWallpaper(key.first, key.second, true);
+    }
+}
+
+/*
+    The wallpaper is the same for all Mica surfaces, so it's only blurred once
+    per change, no matter how many instances exist or how many of them ask for
+    it: the requests made before the event loop gets back to us are merged.
+    GUI thread only.
+ */
+static inline void scheduleWallpaperRegeneration()
 {
-    alignment = visualAlignment(direction, alignment);
-    int x = rectangle.x();
-    int y = rectangle.y();
-    int w = size.width();
-    int h = size.height();
-    if ((alignment & Qt::AlignVCenter) == Qt::AlignVCenter) {
-        y += ((rectangle.size().height() / 2) - (h / 2));
-    } else if ((alignment & Qt::AlignBottom) == Qt::AlignBottom) {
-        y += (rectangle.size().height() - h);
+    if (g_micaMaterialData.isDestroyed()) {
+        return;
     }
-    if ((alignment & Qt::AlignRight) == Qt::AlignRight) {
-        x += (rectangle.size().width() - w);
-    } else if ((alignment & Qt::AlignHCenter) == Qt::AlignHCenter) {
-        x += ((rectangle.size().width() / 2) - (w / 2));
+    if (g_micaMaterialData()->wallpaperRegenerationPending) {
+        return;
     }
-    return {x, y, w, h};
+    QCoreApplication * const app = QCoreApplication::instance();
+    if (!app) {
+        return;
+    }
+    g_micaMaterialData()->wallpaperRegenerationPending = true;
+    QMetaObject::invokeMethod(app, [](){ regenerateBlurredWallpapers(); }, Qt::QueuedConnection);
+}
+
+static inline void setupWallpaperGenerator()
+{
+    {
+        const QMutexLocker locker(&g_micaMaterialData()->mutex);
+        if (g_micaMaterialData()->wallpaperGeneratorReady) {
+            return;
+        }
+        g_micaMaterialData()->wallpaperGeneratorReady = true;
+    }
+    FramelessManager * const manager = FramelessManager::instance();
+    QObject::connect(manager, &FramelessManager::wallpaperChanged, manager, [](){
+        scheduleWallpaperRegeneration();
+    });
 }
 
 MicaMaterialPrivate::MicaMaterialPrivate(MicaMaterial *q) : QObject(q)
@@ -491,7 +3404,14 @@ MicaMaterialPrivate::MicaMaterialPrivate(MicaMaterial *q) : QObject(q)
     initialize();
 }
 
-MicaMaterialPrivate::~MicaMaterialPrivate() = default;
+MicaMaterialPrivate::~MicaMaterialPrivate()
+{
+    if (g_micaMaterialData.isDestroyed()) {
+        return;
+    }
+    const QMutexLocker locker(&g_micaMaterialData()->mutex);
+    g_micaMaterialData()->instances.removeAll(this);
+}
 
 MicaMaterialPrivate *MicaMaterialPrivate::get(MicaMaterial *q)
 {
@@ -511,104 +3431,130 @@ const MicaMaterialPrivate *MicaMaterialPrivate::get(const MicaMaterial *q)
     return q->d_func();
 }
 
-void MicaMaterialPrivate::maybeGenerateBlurredWallpaper(const bool force)
+QImage MicaMaterialPrivate::placeWallpaper(const QImage &image, const QSize &size, const WallpaperAspectStyle aspectStyle)
 {
-    g_micaMaterialData()->mutex.lock();
-    if (!g_micaMaterialData()->blurredWallpaper.isNull() && !force) {
-        g_micaMaterialData()->mutex.unlock();
-        return;
+    return placeWallpaperImage(image, size, aspectStyle);
+}
+
+QImage MicaMaterialPrivate::blurWallpaper(const QImage &image, const qreal radius, const bool exact, const BlurBackend backend)
+{
+    return blurWallpaperImage(image, radius, exact, backend, kDefaultBlurPasses, wallpaperBlurThreadCount());
+}
+
+void MicaMaterialPrivate::expBlur(QImage &image, const qreal radius, const bool improvedQuality)
+{
+#ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
+    Q_UNUSED(image);
+    Q_UNUSED(radius);
+    Q_UNUSED(improvedQuality);
+#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
+    expblur<12, 10, false>(image, radius, improvedQuality, 0, qt_blurThreadCount());
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+}
+
+void MicaMaterialPrivate::setScalarBlurForced(const bool value)
+{
+#ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
+    Q_UNUSED(value);
+#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
+    g_scalarBlurForced.storeRelease(value ? 1 : 0);
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+}
+
+QImage MicaMaterialPrivate::halfScaled(const QImage &image)
+{
+#ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
+    return image.scaled(image.size() / 2, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
+    return qt_halfScaled(image, qt_blurThreadCount());
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+}
+
+void MicaMaterialPrivate::blurImage(QPainter *painter, QImage &image, const qreal radius, const bool improvedQuality)
+{
+#ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
+    Q_UNUSED(painter);
+    Q_UNUSED(image);
+    Q_UNUSED(radius);
+    Q_UNUSED(improvedQuality);
+#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
+    qt_blurImage(painter, image, radius, improvedQuality, false, qt_blurThreadCount());
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+}
+
+void MicaMaterialPrivate::alphaBlur(QImage &image, const qreal radius, const bool improvedQuality)
+{
+#ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
+    Q_UNUSED(image);
+    Q_UNUSED(radius);
+    Q_UNUSED(improvedQuality);
+#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
+    if ((image.format() != QImage::Format_ARGB32_Premultiplied)
+        && (image.format() != QImage::Format_RGB32)) {
+        image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
     }
-    g_micaMaterialData()->mutex.unlock();
-    const QSize size = QGuiApplication::primaryScreen()->virtualSize();
-    g_micaMaterialData()->mutex.lock();
-    g_micaMaterialData()->blurredWallpaper = QPixmap(size);
-    g_micaMaterialData()->blurredWallpaper.fill(kDefaultTransparentColor);
-    g_micaMaterialData()->mutex.unlock();
-    const QString wallpaperFilePath = Utils::getWallpaperFilePath();
-    if (wallpaperFilePath.isEmpty()) {
-        WARNING << "Failed to retrieve the wallpaper file path.";
+    expblur<12, 10, true>(image, radius, improvedQuality, 0, qt_blurThreadCount());
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+}
+
+void MicaMaterialPrivate::maybeGenerateBlurredWallpaper(const bool force)
+{
+    if (force) {
+        scheduleWallpaperRegeneration();
         return;
     }
-    QImage image(wallpaperFilePath);
-    if (image.isNull()) {
-        WARNING << "QImage doesn't support this kind of file:" << wallpaperFilePath;
+    updateWallpaperSnapshot(wallpaperSnapshot);
+    if (!wallpaperSnapshot) {
         return;
     }
-    WallpaperAspectStyle aspectStyle = Utils::getWallpaperAspectStyle();
-    QImage buffer(size, QImage::Format_ARGB32_Premultiplied);
-#ifdef Q_OS_WINDOWS
-    if (aspectStyle == WallpaperAspectStyle::Center) {
-        buffer.fill(kDefaultBlackColor);
-    }
-#endif
-    if ((aspectStyle == WallpaperAspectStyle::Stretch)
-        || (aspectStyle == WallpaperAspectStyle::Fit)
-        || (aspectStyle == WallpaperAspectStyle::Fill)) {
-        Qt::AspectRatioMode mode = Qt::KeepAspectRatioByExpanding;
-        if (aspectStyle == WallpaperAspectStyle::Stretch) {
-            mode = Qt::IgnoreAspectRatio;
-        } else if (aspectStyle == WallpaperAspectStyle::Fit) {
-            mode = Qt::KeepAspectRatio;
+    const quint32 quality = wallpaperQuality();
+    const QList<WallpaperKey> keys = wallpaperSnapshot->wallpapers.keys();
+    for (auto &&key : std::as_const(keys)) {
+        if (key.second == quality) {
+            requestScreenWallpaperOnGuiThread(key.first, quality);
         }
-        QSize newSize = image.size();
-        newSize.scale(size, mode);
-        image = image.scaled(newSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-    }
-    static constexpr const QPoint desktopOriginPoint = {0, 0};
-    const QRect desktopRect = {desktopOriginPoint, size};
-    if (aspectStyle == WallpaperAspectStyle::Tile) {
-        QPainter bufferPainter(&buffer);
-        bufferPainter.setRenderHints(QPainter::Antialiasing |
-            QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
-        bufferPainter.fillRect(desktopRect, QBrush(image));
-    } else {
-        QPainter bufferPainter(&buffer);
-        bufferPainter.setRenderHints(QPainter::Antialiasing |
-            QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
-        const QRect rect = alignedRect(Qt::LeftToRight, Qt::AlignCenter, image.size(), desktopRect);
-        bufferPainter.drawImage(rect.topLeft(), image);
     }
-    g_micaMaterialData()->mutex.lock();
-    QPainter painter(&g_micaMaterialData()->blurredWallpaper);
-    painter.setRenderHints(QPainter::Antialiasing |
-        QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
-#ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
-    painter.drawImage(desktopOriginPoint, buffer);
-#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
-    qt_blurImage(&painter, buffer, kDefaultBlurRadius, true, false);
-#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
-    g_micaMaterialData()->mutex.unlock();
-    Q_Q(MicaMaterial);
-    Q_EMIT q->shouldRedraw();
 }
 
 void MicaMaterialPrivate::updateMaterialBrush()
 {
-#ifndef FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
-    initResource();
-    static const QImage noiseTexture = QImage(kNoiseImageFilePath);
-#endif // FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
-    QImage micaTexture = QImage(QSize(64, 64), QImage::Format_ARGB32_Premultiplied);
-    QColor fillColor = (Utils::shouldAppsUseDarkMode() ? kDefaultSystemDarkColor : kDefaultSystemLightColor2);
-    fillColor.setAlphaF(0.9f);
-    micaTexture.fill(fillColor);
-    QPainter painter(&micaTexture);
-    painter.setRenderHints(QPainter::Antialiasing |
-        QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
-    painter.setOpacity(tintOpacity);
-    const QRect rect = {QPoint(0, 0), micaTexture.size()};
-    painter.fillRect(rect, tintColor);
-    painter.setOpacity(noiseOpacity);
-#ifndef FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
-    painter.fillRect(rect, QBrush(noiseTexture));
-#endif // FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
-    micaBrush = QBrush(micaTexture);
-    if (initialized) {
+    const bool changed = refreshMaterialBrush();
+    if (changed && initialized) {
         Q_Q(MicaMaterial);
         Q_EMIT q->shouldRedraw();
     }
 }
 
+void MicaMaterialPrivate::scheduleMaterialBrushUpdate()
+{
+    // Several properties are usually changed in a row, rebuild the brush
+    // (and repaint) only once after all of them have been applied.
+    if (materialBrushUpdatePending) {
+        return;
+    }
+    materialBrushUpdatePending = true;
+    QMetaObject::invokeMethod(this, &MicaMaterialPrivate::updateMaterialBrush, Qt::QueuedConnection);
+}
+
+bool MicaMaterialPrivate::refreshMaterialBrush()
+{
+    materialBrushUpdatePending = false;
+    const bool dark = Utils::shouldAppsUseDarkMode();
+    const qreal noise = (noiseEnabled ? noiseOpacity : 0.0);
+    const quint64 key = micaBrushKey(dark, tintColor, tintOpacity, noise);
+    if (micaBrushReady && (key == micaBrushCacheKey)) {
+        return false;
+    }
+    micaBrush = cachedMicaBrush(key);
+    micaBrushCacheKey = key;
+    micaBrushReady = true;
+    fallbackColor = (dark ? kDefaultSystemDarkColor : kDefaultSystemLightColor2);
+    // Most likely the user will switch the theme sooner or later, have the
+    // other variant ready by then so that it's just a lookup for every window.
+    cachedMicaBrush(micaBrushKey(!dark, tintColor, tintOpacity, noise));
+    return true;
+}
+
 void MicaMaterialPrivate::paint(QPainter *painter, const QSize &size, const QPoint &pos)
 {
     Q_ASSERT(painter);
@@ -616,36 +3562,150 @@ void MicaMaterialPrivate::paint(QPainter *painter, const QSize &size, const QPoi
         return;
     }
     prepareGraphicsResources();
+    if (materialBrushUpdatePending) {
+        // We are about to paint anyway, no need to wait for the queued update.
+        refreshMaterialBrush();
+    }
+    updateWallpaperSnapshot(wallpaperSnapshot);
+    if (!wallpaperSnapshot) {
+        return;
+    }
     static constexpr const QPoint originPoint = {0, 0};
     painter->save();
     painter->setRenderHints(QPainter::Antialiasing |
         QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
-    g_micaMaterialData()->mutex.lock();
-    painter->drawPixmap(originPoint, g_micaMaterialData()->blurredWallpaper, QRect(pos, size));
-    g_micaMaterialData()->mutex.unlock();
+    // The surface may span several screens, each of them has its own wallpaper
+    // at its own resolution, so paint the part on each screen separately.
+    // Only the snapshot is used here, this may be called on the render thread.
+    const QRect globalRect = {pos, size};
+    const quint32 quality = wallpaperQuality();
+    if (wallpaperSnapshot->screens.isEmpty()) {
+        // The GUI thread hasn't told us about the screens yet.
+        painter->fillRect(QRect(originPoint, size), fallbackColor);
+    }
+    for (auto it = wallpaperSnapshot->screens.constBegin(); it != wallpaperSnapshot->screens.constEnd(); ++it) {
+        const QScreen * const screen = it.key();
+        const QRect screenGeometry = it->geometry;
+        const QRect intersectedRect = globalRect.intersected(screenGeometry);
+        if (intersectedRect.isEmpty()) {
+            continue;
+        }
+        if (!isScreenWallpaperRequested(*wallpaperSnapshot, screen, it.value(), quality)) {
+            requestScreenWallpaperOnGuiThread(screen, quality);
+        }
+        const ScreenWallpaperData data = wallpaperSnapshot->wallpapers.value({screen, quality}); // Shallow copy.
+        const QRect targetRect = intersectedRect.translated(-pos);
+        if (data.image.isNull()) {
+            // The blurred wallpaper is still being generated in the background.
+            painter->fillRect(targetRect, fallbackColor);
+            continue;
+        }
+        const qreal dpr = data.imageDevicePixelRatio;
+        const QRectF sourceRect = {QPointF(intersectedRect.topLeft() - screenGeometry.topLeft()) * dpr,
+            QSizeF(intersectedRect.size()) * dpr};
+        painter->drawImage(QRectF(targetRect), data.image, sourceRect);
+    }
     painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
     painter->setOpacity(1.0);
     painter->fillRect(QRect(originPoint, size), micaBrush);
     painter->restore();
 }
 
+quint32 MicaMaterialPrivate::wallpaperQuality() const
+{
+    return quint32(packedWallpaperQuality.loadAcquire());
+}
+
+QImage MicaMaterialPrivate::screenWallpaper(const QScreen *screen, QRect *screenGeometry, qreal *imageDevicePixelRatio)
+{
+    Q_ASSERT(screen);
+    if (!screen) {
+        return {};
+    }
+    prepareGraphicsResources();
+    updateWallpaperSnapshot(wallpaperSnapshot);
+    if (!wallpaperSnapshot) {
+        return {};
+    }
+    const auto it = wallpaperSnapshot->screens.constFind(screen);
+    if (it == wallpaperSnapshot->screens.constEnd()) {
+        // The GUI thread hasn't told us about this screen yet.
+        return {};
+    }
+    const quint32 quality = wallpaperQuality();
+    if (!isScreenWallpaperRequested(*wallpaperSnapshot, screen, it.value(), quality)) {
+        requestScreenWallpaperOnGuiThread(screen, quality);
+    }
+    const ScreenWallpaperData data = wallpaperSnapshot->wallpapers.value({screen, quality}); // Shallow copy.
+    if (screenGeometry) {
+        *screenGeometry = it->geometry;
+    }
+    if (imageDevicePixelRatio) {
+        *imageDevicePixelRatio = data.imageDevicePixelRatio;
+    }
+    return data.image;
+}
+
+QImage MicaMaterialPrivate::materialTexture()
+{
+    if (materialBrushUpdatePending || !micaBrushReady) {
+        refreshMaterialBrush();
+    }
+    return micaBrush.textureImage();
+}
+
+QColor MicaMaterialPrivate::backgroundColor() const
+{
+    return fallbackColor;
+}
+
+void MicaMaterialPrivate::updateWallpaperQuality()
+{
+    const auto key = int(wallpaperQualityKey(quality, blurRadius, downsampleFactor, blurPasses));
+    if (packedWallpaperQuality.fetchAndStoreOrdered(key) == key) {
+        return;
+    }
+    // The wallpaper of the new quality is requested on the next repaint, it may
+    // be shared with other instances and thus ready already.
+    if (initialized) {
+        emitShouldRedraw();
+    }
+}
+
+void MicaMaterialPrivate::emitShouldRedraw()
+{
+    Q_Q(MicaMaterial);
+    Q_EMIT q->shouldRedraw();
+}
+
 void MicaMaterialPrivate::initialize()
 {
+    g_micaMaterialData()->mutex.lock();
+    g_micaMaterialData()->instances.append(this);
+    g_micaMaterialData()->mutex.unlock();
+
     tintColor = kDefaultTransparentColor;
     tintOpacity = kDefaultTintOpacity;
     noiseOpacity = kDefaultNoiseOpacity;
 
+    updateWallpaperQuality();
     updateMaterialBrush();
 
     connect(FramelessManager::instance(), &FramelessManager::systemThemeChanged,
         this, &MicaMaterialPrivate::updateMaterialBrush);
-    connect(FramelessManager::instance(), &FramelessManager::wallpaperChanged,
-        this, [this](){
-            maybeGenerateBlurredWallpaper(true);
-        });
+    // The blurred wallpapers are shared, we only need to know when one of them is ready.
+    setupWallpaperGenerator();
 
     if (FramelessConfig::instance()->isSet(Option::DisableLazyInitializationForMicaMaterial)) {
         prepareGraphicsResources();
+        // We don't know where the window will be shown yet, the primary
+        // screen is the most likely place.
+        const quint32 quality = wallpaperQuality();
+        runOnGuiThread([quality](){
+            if (QScreen * const screen = QGuiApplication::primaryScreen()) {
+                requestScreenWallpaper(screen, quality, false);
+            }
+        });
     }
 
     initialized = true;
@@ -653,14 +3713,14 @@ void MicaMaterialPrivate::initialize()
 
 void MicaMaterialPrivate::prepareGraphicsResources()
 {
-    g_micaMaterialData()->mutex.lock();
-    if (g_micaMaterialData()->graphicsResourcesReady) {
-        g_micaMaterialData()->mutex.unlock();
+    if (g_micaMaterialData()->graphicsResourcesReady.loadAcquire()
+        || !g_micaMaterialData()->graphicsResourcesReady.testAndSetOrdered(0, 1)) {
         return;
     }
-    g_micaMaterialData()->graphicsResourcesReady = true;
-    g_micaMaterialData()->mutex.unlock();
-    maybeGenerateBlurredWallpaper();
+    // The wallpapers themselves are generated on demand, when something is
+    // painted on a screen for the first time. The painters only need to know
+    // where the screens are, and they may not be on the GUI thread.
+    runOnGuiThread([](){ setupScreenSnapshot(); });
 }
 
 MicaMaterial::MicaMaterial(QObject *parent)
@@ -688,7 +3748,7 @@ void MicaMaterial::setTintColor(const QColor &value)
     }
     d->prepareGraphicsResources();
     d->tintColor = value;
-    d->updateMaterialBrush();
+    d->scheduleMaterialBrushUpdate();
     Q_EMIT tintColorChanged();
 }
 
@@ -706,7 +3766,7 @@ void MicaMaterial::setTintOpacity(const qreal value)
     }
     d->prepareGraphicsResources();
     d->tintOpacity = value;
-    d->updateMaterialBrush();
+    d->scheduleMaterialBrushUpdate();
     Q_EMIT tintOpacityChanged();
 }
 
@@ -724,10 +3784,145 @@ void MicaMaterial::setNoiseOpacity(const qreal value)
     }
     d->prepareGraphicsResources();
     d->noiseOpacity = value;
-    d->updateMaterialBrush();
+    d->scheduleMaterialBrushUpdate();
     Q_EMIT noiseOpacityChanged();
 }
 
+bool MicaMaterial::isNoiseEnabled() const
+{
+    Q_D(const MicaMaterial);
+    return d->noiseEnabled;
+}
+
+void MicaMaterial::setNoiseEnabled(const bool value)
+{
+    Q_D(MicaMaterial);
+    if (d->noiseEnabled == value) {
+        return;
+    }
+    d->prepareGraphicsResources();
+    d->noiseEnabled = value;
+    d->scheduleMaterialBrushUpdate();
+    Q_EMIT noiseEnabledChanged();
+}
+
+MicaMaterialQuality MicaMaterial::quality() const
+{
+    Q_D(const MicaMaterial);
+    return d->quality;
+}
+
+void MicaMaterial::setQuality(const MicaMaterialQuality value)
+{
+    Q_D(MicaMaterial);
+    if (d->quality == value) {
+        return;
+    }
+    d->quality = value;
+    d->updateWallpaperQuality();
+    Q_EMIT qualityChanged();
+}
+
+qreal MicaMaterial::blurRadius() const
+{
+    Q_D(const MicaMaterial);
+    // Exactly as set, only the wallpaper quality key rounds it.
+    return d->blurRadius.value_or(resolveWallpaperQuality(d->wallpaperQuality()).blurRadius);
+}
+
+void MicaMaterial::setBlurRadius(const qreal value)
+{
+    Q_ASSERT(value >= kMinimumMicaMaterialBlurRadius);
+    Q_ASSERT(value <= kMaximumMicaMaterialBlurRadius);
+    if ((value < kMinimumMicaMaterialBlurRadius) || (value > kMaximumMicaMaterialBlurRadius)) {
+        return;
+    }
+    Q_D(MicaMaterial);
+    if (d->blurRadius.has_value() && qFuzzyCompare(d->blurRadius.value(), value)) {
+        return;
+    }
+    d->blurRadius = value;
+    d->updateWallpaperQuality();
+    Q_EMIT blurRadiusChanged();
+}
+
+void MicaMaterial::resetBlurRadius()
+{
+    Q_D(MicaMaterial);
+    if (!d->blurRadius.has_value()) {
+        return;
+    }
+    d->blurRadius = std::nullopt;
+    d->updateWallpaperQuality();
+    Q_EMIT blurRadiusChanged();
+}
+
+int MicaMaterial::downsampleFactor() const
+{
+    Q_D(const MicaMaterial);
+    return resolveWallpaperQuality(d->wallpaperQuality()).downscaleFactor;
+}
+
+void MicaMaterial::setDownsampleFactor(const int value)
+{
+    Q_ASSERT(value >= kMinimumMicaMaterialDownsampleFactor);
+    Q_ASSERT(value <= kMaximumMicaMaterialDownsampleFactor);
+    if ((value < kMinimumMicaMaterialDownsampleFactor) || (value > kMaximumMicaMaterialDownsampleFactor)) {
+        return;
+    }
+    Q_D(MicaMaterial);
+    if (d->downsampleFactor == value) {
+        return;
+    }
+    d->downsampleFactor = value;
+    d->updateWallpaperQuality();
+    Q_EMIT downsampleFactorChanged();
+}
+
+void MicaMaterial::resetDownsampleFactor()
+{
+    Q_D(MicaMaterial);
+    if (!d->downsampleFactor.has_value()) {
+        return;
+    }
+    d->downsampleFactor = std::nullopt;
+    d->updateWallpaperQuality();
+    Q_EMIT downsampleFactorChanged();
+}
+
+int MicaMaterial::blurPasses() const
+{
+    Q_D(const MicaMaterial);
+    return resolveWallpaperQuality(d->wallpaperQuality()).blurPasses;
+}
+
+void MicaMaterial::setBlurPasses(const int value)
+{
+    Q_ASSERT(value >= kMinimumMicaMaterialBlurPasses);
+    Q_ASSERT(value <= kMaximumMicaMaterialBlurPasses);
+    if ((value < kMinimumMicaMaterialBlurPasses) || (value > kMaximumMicaMaterialBlurPasses)) {
+        return;
+    }
+    Q_D(MicaMaterial);
+    if (d->blurPasses == value) {
+        return;
+    }
+    d->blurPasses = value;
+    d->updateWallpaperQuality();
+    Q_EMIT blurPassesChanged();
+}
+
+void MicaMaterial::resetBlurPasses()
+{
+    Q_D(MicaMaterial);
+    if (!d->blurPasses.has_value()) {
+        return;
+    }
+    d->blurPasses = std::nullopt;
+    d->updateWallpaperQuality();
+    Q_EMIT blurPassesChanged();
+}
+
 void MicaMaterial::paint(QPainter *painter, const QSize &size, const QPoint &pos)
 {
     Q_D(MicaMaterial);
@@ -75,6 +75,24 @@ static const QHash<int, FONT_ICON> g_fontIconsTable = {
 };
 #endif // FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
 
+// Frameless windows on Linux may paint their own shadow around their visible part,
+// only a resize border wide band of it takes mouse input, see WindowShadowPainter.
+[[maybe_unused]] [[nodiscard]] static inline QRect windowMouseArea(const QWindow *window)
+{
+    Q_ASSERT(window);
+    if (!window) {
+        return {};
+    }
+    const QRect windowRect = QRect(QPoint(0, 0), window->size());
+    const auto shadowMargins = qvariant_cast<QMargins>(window->property(kWindowShadowMarginsVar.constData()));
+    if (shadowMargins.isNull()) {
+        return windowRect;
+    }
+    const QMargins resizeMargins = {kDefaultResizeBorderThickness, kDefaultResizeBorderThickness,
+                                    kDefaultResizeBorderThickness, kDefaultResizeBorderThickness};
+    return windowRect.marginsRemoved(shadowMargins).marginsAdded(resizeMargins).intersected(windowRect);
+}
+
 Qt::CursorShape Utils::calculateCursorShape(const QWindow *window, const QPoint &pos)
 {
 #ifdef Q_OS_MACOS
@@ -89,10 +107,14 @@ Qt::CursorShape Utils::calculateCursorShape(const QWindow *window, const QPoint
     if (window->visibility() != QWindow::Windowed) {
         return Qt::ArrowCursor;
     }
-    const int x = pos.x();
-    const int y = pos.y();
-    const int w = window->width();
-    const int h = window->height();
+    const QRect area = windowMouseArea(window);
+    if (!area.contains(pos)) {
+        return Qt::ArrowCursor;
+    }
+    const int x = (pos.x() - area.x());
+    const int y = (pos.y() - area.y());
+    const int w = area.width();
+    const int h = area.height();
     if (((x < kDefaultResizeBorderThickness) && (y < kDefaultResizeBorderThickness))
         || ((x >= (w - kDefaultResizeBorderThickness)) && (y >= (h - kDefaultResizeBorderThickness)))) {
         return Qt::SizeFDiagCursor;
@@ -125,19 +147,23 @@ Qt::Edges Utils::calculateWindowEdges(const QWindow *window, const QPoint &pos)
     if (window->visibility() != QWindow::Windowed) {
         return {};
     }
+    const QRect area = windowMouseArea(window);
+    if (!area.contains(pos)) {
+        return {};
+    }
     Qt::Edges edges = {};
-    const int x = pos.x();
-    const int y = pos.y();
+    const int x = (pos.x() - area.x());
+    const int y = (pos.y() - area.y());
     if (x < kDefaultResizeBorderThickness) {
         edges |= Qt::LeftEdge;
     }
-    if (x >= (window->width() - kDefaultResizeBorderThickness)) {
+    if (x >= (area.width() - kDefaultResizeBorderThickness)) {
         edges |= Qt::RightEdge;
     }
     if (y < kDefaultResizeBorderThickness) {
         edges |= Qt::TopEdge;
     }
-    if (y >= (window->height() - kDefaultResizeBorderThickness)) {
+    if (y >= (area.height() - kDefaultResizeBorderThickness)) {
         edges |= Qt::BottomEdge;
     }
     return edges;
@@ -26,6 +26,18 @@
 #include "framelessconfig_p.h"
 #include "framelessmanager.h"
 #include "framelessmanager_p.h"
+#include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qdatetime.h>
+#include <QtCore/qtimer.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qtextstream.h>
+#include <QtCore/qxmlstream.h>
+#include <QtCore/qstandardpaths.h>
+#include <QtCore/qfilesystemwatcher.h>
+#include <QtCore/qurl.h>
+#include <QtCore/qset.h>
 #include <QtGui/qwindow.h>
 #include <QtGui/qscreen.h>
 #include <QtGui/qguiapplication.h>
@@ -41,6 +53,7 @@
 #endif // FRAMELESSHELPER_CORE_NO_PRIVATE
 #include <gtk/gtk.h>
 #include <xcb/xcb.h>
+#include <xcb/shape.h>
 
 FRAMELESSHELPER_BEGIN_NAMESPACE
 
@@ -74,6 +87,11 @@ using Display = struct _XDisplay;
 
 [[maybe_unused]] static constexpr const char _NET_WM_MOVERESIZE_ATOM_NAME[] = "_NET_WM_MOVERESIZE\0";
 
+[[maybe_unused]] static constexpr const char _GTK_FRAME_EXTENTS_ATOM_NAME[] = "_GTK_FRAME_EXTENTS\0";
+
+// Owned by the compositing manager of the screen, see the EWMH specification.
+[[maybe_unused]] static constexpr const char _NET_WM_CM_S_ATOM_NAME_PREFIX[] = "_NET_WM_CM_S";
+
 [[maybe_unused]] static constexpr const auto _NET_WM_SENDEVENT_MASK =
     (XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY);
 
@@ -81,8 +99,43 @@ using Display = struct _XDisplay;
 [[maybe_unused]] static constexpr const char GTK_THEME_NAME_PROP[] = "gtk-theme-name";
 [[maybe_unused]] static constexpr const char GTK_THEME_PREFER_DARK_PROP[] = "gtk-application-prefer-dark-theme";
 
+[[maybe_unused]] static constexpr const char GNOME_BACKGROUND_SCHEMA[] = "org.gnome.desktop.background";
+[[maybe_unused]] static constexpr const char GNOME_PICTURE_URI_KEY[] = "picture-uri";
+[[maybe_unused]] static constexpr const char GNOME_PICTURE_URI_DARK_KEY[] = "picture-uri-dark";
+[[maybe_unused]] static constexpr const char GNOME_PICTURE_OPTIONS_KEY[] = "picture-options";
+
+[[maybe_unused]] static constexpr const char XDG_CURRENT_DESKTOP_ENV_VAR[] = "XDG_CURRENT_DESKTOP";
+
+// Desktop environments usually write their configuration files several times
+// in a row when something changes, only look at them once they are done.
+[[maybe_unused]] static constexpr const int kWallpaperChangeNotificationDelay = 250; // ms
+
 FRAMELESSHELPER_STRING_CONSTANT(dark)
 
+FRAMELESSHELPER_STRING_CONSTANT2(GnomeNone, "none")
+FRAMELESSHELPER_STRING_CONSTANT2(GnomeWallpaper, "wallpaper")
+FRAMELESSHELPER_STRING_CONSTANT2(GnomeCentered, "centered")
+FRAMELESSHELPER_STRING_CONSTANT2(GnomeScaled, "scaled")
+FRAMELESSHELPER_STRING_CONSTANT2(GnomeStretched, "stretched")
+FRAMELESSHELPER_STRING_CONSTANT2(GnomeSpanned, "spanned")
+FRAMELESSHELPER_STRING_CONSTANT2(GnomeDconfFilePath, "dconf/user")
+FRAMELESSHELPER_STRING_CONSTANT2(GnomeKeyfileFilePath, "glib-2.0/settings/keyfile")
+FRAMELESSHELPER_STRING_CONSTANT2(KdeAppletsFilePath, "plasma-org.kde.plasma.desktop-appletsrc")
+FRAMELESSHELPER_STRING_CONSTANT2(KdeImageGroupSuffix, "[Wallpaper][org.kde.image][General]")
+FRAMELESSHELPER_STRING_CONSTANT2(KdeSlideshowGroupSuffix, "[Wallpaper][org.kde.slideshow][General]")
+FRAMELESSHELPER_STRING_CONSTANT2(KdeImageKey, "Image")
+FRAMELESSHELPER_STRING_CONSTANT2(KdeSlidePathsKey, "SlidePaths")
+FRAMELESSHELPER_STRING_CONSTANT2(KdeFillModeKey, "FillMode")
+FRAMELESSHELPER_STRING_CONSTANT2(KdePackageImagesDirPath, "contents/images")
+FRAMELESSHELPER_STRING_CONSTANT2(XfceDesktopFilePath, "xfce4/xfconf/xfce-perchannel-xml/xfce4-desktop.xml")
+FRAMELESSHELPER_STRING_CONSTANT2(XfceProperty, "property")
+FRAMELESSHELPER_STRING_CONSTANT2(XfceName, "name")
+FRAMELESSHELPER_STRING_CONSTANT2(XfceValue, "value")
+FRAMELESSHELPER_STRING_CONSTANT2(XfceLastImage, "last-image")
+FRAMELESSHELPER_STRING_CONSTANT2(XfceImageStyle, "image-style")
+FRAMELESSHELPER_STRING_CONSTANT2(XfceCycleEnable, "backdrop-cycle-enable")
+FRAMELESSHELPER_STRING_CONSTANT2(XfceTrue, "true")
+
 FRAMELESSHELPER_BYTEARRAY_CONSTANT(rootwindow)
 FRAMELESSHELPER_BYTEARRAY_CONSTANT(x11screen)
 FRAMELESSHELPER_BYTEARRAY_CONSTANT(apptime)
@@ -121,6 +174,396 @@ template<typename T>
     return result;
 }
 
+struct LinuxWallpaper
+{
+    QString filePath = {};
+    WallpaperAspectStyle aspectStyle = WallpaperAspectStyle::Fill;
+    // Only if the desktop cycles through the images of this directory.
+    QString slideshowDirPath = {};
+};
+
+/*
+    Each desktop environment stores the wallpaper in its own way. A provider
+    knows how to read it for one of them, and which files have to be watched
+    to know when it changes. Supporting another desktop environment is just
+    a matter of adding an entry to "kWallpaperProviders".
+ */
+struct WallpaperProvider
+{
+    const char *name = nullptr;
+    // The names of the desktop environment in "XDG_CURRENT_DESKTOP".
+    QStringList (*desktopNames)() = nullptr;
+    QStringList (*configFilePaths)() = nullptr;
+    LinuxWallpaper (*wallpaper)() = nullptr;
+};
+
+[[nodiscard]] static inline QString configFilePath(const QString &relativePath)
+{
+    return (QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation) + QLatin1Char('/') + relativePath);
+}
+
+// The wallpaper settings store URLs most of the time, but plain paths are fine too.
+[[nodiscard]] static inline QString toLocalFilePath(const QString &value)
+{
+    if (value.isEmpty()) {
+        return {};
+    }
+    const QUrl url(value);
+    if (url.isLocalFile()) {
+        return url.toLocalFile();
+    }
+    return value;
+}
+
+struct GnomeBackgroundSettings
+{
+    GSettings *settings = nullptr;
+    // "picture-uri-dark" only exists since GNOME 42.
+    bool hasDarkPicture = false;
+};
+
+[[nodiscard]] static inline const GnomeBackgroundSettings &gnomeBackgroundSettings()
+{
+    static const auto result = []() -> GnomeBackgroundSettings {
+        GSettingsSchemaSource * const source = g_settings_schema_source_get_default();
+        if (!source) {
+            return {};
+        }
+        // g_settings_new() aborts the process if the schema doesn't exist, check it first.
+        GSettingsSchema * const schema = g_settings_schema_source_lookup(source, GNOME_BACKGROUND_SCHEMA, TRUE);
+        if (!schema) {
+            WARNING << "The GSettings schema" << GNOME_BACKGROUND_SCHEMA << "is not installed.";
+            return {};
+        }
+        GnomeBackgroundSettings settings = {};
+        settings.hasDarkPicture = g_settings_schema_has_key(schema, GNOME_PICTURE_URI_DARK_KEY);
+        settings.settings = g_settings_new_full(schema, nullptr, nullptr);
+        g_settings_schema_unref(schema);
+        return settings;
+    }();
+    return result;
+}
+
+[[nodiscard]] static inline QString gnomeBackgroundSetting(const gchar *key)
+{
+    Q_ASSERT(key);
+    GSettings * const settings = gnomeBackgroundSettings().settings;
+    if (!key || !settings) {
+        return {};
+    }
+    const auto value = g_settings_get_string(settings, key);
+    const QString result = QUtf8String(value);
+    g_free(value);
+    return result;
+}
+
+[[nodiscard]] static inline LinuxWallpaper gnomeWallpaper()
+{
+    const bool dark = (gnomeBackgroundSettings().hasDarkPicture && Utils::shouldAppsUseDarkMode_linux());
+    const QString options = gnomeBackgroundSetting(GNOME_PICTURE_OPTIONS_KEY);
+    if (options == kGnomeNone) {
+        return {};
+    }
+    LinuxWallpaper result = {};
+    result.filePath = toLocalFilePath(gnomeBackgroundSetting(dark ? GNOME_PICTURE_URI_DARK_KEY : GNOME_PICTURE_URI_KEY));
+    if (options == kGnomeWallpaper) {
+        result.aspectStyle = WallpaperAspectStyle::Tile;
+    } else if (options == kGnomeCentered) {
+        result.aspectStyle = WallpaperAspectStyle::Center;
+    } else if (options == kGnomeScaled) {
+        result.aspectStyle = WallpaperAspectStyle::Fit;
+    } else if (options == kGnomeStretched) {
+        result.aspectStyle = WallpaperAspectStyle::Stretch;
+    } else if (options == kGnomeSpanned) {
+        result.aspectStyle = WallpaperAspectStyle::Span;
+    } else {
+        result.aspectStyle = WallpaperAspectStyle::Fill; // "zoom"
+    }
+    return result;
+}
+
+// A Plasma wallpaper package ships the same image in several resolutions, pick the largest one.
+[[nodiscard]] static inline QString kdeWallpaperPackageImage(const QString &packagePath)
+{
+    const QDir dir(packagePath + QLatin1Char('/') + kKdePackageImagesDirPath);
+    const QFileInfoList fileInfos = dir.entryInfoList(QDir::Files);
+    QString result = {};
+    qint64 largestArea = 0;
+    for (auto &&fileInfo : std::as_const(fileInfos)) {
+        // The file names are the resolutions, for example "3840x2160.png".
+        const QStringList resolution = fileInfo.completeBaseName().split(QLatin1Char('x'));
+        const qint64 area = ((resolution.size() == 2) ? (resolution.at(0).toLongLong() * resolution.at(1).toLongLong()) : 0);
+        if (result.isEmpty() || (area > largestArea)) {
+            result = fileInfo.absoluteFilePath();
+            largestArea = area;
+        }
+    }
+    return result;
+}
+
+[[nodiscard]] static inline LinuxWallpaper kdeWallpaper()
+{
+    // The group names of this file contain brackets, which QSettings doesn't
+    // understand, but it's a simple INI file so parse it ourself. Every
+    // containment (desktop) has its own wallpaper, use the first one.
+    QFile file(configFilePath(kKdeAppletsFilePath));
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+        return {};
+    }
+    QTextStream stream(&file);
+    bool imageGroup = false;
+    QString image = {};
+    QString slidePath = {};
+    int fillMode = 2; // Qt::PreserveAspectCrop, the default of Plasma.
+    while (!stream.atEnd()) {
+        const QString line = stream.readLine().trimmed();
+        if (line.startsWith(QLatin1Char('['))) {
+            if (!image.isEmpty()) {
+                break;
+            }
+            // The slideshow plugin stores the current slide the same way.
+            imageGroup = (line.endsWith(kKdeImageGroupSuffix) || line.endsWith(kKdeSlideshowGroupSuffix));
+            slidePath = {};
+            fillMode = 2;
+            continue;
+        }
+        if (!imageGroup) {
+            continue;
+        }
+        const int separator = line.indexOf(QLatin1Char('='));
+        if (separator <= 0) {
+            continue;
+        }
+        const QString key = line.left(separator).trimmed();
+        const QString value = line.mid(separator + 1).trimmed();
+        if (key == kKdeImageKey) {
+            image = toLocalFilePath(value);
+        } else if (key == kKdeFillModeKey) {
+            fillMode = value.toInt();
+        } else if (key == kKdeSlidePathsKey) {
+            // A comma separated list, the slideshow shuffles them all together.
+            slidePath = toLocalFilePath(value.section(QLatin1Char(','), 0, 0).trimmed());
+        }
+    }
+    if (image.isEmpty()) {
+        return {};
+    }
+    LinuxWallpaper result = {};
+    result.filePath = (QFileInfo(image).isDir() ? kdeWallpaperPackageImage(image) : image);
+    result.slideshowDirPath = slidePath;
+    // The values of QtQuick's Image::FillMode.
+    switch (fillMode) {
+    case 0: // Stretch
+        result.aspectStyle = WallpaperAspectStyle::Stretch;
+        break;
+    case 1: // PreserveAspectFit
+        result.aspectStyle = WallpaperAspectStyle::Fit;
+        break;
+    case 3: // Tile
+    case 4: // TileVertically
+    case 5: // TileHorizontally
+        result.aspectStyle = WallpaperAspectStyle::Tile;
+        break;
+    case 6: // Pad
+        result.aspectStyle = WallpaperAspectStyle::Center;
+        break;
+    default: // PreserveAspectCrop
+        result.aspectStyle = WallpaperAspectStyle::Fill;
+        break;
+    }
+    return result;
+}
+
+[[nodiscard]] static inline LinuxWallpaper xfceWallpaper()
+{
+    // <property name="backdrop"><property name="screen0"><property name="monitorXXX">
+    // <property name="workspace0"><property name="last-image" value="..."/> ...
+    // Every monitor and workspace has its own wallpaper, use the first one.
+    QFile file(configFilePath(kXfceDesktopFilePath));
+    if (!file.open(QFile::ReadOnly)) {
+        return {};
+    }
+    QXmlStreamReader reader(&file);
+    QStringList propertyPath = {};
+    QString imageParentPath = {};
+    QString image = {};
+    QHash<QString, int> imageStyles = {};
+    QSet<QString> cyclingPaths = {};
+    while (!reader.atEnd()) {
+        reader.readNext();
+        if (reader.isStartElement() && (reader.name() == kXfceProperty)) {
+            const QXmlStreamAttributes attributes = reader.attributes();
+            const QString name = attributes.value(kXfceName).toString();
+            const QString parentPath = propertyPath.join(QLatin1Char('/'));
+            if ((name == kXfceLastImage) && image.isEmpty()) {
+                image = attributes.value(kXfceValue).toString();
+                imageParentPath = parentPath;
+            } else if (name == kXfceImageStyle) {
+                imageStyles.insert(parentPath, attributes.value(kXfceValue).toInt());
+            } else if ((name == kXfceCycleEnable) && (attributes.value(kXfceValue) == kXfceTrue)) {
+                cyclingPaths.insert(parentPath);
+            }
+            propertyPath.append(name);
+        } else if (reader.isEndElement() && (reader.name() == kXfceProperty)) {
+            if (!propertyPath.isEmpty()) {
+                propertyPath.removeLast();
+            }
+        }
+    }
+    if (reader.hasError()) {
+        WARNING << "Failed to parse" << file.fileName() << ':' << reader.errorString();
+    }
+    const int imageStyle = imageStyles.value(imageParentPath, 5);
+    if (image.isEmpty() || (imageStyle == 0)) { // 0: None
+        return {};
+    }
+    LinuxWallpaper result = {};
+    result.filePath = image;
+    // xfdesktop cycles through the images next to the current one.
+    if (cyclingPaths.contains(imageParentPath)) {
+        result.slideshowDirPath = QFileInfo(image).absolutePath();
+    }
+    switch (imageStyle) {
+    case 1: // Centered
+        result.aspectStyle = WallpaperAspectStyle::Center;
+        break;
+    case 2: // Tiled
+        result.aspectStyle = WallpaperAspectStyle::Tile;
+        break;
+    case 3: // Stretched
+        result.aspectStyle = WallpaperAspectStyle::Stretch;
+        break;
+    case 4: // Scaled
+        result.aspectStyle = WallpaperAspectStyle::Fit;
+        break;
+    case 6: // Spanning screens
+        result.aspectStyle = WallpaperAspectStyle::Span;
+        break;
+    default: // 5: Zoomed
+        result.aspectStyle = WallpaperAspectStyle::Fill;
+        break;
+    }
+    return result;
+}
+
+static const WallpaperProvider kWallpaperProviders[] =
+{
+    {"GNOME",
+     []() -> QStringList { return {FRAMELESSHELPER_STRING_LITERAL("GNOME"), FRAMELESSHELPER_STRING_LITERAL("Unity"),
+         FRAMELESSHELPER_STRING_LITERAL("Budgie"), FRAMELESSHELPER_STRING_LITERAL("Pantheon")}; },
+     []() -> QStringList { return {configFilePath(kGnomeDconfFilePath), configFilePath(kGnomeKeyfileFilePath)}; },
+     gnomeWallpaper},
+    {"KDE",
+     []() -> QStringList { return {FRAMELESSHELPER_STRING_LITERAL("KDE")}; },
+     []() -> QStringList { return {configFilePath(kKdeAppletsFilePath)}; },
+     kdeWallpaper},
+    {"XFCE",
+     []() -> QStringList { return {FRAMELESSHELPER_STRING_LITERAL("XFCE")}; },
+     []() -> QStringList { return {configFilePath(kXfceDesktopFilePath)}; },
+     xfceWallpaper}
+};
+
+[[nodiscard]] static inline const WallpaperProvider *currentWallpaperProvider()
+{
+    static const auto result = []() -> const WallpaperProvider * {
+        // For example "ubuntu:GNOME".
+        const QStringList currentDesktops = qEnvironmentVariable(XDG_CURRENT_DESKTOP_ENV_VAR).split(QLatin1Char(':'));
+        for (auto &&provider : kWallpaperProviders) {
+            const QStringList names = provider.desktopNames();
+            for (auto &&desktop : std::as_const(currentDesktops)) {
+                if (names.contains(desktop, Qt::CaseInsensitive)) {
+                    DEBUG << "Using the wallpaper provider of" << provider.name;
+                    return &provider;
+                }
+            }
+        }
+        WARNING << "The wallpaper of this desktop environment is not supported:" << currentDesktops;
+        return nullptr;
+    }();
+    return result;
+}
+
+[[nodiscard]] static inline LinuxWallpaper currentWallpaper()
+{
+    const WallpaperProvider * const provider = currentWallpaperProvider();
+    if (!provider) {
+        return {};
+    }
+    return provider->wallpaper();
+}
+
+struct WallpaperWatcherData
+{
+    QPointer<QFileSystemWatcher> watcher = nullptr;
+    // Used to find out whether the image was modified in place.
+    QString filePath = {};
+    QDateTime lastModified = {};
+    qint64 fileSize = 0;
+};
+
+Q_GLOBAL_STATIC(WallpaperWatcherData, g_wallpaperWatcherData)
+
+/*
+    Watches the configuration files of the desktop environment and the image
+    itself. A file which is replaced (most programs save their files that way)
+    is no longer watched, so this is called again after every change. The
+    directory is watched instead as long as the file doesn't exist.
+ */
+static inline void updateWatchedWallpaperFiles(const WallpaperProvider *provider, QFileSystemWatcher *watcher)
+{
+    Q_ASSERT(provider);
+    Q_ASSERT(watcher);
+    if (!provider || !watcher) {
+        return;
+    }
+    QStringList filePaths = provider->configFilePaths();
+    const QString wallpaperFilePath = g_wallpaperWatcherData()->filePath;
+    if (!wallpaperFilePath.isEmpty()) {
+        filePaths.append(wallpaperFilePath);
+    }
+    QStringList paths = {};
+    for (auto &&filePath : std::as_const(filePaths)) {
+        const QFileInfo fileInfo(filePath);
+        if (fileInfo.exists()) {
+            paths.append(fileInfo.absoluteFilePath());
+        } else if (fileInfo.absoluteDir().exists()) {
+            paths.append(fileInfo.absolutePath());
+        }
+    }
+    QStringList obsoletePaths = (watcher->files() + watcher->directories());
+    for (auto &&path : std::as_const(paths)) {
+        obsoletePaths.removeAll(path);
+    }
+    if (!obsoletePaths.isEmpty()) {
+        watcher->removePaths(obsoletePaths);
+    }
+    QStringList newPaths = paths;
+    const QStringList watchedPaths = (watcher->files() + watcher->directories());
+    for (auto &&path : std::as_const(watchedPaths)) {
+        newPaths.removeAll(path);
+    }
+    newPaths.removeDuplicates();
+    if (!newPaths.isEmpty()) {
+        watcher->addPaths(newPaths);
+    }
+}
+
+// Remembers the state of the current wallpaper file, returns true if the same file has been modified.
+static inline bool updateWatchedWallpaperFileState()
+{
+    const QString filePath = Utils::getWallpaperFilePath();
+    const QFileInfo fileInfo(filePath);
+    const QDateTime lastModified = fileInfo.lastModified();
+    const qint64 fileSize = fileInfo.size();
+    WallpaperWatcherData * const data = g_wallpaperWatcherData();
+    const bool modified = (!filePath.isEmpty() && (filePath == data->filePath)
+        && ((lastModified != data->lastModified) || (fileSize != data->fileSize)));
+    data->filePath = filePath;
+    data->lastModified = lastModified;
+    data->fileSize = fileSize;
+    return modified;
+}
+
 [[maybe_unused]] [[nodiscard]] static inline int
     qtEdgesToWmMoveOrResizeOperation(const Qt::Edges edges)
 {
@@ -551,14 +994,17 @@ bool Utils::setBlurBehindWindowEnabled(const WId windowId, const BlurMode mode,
 
 QString Utils::getWallpaperFilePath()
 {
-    // ### TODO
-    return {};
+    return currentWallpaper().filePath;
 }
 
 WallpaperAspectStyle Utils::getWallpaperAspectStyle()
 {
-    // ### TODO
-    return WallpaperAspectStyle::Fill;
+    return currentWallpaper().aspectStyle;
+}
+
+QString Utils::getWallpaperSlideshowDirPath()
+{
+    return currentWallpaper().slideshowDirPath;
 }
 
 bool Utils::isBlurBehindWindowSupported()
@@ -594,9 +1040,121 @@ void Utils::registerThemeChangeNotification()
     g_signal_connect(settings, "notify::gtk-theme-name", themeChangeNotificationCallback, nullptr);
 }
 
+void Utils::registerWallpaperChangeNotification()
+{
+    const WallpaperProvider * const provider = currentWallpaperProvider();
+    if (!provider || !qApp || g_wallpaperWatcherData()->watcher) {
+        return;
+    }
+    updateWatchedWallpaperFileState();
+    const auto watcher = new QFileSystemWatcher(qApp);
+    g_wallpaperWatcherData()->watcher = watcher;
+    const auto timer = new QTimer(watcher);
+    timer->setSingleShot(true);
+    timer->setInterval(kWallpaperChangeNotificationDelay);
+    QObject::connect(watcher, &QFileSystemWatcher::fileChanged, timer, qOverload<>(&QTimer::start));
+    QObject::connect(watcher, &QFileSystemWatcher::directoryChanged, timer, qOverload<>(&QTimer::start));
+    QObject::connect(timer, &QTimer::timeout, watcher, [provider, watcher](){
+        // Most of the time something else has been changed, FramelessManager
+        // will find out that the wallpaper is still the same and do nothing.
+        const bool modified = updateWatchedWallpaperFileState();
+        updateWatchedWallpaperFiles(provider, watcher);
+        if (FramelessManager * const manager = FramelessManager::instance()) {
+            if (FramelessManagerPrivate * const managerPriv = FramelessManagerPrivate::get(manager)) {
+                managerPriv->notifyWallpaperHasChangedOrNot(modified);
+            }
+        }
+    });
+    updateWatchedWallpaperFiles(provider, watcher);
+}
+
 QColor Utils::getFrameBorderColor(const bool active)
 {
     return (active ? getWmThemeColor() : kDefaultDarkGrayColor);
 }
 
+void Utils::setGtkFrameExtents(const WId windowId, const QMargins &margins)
+{
+    Q_ASSERT(windowId);
+    if (!windowId) {
+        return;
+    }
+    // Not available on Wayland, the compositor draws the shadows there.
+    xcb_connection_t * const connection = x11_connection();
+    if (!connection) {
+        return;
+    }
+    static const auto gtkFrameExtents = [connection]() -> xcb_atom_t {
+        const xcb_intern_atom_cookie_t cookie = xcb_intern_atom(connection, false,
+                             qstrlen(_GTK_FRAME_EXTENTS_ATOM_NAME), _GTK_FRAME_EXTENTS_ATOM_NAME);
+        xcb_intern_atom_reply_t * const reply = xcb_intern_atom_reply(connection, cookie, nullptr);
+        Q_ASSERT(reply);
+        const xcb_atom_t atom = reply->atom;
+        Q_ASSERT(atom);
+        std::free(reply);
+        return atom;
+    }();
+    if (margins.isNull()) {
+        xcb_delete_property(connection, windowId, gtkFrameExtents);
+    } else {
+        // The order is different from QMargins: left, right, top, bottom.
+        const quint32 extents[4] = { quint32(qMax(0, margins.left())), quint32(qMax(0, margins.right())),
+                                     quint32(qMax(0, margins.top())), quint32(qMax(0, margins.bottom())) };
+        xcb_change_property(connection, XCB_PROP_MODE_REPLACE, windowId,
+                            gtkFrameExtents, XCB_ATOM_CARDINAL, 32, 4, extents);
+    }
+    xcb_flush(connection);
+}
+
+bool Utils::isCompositingManagerRunning()
+{
+    xcb_connection_t * const connection = x11_connection();
+    if (!connection) {
+        // There's no Wayland without a compositor.
+        return QGuiApplication::platformName().startsWith(FRAMELESSHELPER_STRING_LITERAL("wayland"), Qt::CaseInsensitive);
+    }
+    const QByteArray atomName = QByteArray(_NET_WM_CM_S_ATOM_NAME_PREFIX) + QByteArray::number(x11_appScreen());
+    const xcb_intern_atom_cookie_t atomCookie = xcb_intern_atom(connection, false, quint16(atomName.size()), atomName.constData());
+    xcb_intern_atom_reply_t * const atomReply = xcb_intern_atom_reply(connection, atomCookie, nullptr);
+    if (!atomReply) {
+        return false;
+    }
+    const xcb_atom_t atom = atomReply->atom;
+    std::free(atomReply);
+    if (atom == XCB_NONE) {
+        return false;
+    }
+    const xcb_get_selection_owner_cookie_t ownerCookie = xcb_get_selection_owner(connection, atom);
+    xcb_get_selection_owner_reply_t * const ownerReply = xcb_get_selection_owner_reply(connection, ownerCookie, nullptr);
+    if (!ownerReply) {
+        return false;
+    }
+    const bool running = (ownerReply->owner != XCB_NONE);
+    std::free(ownerReply);
+    return running;
+}
+
+void Utils::setX11InputShape(const WId windowId, const QRect &rect)
+{
+    Q_ASSERT(windowId);
+    if (!windowId) {
+        return;
+    }
+    // Wayland has no such thing, the input region follows the window geometry there.
+    xcb_connection_t * const connection = x11_connection();
+    if (!connection) {
+        return;
+    }
+    if (rect.isEmpty()) {
+        // Back to the default input shape: the whole window.
+        xcb_shape_mask(connection, XCB_SHAPE_SO_SET, XCB_SHAPE_SK_INPUT, windowId, 0, 0, XCB_NONE);
+    } else {
+        const xcb_rectangle_t rectangle = { qint16(rect.x()), qint16(rect.y()),
+                                            quint16(rect.width()), quint16(rect.height()) };
+        xcb_shape_rectangles(connection, XCB_SHAPE_SO_SET, XCB_SHAPE_SK_INPUT,
+                             XCB_CLIP_ORDERING_UNSORTED, windowId, 0, 0, 1, &rectangle);
+    }
+    xcb_flush(connection);
+}
+
 FRAMELESSHELPER_END_NAMESPACE
@@ -743,6 +743,12 @@ WallpaperAspectStyle Utils::getWallpaperAspectStyle()
     return WallpaperAspectStyle::Stretch;
 }
 
+QString Utils::getWallpaperSlideshowDirPath()
+{
+    // ### TODO
+    return {};
+}
+
 bool Utils::isBlurBehindWindowSupported()
 {
     static const auto result = []() -> bool {
@@ -31,6 +31,8 @@
 #include "winverhelper_p.h"
 #include <QtCore/qmutex.h>
 #include <QtCore/qhash.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfileinfo.h>
 #include <QtGui/qwindow.h>
 #include <QtGui/qguiapplication.h>
 #ifndef FRAMELESSHELPER_CORE_NO_PRIVATE
@@ -68,6 +70,9 @@ Q_LOGGING_CATEGORY(lcUtilsWin, "wangwenx190.framelesshelper.core.utils.win")
 using namespace Global;
 
 static constexpr const char kNoFixQtInternalEnvVar[] = "FRAMELESSHELPER_WINDOWS_DONT_FIX_QT";
+static constexpr const char kAppDataEnvVar[] = "APPDATA";
+static constexpr const wchar_t kSlideshowSectionName[] = L"Slideshow";
+static constexpr const wchar_t kSlideshowImagesRootPathKeyName[] = L"ImagesRootPath";
 static const QString qDwmColorKeyName = QString::fromWCharArray(kDwmColorKeyName);
 static constexpr const char kDpiNoAccessErrorMessage[] =
     "FramelessHelper doesn't have access to change the current process's DPI awareness mode,"
@@ -97,6 +102,7 @@ FRAMELESSHELPER_STRING_CONSTANT(QueryPerformanceFrequency)
 FRAMELESSHELPER_STRING_CONSTANT(QueryPerformanceCounter)
 FRAMELESSHELPER_STRING_CONSTANT(DwmGetCompositionTimingInfo)
 FRAMELESSHELPER_STRING_CONSTANT(SystemParametersInfoW)
+FRAMELESSHELPER_STRING_CONSTANT2(SlideshowIniFilePath, "Microsoft/Windows/Themes/slideshow.ini")
 #ifdef Q_PROCESSOR_X86_64
   FRAMELESSHELPER_STRING_CONSTANT(GetClassLongPtrW)
   FRAMELESSHELPER_STRING_CONSTANT(SetClassLongPtrW)
@@ -1956,6 +1962,31 @@ WallpaperAspectStyle Utils::getWallpaperAspectStyle()
     }
 }
 
+QString Utils::getWallpaperSlideshowDirPath()
+{
+    // The slideshow settings are left behind when the slideshow is turned off,
+    // so only trust them if the current wallpaper comes from that folder.
+    const QString appDataDirPath = qEnvironmentVariable(kAppDataEnvVar);
+    if (appDataDirPath.isEmpty()) {
+        return {};
+    }
+    const std::wstring iniFilePath = QDir::toNativeSeparators(appDataDirPath + QLatin1Char('/') + kSlideshowIniFilePath).toStdWString();
+    wchar_t path[MAX_PATH] = {};
+    if (GetPrivateProfileStringW(kSlideshowSectionName, kSlideshowImagesRootPathKeyName,
+            nullptr, path, MAX_PATH, iniFilePath.c_str()) == 0) {
+        return {};
+    }
+    const QString dirPath = QDir::cleanPath(QDir::fromNativeSeparators(QString::fromWCharArray(path)));
+    const QString wallpaperFilePath = getWallpaperFilePath();
+    if (dirPath.isEmpty() || wallpaperFilePath.isEmpty()) {
+        return {};
+    }
+    if (QFileInfo(wallpaperFilePath).absolutePath().compare(dirPath, Qt::CaseInsensitive) != 0) {
+        return {};
+    }
+    return dirPath;
+}
+
 bool Utils::isBlurBehindWindowSupported()
 {
     static const auto result = []() -> bool {
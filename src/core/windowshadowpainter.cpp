@@ -0,0 +1,459 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "windowshadowpainter.h"
+#include "windowshadowpainter_p.h"
+#include "micamaterial_p.h"
+#include "utils.h"
+#include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
+#include <QtGui/qpainter.h>
+#include <QtGui/qwindow.h>
+#include <algorithm>
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+Q_LOGGING_CATEGORY(lcWindowShadowPainter, "wangwenx190.framelesshelper.core.windowshadowpainter")
+
+#ifdef FRAMELESSHELPER_CORE_NO_DEBUG_OUTPUT
+#  define INFO QT_NO_QDEBUG_MACRO()
+#  define DEBUG QT_NO_QDEBUG_MACRO()
+#  define WARNING QT_NO_QDEBUG_MACRO()
+#  define CRITICAL QT_NO_QDEBUG_MACRO()
+#else
+#  define INFO qCInfo(lcWindowShadowPainter)
+#  define DEBUG qCDebug(lcWindowShadowPainter)
+#  define WARNING qCWarning(lcWindowShadowPainter)
+#  define CRITICAL qCCritical(lcWindowShadowPainter)
+#endif
+
+using namespace Global;
+
+static constexpr const int kMaximumShadowRadius = 100;
+static constexpr const int kMaximumShadowCornerRadius = 100;
+static constexpr const int kDefaultShadowRadius = 16;
+static constexpr const QPoint kDefaultShadowOffset = {0, 2};
+static constexpr const int kDefaultShadowCornerRadius = 0;
+static constexpr const qsizetype kMaximumShadowTileCacheSize = 16;
+static Q_CONSTEXPR2 const QColor kDefaultActiveShadowColor = {0, 0, 0, 110};
+static Q_CONSTEXPR2 const QColor kDefaultInactiveShadowColor = {0, 0, 0, 60};
+
+struct WindowShadowData
+{
+    QMutex mutex;
+    // The blurred tiles are shared by all the windows: they only depend on the
+    // shadow parameters, not on the window size. The offset only moves the tile
+    // around, it doesn't change a single pixel of it, so it's not part of the key.
+    QHash<quint64, QImage> tiles = {};
+};
+
+Q_GLOBAL_STATIC(WindowShadowData, g_windowShadowData)
+
+[[nodiscard]] static inline quint64 shadowTileKey(const int radius, const int cornerRadius,
+    const QColor &color, const qreal devicePixelRatio)
+{
+    // Both radii are less than 128, and nobody will ever use a scale factor
+    // larger than 655.35, so everything fits into 64 bits.
+    const auto dpr = quint64(qBound(0, qRound(devicePixelRatio * qreal(100)), 0xFFFF));
+    return ((dpr << 46) | (quint64(cornerRadius & 0x7F) << 39)
+        | (quint64(radius & 0x7F) << 32) | quint64(color.rgba()));
+}
+
+WindowShadowPainterPrivate::WindowShadowPainterPrivate(WindowShadowPainter *q) : QObject(q)
+{
+    Q_ASSERT(q);
+    if (!q) {
+        return;
+    }
+    q_ptr = q;
+    m_radius = kDefaultShadowRadius;
+    m_offset = kDefaultShadowOffset;
+    m_cornerRadius = kDefaultShadowCornerRadius;
+    m_activeColor = kDefaultActiveShadowColor;
+    m_inactiveColor = kDefaultInactiveShadowColor;
+}
+
+WindowShadowPainterPrivate::~WindowShadowPainterPrivate() = default;
+
+WindowShadowPainterPrivate *WindowShadowPainterPrivate::get(WindowShadowPainter *q)
+{
+    Q_ASSERT(q);
+    if (!q) {
+        return nullptr;
+    }
+    return q->d_func();
+}
+
+const WindowShadowPainterPrivate *WindowShadowPainterPrivate::get(const WindowShadowPainter *q)
+{
+    Q_ASSERT(q);
+    if (!q) {
+        return nullptr;
+    }
+    return q->d_func();
+}
+
+/*
+*  The shadow is painted as a 9-slice image: a blurred rounded rectangle that
+*  is just large enough to contain the two corners of each side and a single
+*  pixel row/column between them. The corners are copied as-is and the middle
+*  row/column is stretched to the window size, so resizing the window never
+*  needs to blur anything again.
+*
+*  Each slice is "2 * radius + cornerRadius" device pixels: "radius" pixels of
+*  fade-out outside of the rectangle, and the rounded corner plus "radius"
+*  pixels of fade-in inside of it.
+*/
+QImage WindowShadowPainterPrivate::shadowTile(const int radius, const int cornerRadius,
+    const QColor &color, const qreal devicePixelRatio)
+{
+    Q_ASSERT(radius > 0);
+    Q_ASSERT(cornerRadius >= 0);
+    Q_ASSERT(color.isValid());
+    Q_ASSERT(devicePixelRatio > 0);
+    if ((radius <= 0) || (cornerRadius < 0) || !color.isValid() || (devicePixelRatio <= 0)) {
+        return {};
+    }
+    if (g_windowShadowData.isDestroyed()) {
+        return {};
+    }
+    const quint64 key = shadowTileKey(radius, cornerRadius, color, devicePixelRatio);
+    {
+        const QMutexLocker locker(&g_windowShadowData()->mutex);
+        const auto it = g_windowShadowData()->tiles.constFind(key);
+        if (it != g_windowShadowData()->tiles.constEnd()) {
+            return it.value();
+        }
+    }
+    const int deviceRadius = qMax(1, qRound(qreal(radius) * devicePixelRatio));
+    const int deviceCornerRadius = qRound(qreal(cornerRadius) * devicePixelRatio);
+    const int slice = ((deviceRadius * 2) + deviceCornerRadius);
+    const int extent = ((slice * 2) + 1);
+    QImage image(extent, extent, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    {
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setPen(Qt::NoPen);
+        // Paint it black: the blur only touches the alpha channel, and a pixel with
+        // all color components being zero is a valid premultiplied pixel whatever
+        // its alpha is. The real color is applied after the blur.
+        painter.setBrush(kDefaultBlackColor);
+        const QRectF rect = QRectF(image.rect()).adjusted(deviceRadius, deviceRadius, -deviceRadius, -deviceRadius);
+        if (deviceCornerRadius > 0) {
+            painter.drawRoundedRect(rect, deviceCornerRadius, deviceCornerRadius);
+        } else {
+            painter.drawRect(rect);
+        }
+    }
+    MicaMaterialPrivate::alphaBlur(image, deviceRadius, true);
+    {
+        QPainter painter(&image);
+        painter.setCompositionMode(QPainter::CompositionMode_SourceIn);
+        painter.fillRect(image.rect(), color);
+    }
+    const QMutexLocker locker(&g_windowShadowData()->mutex);
+    // Someone animating the shadow color shouldn't grow the cache forever.
+    if (g_windowShadowData()->tiles.size() >= kMaximumShadowTileCacheSize) {
+        g_windowShadowData()->tiles.clear();
+    }
+    g_windowShadowData()->tiles.insert(key, image);
+    return image;
+}
+
+QMargins WindowShadowPainterPrivate::margins() const
+{
+#ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
+    // There's no blur without the private Qt functionalities, so there's no
+    // shadow either, and nobody should reserve any space for it.
+    return {};
+#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
+    return {qMax(0, m_radius - m_offset.x()), qMax(0, m_radius - m_offset.y()),
+            qMax(0, m_radius + m_offset.x()), qMax(0, m_radius + m_offset.y())};
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+}
+
+QList<QPair<QRectF, QRectF>> WindowShadowPainterPrivate::patches(const QSize &size,
+    const int tileExtent, const qreal devicePixelRatio) const
+{
+    Q_ASSERT(!size.isEmpty());
+    Q_ASSERT(tileExtent > 0);
+    Q_ASSERT(devicePixelRatio > 0);
+    if (size.isEmpty() || (tileExtent <= 0) || (devicePixelRatio <= 0)) {
+        return {};
+    }
+    if ((m_radius <= 0) || margins().isNull()) {
+        return {};
+    }
+    const QRectF contentsRect = QRectF(QRect(QPoint(0, 0), size).marginsRemoved(margins()));
+    if (contentsRect.isEmpty()) {
+        return {};
+    }
+    const QRectF shadowRect = contentsRect.translated(m_offset)
+        .adjusted(-m_radius, -m_radius, m_radius, m_radius);
+    const int tileSlice = (tileExtent / 2);
+    // A window smaller than two corners squeezes the corners a little, there's
+    // nothing to stretch in this case.
+    const qreal sliceX = qMin(qreal(tileSlice) / devicePixelRatio, shadowRect.width() / qreal(2));
+    const qreal sliceY = qMin(qreal(tileSlice) / devicePixelRatio, shadowRect.height() / qreal(2));
+    const qreal targetX[4] = { shadowRect.left(), shadowRect.left() + sliceX,
+                               shadowRect.right() - sliceX, shadowRect.right() };
+    const qreal targetY[4] = { shadowRect.top(), shadowRect.top() + sliceY,
+                               shadowRect.bottom() - sliceY, shadowRect.bottom() };
+    const qreal source[4] = { 0, qreal(tileSlice), qreal(tileSlice + 1), qreal(tileExtent) };
+    // The 9 slices, cut once more along the edges of the window and of its contents,
+    // so that the pieces under the contents can be left out: the shadow must not
+    // darken a translucent window (a Mica window, for example).
+    const auto cuts = [](const qreal (&target)[4], const qreal contentsBegin,
+                         const qreal contentsEnd, const qreal windowEnd) -> QList<qreal> {
+        const qreal begin = qMax(target[0], qreal(0));
+        const qreal end = qMin(target[3], windowEnd);
+        QList<qreal> result = { begin, end };
+        for (const qreal cut : { target[1], target[2], contentsBegin, contentsEnd }) {
+            if ((cut > begin) && (cut < end)) {
+                result.append(cut);
+            }
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    };
+    // Where a position of the shadow comes from in the tile, for each axis.
+    const auto sourcePos = [&source](const qreal (&target)[4], const qreal pos) -> qreal {
+        for (int i = 0; i != 3; ++i) {
+            if ((pos <= target[i + 1]) && (target[i + 1] > target[i])) {
+                return (source[i] + ((qMax(pos, target[i]) - target[i])
+                    * (source[i + 1] - source[i]) / (target[i + 1] - target[i])));
+            }
+        }
+        return source[3];
+    };
+    const QList<qreal> cutsX = cuts(targetX, contentsRect.left(), contentsRect.right(), qreal(size.width()));
+    const QList<qreal> cutsY = cuts(targetY, contentsRect.top(), contentsRect.bottom(), qreal(size.height()));
+    QList<QPair<QRectF, QRectF>> result = {};
+    for (int row = 0; row < (cutsY.size() - 1); ++row) {
+        for (int column = 0; column < (cutsX.size() - 1); ++column) {
+            const QRectF target = QRectF(QPointF(cutsX.at(column), cutsY.at(row)),
+                                         QPointF(cutsX.at(column + 1), cutsY.at(row + 1)));
+            if ((target.width() <= 0) || (target.height() <= 0) || contentsRect.contains(target)) {
+                continue;
+            }
+            const QRectF sourceRect = QRectF(
+                QPointF(sourcePos(targetX, target.left()), sourcePos(targetY, target.top())),
+                QPointF(sourcePos(targetX, target.right()), sourcePos(targetY, target.bottom())));
+            result.append(qMakePair(target, sourceRect));
+        }
+    }
+    return result;
+}
+
+void WindowShadowPainterPrivate::paint(QPainter *painter, const QSize &size, const bool active) const
+{
+    Q_ASSERT(painter);
+    Q_ASSERT(!size.isEmpty());
+    if (!painter || size.isEmpty()) {
+        return;
+    }
+    if ((m_radius <= 0) || margins().isNull()) {
+        return;
+    }
+    const QColor color = (active ? m_activeColor : m_inactiveColor);
+    if (color.alpha() <= 0) {
+        return;
+    }
+    const QPaintDevice * const device = painter->device();
+    const qreal dpr = (device ? device->devicePixelRatioF() : qreal(1));
+    const QImage tile = shadowTile(m_radius, m_cornerRadius, color, dpr);
+    if (tile.isNull()) {
+        return;
+    }
+    const QList<QPair<QRectF, QRectF>> pieces = patches(size, tile.width(), dpr);
+    if (pieces.isEmpty()) {
+        return;
+    }
+    painter->save();
+    painter->setRenderHints(QPainter::SmoothPixmapTransform);
+    for (auto &&piece : std::as_const(pieces)) {
+        painter->drawImage(piece.first, tile, piece.second);
+    }
+    painter->restore();
+}
+
+WindowShadowPainter::WindowShadowPainter(QObject *parent)
+    : QObject(parent), d_ptr(new WindowShadowPainterPrivate(this))
+{
+}
+
+WindowShadowPainter::~WindowShadowPainter() = default;
+
+int WindowShadowPainter::radius() const
+{
+    Q_D(const WindowShadowPainter);
+    return d->m_radius;
+}
+
+QPoint WindowShadowPainter::offset() const
+{
+    Q_D(const WindowShadowPainter);
+    return d->m_offset;
+}
+
+int WindowShadowPainter::cornerRadius() const
+{
+    Q_D(const WindowShadowPainter);
+    return d->m_cornerRadius;
+}
+
+QColor WindowShadowPainter::activeColor() const
+{
+    Q_D(const WindowShadowPainter);
+    return d->m_activeColor;
+}
+
+QColor WindowShadowPainter::inactiveColor() const
+{
+    Q_D(const WindowShadowPainter);
+    return d->m_inactiveColor;
+}
+
+QMargins WindowShadowPainter::margins() const
+{
+    Q_D(const WindowShadowPainter);
+    return d->margins();
+}
+
+void WindowShadowPainter::paint(QPainter *painter, const QSize &size, const bool active) const
+{
+    Q_D(const WindowShadowPainter);
+    d->paint(painter, size, active);
+}
+
+void WindowShadowPainter::updateFrameExtents(QWindow *window) const
+{
+    Q_ASSERT(window);
+    if (!window) {
+        return;
+    }
+#ifdef Q_OS_LINUX
+    // The window manager needs to know which part of the window is the shadow,
+    // otherwise it will snap, tile and place the window by its shadow.
+    // A maximized or full screen window doesn't show its shadow.
+    const qreal dpr = window->devicePixelRatio();
+    const QMargins extents = ((window->windowState() == Qt::WindowNoState) ? margins() : QMargins());
+    const WId windowId = window->winId();
+    Utils::setGtkFrameExtents(windowId, {qRound(qreal(extents.left()) * dpr),
+        qRound(qreal(extents.top()) * dpr), qRound(qreal(extents.right()) * dpr),
+        qRound(qreal(extents.bottom()) * dpr)});
+    // The clicks on the shadow belong to the windows below. Only the resize area
+    // reaches into it, "Utils::calculateWindowEdges()" reads the margins back.
+    window->setProperty(kWindowShadowMarginsVar.constData(), QVariant::fromValue(extents));
+    QRect inputRect = {};
+    if (!extents.isNull()) {
+        const QRect windowRect = QRect(QPoint(0, 0), window->size());
+        const QMargins resizeMargins = {kDefaultResizeBorderThickness, kDefaultResizeBorderThickness,
+                                        kDefaultResizeBorderThickness, kDefaultResizeBorderThickness};
+        const QRect rect = windowRect.marginsRemoved(extents).marginsAdded(resizeMargins).intersected(windowRect);
+        inputRect = QRect(QPoint(qRound(qreal(rect.x()) * dpr), qRound(qreal(rect.y()) * dpr)),
+                          QSize(qRound(qreal(rect.width()) * dpr), qRound(qreal(rect.height()) * dpr)));
+    }
+    Utils::setX11InputShape(windowId, inputRect);
+#endif // Q_OS_LINUX
+}
+
+void WindowShadowPainter::setRadius(const int value)
+{
+    Q_ASSERT(value >= 0);
+    Q_ASSERT(value < kMaximumShadowRadius);
+    if ((value < 0) || (value >= kMaximumShadowRadius)) {
+        return;
+    }
+    if (radius() == value) {
+        return;
+    }
+    Q_D(WindowShadowPainter);
+    d->m_radius = value;
+    Q_EMIT radiusChanged();
+    Q_EMIT marginsChanged();
+    Q_EMIT shouldRepaint();
+}
+
+void WindowShadowPainter::setOffset(const QPoint &value)
+{
+    if (offset() == value) {
+        return;
+    }
+    Q_D(WindowShadowPainter);
+    d->m_offset = value;
+    Q_EMIT offsetChanged();
+    Q_EMIT marginsChanged();
+    Q_EMIT shouldRepaint();
+}
+
+void WindowShadowPainter::setCornerRadius(const int value)
+{
+    Q_ASSERT(value >= 0);
+    Q_ASSERT(value < kMaximumShadowCornerRadius);
+    if ((value < 0) || (value >= kMaximumShadowCornerRadius)) {
+        return;
+    }
+    if (cornerRadius() == value) {
+        return;
+    }
+    Q_D(WindowShadowPainter);
+    d->m_cornerRadius = value;
+    Q_EMIT cornerRadiusChanged();
+    Q_EMIT shouldRepaint();
+}
+
+void WindowShadowPainter::setActiveColor(const QColor &value)
+{
+    Q_ASSERT(value.isValid());
+    if (!value.isValid()) {
+        return;
+    }
+    if (activeColor() == value) {
+        return;
+    }
+    Q_D(WindowShadowPainter);
+    d->m_activeColor = value;
+    Q_EMIT activeColorChanged();
+    Q_EMIT shouldRepaint();
+}
+
+void WindowShadowPainter::setInactiveColor(const QColor &value)
+{
+    Q_ASSERT(value.isValid());
+    if (!value.isValid()) {
+        return;
+    }
+    if (inactiveColor() == value) {
+        return;
+    }
+    Q_D(WindowShadowPainter);
+    d->m_inactiveColor = value;
+    Q_EMIT inactiveColorChanged();
+    Q_EMIT shouldRepaint();
+}
+
+FRAMELESSHELPER_END_NAMESPACE
@@ -0,0 +1 @@
+#include "../../include/FramelessHelper/Core/windowshadowpainter.h"
@@ -0,0 +1 @@
+#include "../../include/FramelessHelper/Core/private/windowshadowpainter_p.h"
@@ -92,6 +92,7 @@ void initialize()
     qRegisterMetaType<QuickGlobal::WindowEdge>();
     qRegisterMetaType<QuickGlobal::WindowEdges>();
     qRegisterMetaType<QuickGlobal::WindowCornerStyle>();
+    qRegisterMetaType<QuickGlobal::MicaMaterialQuality>();
 
 #if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
     qRegisterMetaType<QuickGlobal>();
@@ -28,6 +28,7 @@
 #include "quickwindowborder.h"
 #include <QtCore/qmutex.h>
 #include <QtCore/qtimer.h>
+#include <QtCore/qcoreapplication.h>
 #ifndef FRAMELESSHELPER_QUICK_NO_PRIVATE
 #  if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
 #    include <QtGui/qpa/qplatformwindow.h> // For QWINDOWSIZE_MAX
@@ -41,6 +42,12 @@
 #include <framelessmanager.h>
 #include <framelessconfig_p.h>
 #include <utils.h>
+#include <windowshadowpainter.h>
+#include <windowshadowpainter_p.h>
+#include <QtGui/qevent.h>
+#include <QtGui/qmatrix4x4.h>
+#include <QtQuick/qsgimagenode.h>
+#include <QtQuick/qsgrectanglenode.h>
 #ifdef Q_OS_WINDOWS
 #  include <winverhelper_p.h>
 #endif // Q_OS_WINDOWS
@@ -89,6 +96,336 @@ struct QuickHelper
 
 Q_GLOBAL_STATIC(QuickHelper, g_quickHelper)
 
+#if (defined(Q_OS_LINUX) && !defined(FRAMELESSHELPER_QUICK_NO_PRIVATE))
+/*
+    Nobody draws a shadow for a frameless window on Linux, so we paint our own
+    one into a translucent area around the window contents. The window grows by
+    the shadow margins. Its content item is shifted into the middle by a transform
+    and gets the size of the visible part straight from the resize events, so it's
+    never laid out at the full window size first. This item stays below everything
+    else and covers the whole window. It also paints the background the (now
+    transparent) window doesn't paint anymore.
+ */
+class QuickWindowShadowTransform : public QQuickTransform
+{
+    Q_DISABLE_COPY_MOVE(QuickWindowShadowTransform)
+
+public:
+    explicit QuickWindowShadowTransform(QObject *parent = nullptr) : QQuickTransform(parent) {}
+    ~QuickWindowShadowTransform() override = default;
+
+    void setOffset(const QPoint &value)
+    {
+        if (m_offset == value) {
+            return;
+        }
+        m_offset = value;
+        update();
+    }
+
+    void applyTo(QMatrix4x4 *matrix) const override
+    {
+        Q_ASSERT(matrix);
+        if (!matrix || m_offset.isNull()) {
+            return;
+        }
+        matrix->translate(m_offset.x(), m_offset.y());
+    }
+
+private:
+    QPoint m_offset = {};
+};
+
+/*
+    The background and the 9-slice shadow, the pieces of which share one texture
+    and only get new rectangles when the window is resized.
+ */
+class QuickWindowShadowNode : public QSGNode
+{
+    Q_DISABLE_COPY_MOVE(QuickWindowShadowNode)
+
+public:
+    explicit QuickWindowShadowNode(QQuickWindow *window);
+    ~QuickWindowShadowNode() override;
+
+    void setBackground(const QRectF &rect, const QColor &color);
+    void setShadow(const QImage &tile, const QList<QPair<QRectF, QRectF>> &patches);
+
+private:
+    QQuickWindow *m_window = nullptr;
+    QSGRectangleNode *m_backgroundNode = nullptr;
+    QList<QSGImageNode *> m_patchNodes = {};
+    QSGTexture *m_texture = nullptr;
+    qint64 m_tileCacheKey = 0;
+};
+
+QuickWindowShadowNode::QuickWindowShadowNode(QQuickWindow *window)
+{
+    Q_ASSERT(window);
+    if (!window) {
+        return;
+    }
+    m_window = window;
+    m_backgroundNode = window->createRectangleNode();
+    appendChildNode(m_backgroundNode);
+}
+
+QuickWindowShadowNode::~QuickWindowShadowNode()
+{
+    // The child nodes are deleted by QSGNode, they don't own the texture.
+    if (m_texture) {
+        delete m_texture;
+        m_texture = nullptr;
+    }
+}
+
+void QuickWindowShadowNode::setBackground(const QRectF &rect, const QColor &color)
+{
+    if (!m_backgroundNode) {
+        return;
+    }
+    m_backgroundNode->setRect(rect);
+    m_backgroundNode->setColor(color);
+}
+
+void QuickWindowShadowNode::setShadow(const QImage &tile, const QList<QPair<QRectF, QRectF>> &patches)
+{
+    if (!m_window) {
+        return;
+    }
+    // The tile is only blurred again when the shadow parameters change.
+    if (!tile.isNull() && (!m_texture || (m_tileCacheKey != tile.cacheKey()))) {
+        QSGTexture * const texture = m_window->createTextureFromImage(tile);
+        for (auto &&node : std::as_const(m_patchNodes)) {
+            node->setTexture(texture);
+        }
+        if (m_texture) {
+            delete m_texture;
+        }
+        m_texture = texture;
+        m_tileCacheKey = tile.cacheKey();
+    }
+    const qsizetype count = (m_texture ? patches.size() : 0);
+    while (m_patchNodes.size() > count) {
+        QSGImageNode * const node = m_patchNodes.takeLast();
+        removeChildNode(node);
+        delete node;
+    }
+    while (m_patchNodes.size() < count) {
+        QSGImageNode * const node = m_window->createImageNode();
+        node->setFiltering(QSGTexture::Linear);
+        node->setTexture(m_texture);
+        appendChildNode(node);
+        m_patchNodes.append(node);
+    }
+    for (qsizetype i = 0; i != count; ++i) {
+        QSGImageNode * const node = m_patchNodes.at(i);
+        node->setRect(patches.at(i).first);
+        node->setSourceRect(patches.at(i).second);
+    }
+}
+
+class QuickWindowShadowItem : public QQuickItem
+{
+    Q_DISABLE_COPY_MOVE(QuickWindowShadowItem)
+
+public:
+    explicit QuickWindowShadowItem(QQuickWindow *window);
+    ~QuickWindowShadowItem() override;
+
+    Q_NODISCARD bool eventFilter(QObject *object, QEvent *event) override;
+
+protected:
+    [[nodiscard]] QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+    void itemChange(const ItemChange change, const ItemChangeData &value) override;
+
+private:
+    Q_NODISCARD bool isWindowNormal() const;
+    Q_NODISCARD QMargins reservedMargins() const;
+    void updateShadowMargins();
+    void updateGeometry();
+    void updateFrameExtents();
+
+private:
+    QPointer<QQuickWindow> m_window = nullptr;
+    WindowShadowPainter *m_shadowPainter = nullptr;
+    QuickWindowShadowTransform *m_transform = nullptr;
+    QColor m_backgroundColor = {};
+    // The margins the window has been extended by to make room for the shadow.
+    QMargins m_shadowMargins = {};
+    bool m_resizing = false;
+};
+
+QuickWindowShadowItem::QuickWindowShadowItem(QQuickWindow *window)
+{
+    Q_ASSERT(window);
+    if (!window) {
+        return;
+    }
+    m_window = window;
+    QQuickItem * const rootItem = window->contentItem();
+    setParent(rootItem);
+    setParentItem(rootItem);
+    setZ(-1000); // Below everything else, including the Mica material.
+    setFlag(ItemHasContents);
+    m_backgroundColor = window->color();
+    window->setColor(kDefaultTransparentColor);
+    m_transform = new QuickWindowShadowTransform(this);
+    m_transform->appendToItem(rootItem);
+    m_shadowPainter = new WindowShadowPainter(this);
+    connect(m_shadowPainter, &WindowShadowPainter::shouldRepaint, this, [this](){ update(); });
+    connect(m_shadowPainter, &WindowShadowPainter::marginsChanged, this, [this](){ updateShadowMargins(); });
+    connect(window, &QQuickWindow::colorChanged, this, [this](const QColor &color){
+        // The window background is ours to paint now.
+        if (color.alpha() <= 0) {
+            return;
+        }
+        m_backgroundColor = color;
+        m_window->setColor(kDefaultTransparentColor);
+        update();
+    });
+    connect(window, &QQuickWindow::widthChanged, this, [this](){ updateFrameExtents(); });
+    connect(window, &QQuickWindow::heightChanged, this, [this](){ updateFrameExtents(); });
+    connect(window, &QQuickWindow::windowStateChanged, this, [this](){
+        updateGeometry();
+        updateFrameExtents();
+    });
+    connect(window, &QQuickWindow::visibleChanged, this, [this](){ updateFrameExtents(); });
+    connect(window, &QQuickWindow::activeChanged, this, [this](){ update(); });
+    window->installEventFilter(this);
+    updateShadowMargins();
+}
+
+QuickWindowShadowItem::~QuickWindowShadowItem() = default;
+
+bool QuickWindowShadowItem::eventFilter(QObject *object, QEvent *event)
+{
+    Q_ASSERT(object);
+    Q_ASSERT(event);
+    if (!object || !event) {
+        return false;
+    }
+    if (!m_window || (object != m_window) || (event->type() != QEvent::Resize) || m_resizing) {
+        return QQuickItem::eventFilter(object, event);
+    }
+    const QMargins margins = reservedMargins();
+    if (margins.isNull()) {
+        updateGeometry();
+        return QQuickItem::eventFilter(object, event);
+    }
+    // The window resizes its content item to the size the event carries. Tell it the
+    // size of the visible part right away, instead of correcting the content item
+    // afterwards and laying out its children twice for every resize.
+    const auto resizeEvent = static_cast<QResizeEvent *>(event);
+    const QSize marginsSize = {margins.left() + margins.right(), margins.top() + margins.bottom()};
+    const QSize oldSize = resizeEvent->oldSize();
+    QResizeEvent visibleResizeEvent(resizeEvent->size() - marginsSize,
+        (oldSize.isValid() ? (oldSize - marginsSize) : oldSize));
+    m_resizing = true;
+    QCoreApplication::sendEvent(m_window, &visibleResizeEvent);
+    m_resizing = false;
+    updateGeometry();
+    return true;
+}
+
+QSGNode *QuickWindowShadowItem::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data)
+{
+    Q_UNUSED(data);
+    auto node = static_cast<QuickWindowShadowNode *>(oldNode);
+    QQuickWindow * const window = this->window();
+    if (!window || !m_window || (width() <= 0) || (height() <= 0)) {
+        delete node;
+        return nullptr;
+    }
+    if (!node) {
+        node = new QuickWindowShadowNode(window);
+    }
+    const QSize size = QSizeF(width(), height()).toSize();
+    const bool normal = isWindowNormal();
+    const QRect contentsRect = QRect(QPoint(0, 0), size).marginsRemoved(normal ? m_shadowMargins : QMargins());
+    node->setBackground(QRectF(contentsRect), m_backgroundColor);
+    QImage tile = {};
+    QList<QPair<QRectF, QRectF>> patches = {};
+    const QColor color = (m_window->isActive() ? m_shadowPainter->activeColor() : m_shadowPainter->inactiveColor());
+    if (normal && (m_shadowPainter->radius() > 0) && (color.alpha() > 0)) {
+        const qreal dpr = window->effectiveDevicePixelRatio();
+        tile = WindowShadowPainterPrivate::shadowTile(m_shadowPainter->radius(),
+            m_shadowPainter->cornerRadius(), color, dpr);
+        if (!tile.isNull()) {
+            patches = WindowShadowPainterPrivate::get(m_shadowPainter)->patches(size, tile.width(), dpr);
+        }
+    }
+    node->setShadow(tile, patches);
+    return node;
+}
+
+void QuickWindowShadowItem::itemChange(const ItemChange change, const ItemChangeData &value)
+{
+    QQuickItem::itemChange(change, value);
+    if (change == ItemDevicePixelRatioHasChanged) {
+        // The frame extents are in device pixels.
+        updateFrameExtents();
+        update();
+    }
+}
+
+bool QuickWindowShadowItem::isWindowNormal() const
+{
+    // Maximized and full screen windows don't show their shadow.
+    return (m_window && (m_window->windowState() == Qt::WindowNoState));
+}
+
+QMargins QuickWindowShadowItem::reservedMargins() const
+{
+    return (isWindowNormal() ? m_shadowMargins : QMargins());
+}
+
+void QuickWindowShadowItem::updateShadowMargins()
+{
+    if (!m_window) {
+        return;
+    }
+    const QMargins margins = m_shadowPainter->margins();
+    if (m_shadowMargins == margins) {
+        return;
+    }
+    const QMargins delta = (margins - m_shadowMargins);
+    m_shadowMargins = margins;
+    // The shadow is part of the window, grow the window so that its visible part keeps its size.
+    if (isWindowNormal()) {
+        m_window->resize(m_window->width() + delta.left() + delta.right(),
+            m_window->height() + delta.top() + delta.bottom());
+    }
+    updateGeometry();
+    updateFrameExtents();
+}
+
+void QuickWindowShadowItem::updateGeometry()
+{
+    if (!m_window) {
+        return;
+    }
+    const QMargins margins = reservedMargins();
+    m_transform->setOffset(QPoint(margins.left(), margins.top()));
+    // Only has an effect when the margins themselves change, the resize events
+    // take care of the content item size otherwise, see "eventFilter()".
+    m_window->contentItem()->setSize(QSizeF(m_window->width() - margins.left() - margins.right(),
+        m_window->height() - margins.top() - margins.bottom()));
+    setPosition(QPointF(-margins.left(), -margins.top()));
+    setSize(QSizeF(m_window->size()));
+    update();
+}
+
+void QuickWindowShadowItem::updateFrameExtents()
+{
+    // Don't create the native window just for this, we'll be called again once it's shown.
+    if (!m_window || !m_window->isVisible()) {
+        return;
+    }
+    m_shadowPainter->updateFrameExtents(m_window);
+}
+#endif // (defined(Q_OS_LINUX) && !defined(FRAMELESSHELPER_QUICK_NO_PRIVATE))
+
 FramelessQuickHelperPrivate::FramelessQuickHelperPrivate(FramelessQuickHelper *q) : QObject(q)
 {
     Q_ASSERT(q);
@@ -186,6 +523,25 @@ void FramelessQuickHelperPrivate::attach()
     }
     g_quickHelper()->mutex.unlock();
 
+#if (defined(Q_OS_LINUX) && !defined(FRAMELESSHELPER_QUICK_NO_PRIVATE))
+    // Without a compositor the translucent area would be black instead of see-through.
+    if (FramelessConfig::instance()->isSet(Option::EnableWindowShadowOnLinux)
+        && Utils::isCompositingManagerRunning()) {
+        // The alpha channel can't be added once the native window has been created.
+        if (!window->handle()) {
+            QSurfaceFormat format = window->requestedFormat();
+            format.setAlphaBufferSize(8);
+            window->setFormat(format);
+        }
+        if (window->format().hasAlpha()) {
+            // Owned by the content item of the window.
+            new QuickWindowShadowItem(window);
+        } else {
+            WARNING << "The native window has been created without an alpha channel, it won't have a shadow.";
+        }
+    }
+#endif // (defined(Q_OS_LINUX) && !defined(FRAMELESSHELPER_QUICK_NO_PRIVATE))
+
     window->installEventFilter(this);
 
     SystemParameters params = {};
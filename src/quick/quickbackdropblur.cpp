@@ -0,0 +1,568 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "quickbackdropblur.h"
+#include "quickbackdropblur_p.h"
+#include <backdropblur.h>
+#include <QtGui/qpainter.h>
+#include <QtQuick/qquickitemgrabresult.h>
+#include <QtQuick/qquickwindow.h>
+#include <QtQuick/qsgsimpletexturenode.h>
+#ifndef FRAMELESSHELPER_QUICK_NO_PRIVATE
+#  include <QtQuick/private/qquickitem_p.h>
+#  include <QtQuick/private/qquickwindow_p.h>
+#  include <QtQuick/private/qsgadaptationlayer_p.h>
+#  include <QtQuick/private/qsgcontext_p.h>
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+Q_LOGGING_CATEGORY(lcQuickBackdropBlur, "wangwenx190.framelesshelper.quick.quickbackdropblur")
+
+#ifdef FRAMELESSHELPER_QUICK_NO_DEBUG_OUTPUT
+#  define INFO QT_NO_QDEBUG_MACRO()
+#  define DEBUG QT_NO_QDEBUG_MACRO()
+#  define WARNING QT_NO_QDEBUG_MACRO()
+#  define CRITICAL QT_NO_QDEBUG_MACRO()
+#else
+#  define INFO qCInfo(lcQuickBackdropBlur)
+#  define DEBUG qCDebug(lcQuickBackdropBlur)
+#  define WARNING qCWarning(lcQuickBackdropBlur)
+#  define CRITICAL qCCritical(lcQuickBackdropBlur)
+#endif
+
+using namespace Global;
+
+/*
+    Shows the blurred backdrop. It also owns the layer the source is rendered
+    into (see "QuickBackdropBlurPrivate::readBackSource()"), because scene
+    graph resources have to be released on the render thread, like the node.
+ */
+class BackdropBlurNode : public QSGNode
+{
+public:
+    explicit BackdropBlurNode() = default;
+    ~BackdropBlurNode() override;
+
+    void setImage(QQuickWindow *window, const QImage &image, const bool changed);
+    void setRect(const QRectF &rect);
+
+#ifndef FRAMELESSHELPER_QUICK_NO_PRIVATE
+    Q_NODISCARD QSGLayer *layer() const;
+    void setLayer(QSGLayer *layer);
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+
+private:
+    // Only there while there's an image to show.
+    QSGSimpleTextureNode *m_textureNode = nullptr;
+#ifndef FRAMELESSHELPER_QUICK_NO_PRIVATE
+    QSGLayer *m_layer = nullptr;
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+};
+
+BackdropBlurNode::~BackdropBlurNode()
+{
+#ifndef FRAMELESSHELPER_QUICK_NO_PRIVATE
+    delete m_layer;
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+}
+
+void BackdropBlurNode::setImage(QQuickWindow *window, const QImage &image, const bool changed)
+{
+    if (image.isNull()) {
+        if (m_textureNode) {
+            removeChildNode(m_textureNode);
+            delete m_textureNode;
+            m_textureNode = nullptr;
+        }
+        return;
+    }
+    if (!m_textureNode) {
+        m_textureNode = new QSGSimpleTextureNode;
+        m_textureNode->setOwnsTexture(true);
+        m_textureNode->setFiltering(QSGTexture::Linear);
+        appendChildNode(m_textureNode);
+    }
+    if (changed || !m_textureNode->texture()) {
+        m_textureNode->setTexture(window->createTextureFromImage(image));
+    }
+}
+
+void BackdropBlurNode::setRect(const QRectF &rect)
+{
+    if (m_textureNode) {
+        m_textureNode->setRect(rect);
+    }
+}
+
+#ifndef FRAMELESSHELPER_QUICK_NO_PRIVATE
+QSGLayer *BackdropBlurNode::layer() const
+{
+    return m_layer;
+}
+
+void BackdropBlurNode::setLayer(QSGLayer *layer)
+{
+    Q_ASSERT(!m_layer);
+    m_layer = layer;
+}
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+
+QuickBackdropBlurPrivate::QuickBackdropBlurPrivate(QuickBackdropBlur *q) : QObject(q)
+{
+    Q_ASSERT(q);
+    if (!q) {
+        return;
+    }
+    q_ptr = q;
+    initialize();
+}
+
+QuickBackdropBlurPrivate::~QuickBackdropBlurPrivate()
+{
+#ifndef FRAMELESSHELPER_QUICK_NO_PRIVATE
+    if (m_source) {
+        QQuickItemPrivate::get(m_source)->derefFromEffectItem(false);
+    }
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+}
+
+QuickBackdropBlurPrivate *QuickBackdropBlurPrivate::get(QuickBackdropBlur *q)
+{
+    Q_ASSERT(q);
+    if (!q) {
+        return nullptr;
+    }
+    return q->d_func();
+}
+
+const QuickBackdropBlurPrivate *QuickBackdropBlurPrivate::get(const QuickBackdropBlur *q)
+{
+    Q_ASSERT(q);
+    if (!q) {
+        return nullptr;
+    }
+    return q->d_func();
+}
+
+void QuickBackdropBlurPrivate::initialize()
+{
+    Q_Q(QuickBackdropBlur);
+    q->setFlag(QuickBackdropBlur::ItemHasContents);
+    m_backdropBlur = new BackdropBlur(this);
+    connect(m_backdropBlur, &BackdropBlur::radiusChanged, q, &QuickBackdropBlur::blurRadiusChanged);
+    connect(m_backdropBlur, &BackdropBlur::tintColorChanged, q, &QuickBackdropBlur::tintColorChanged);
+    connect(m_backdropBlur, &BackdropBlur::shouldRepaint, this, [this](){
+        // A new radius needs a new snapshot, a new tint color doesn't.
+        if (m_backdropBlur->hasSource()) {
+            updateImage();
+        } else {
+            scheduleUpdate();
+        }
+    });
+    connect(q, &QuickBackdropBlur::xChanged, this, &QuickBackdropBlurPrivate::scheduleUpdate);
+    connect(q, &QuickBackdropBlur::yChanged, this, &QuickBackdropBlurPrivate::scheduleUpdate);
+    connect(q, &QuickBackdropBlur::widthChanged, this, &QuickBackdropBlurPrivate::scheduleUpdate);
+    connect(q, &QuickBackdropBlur::heightChanged, this, &QuickBackdropBlurPrivate::scheduleUpdate);
+}
+
+void QuickBackdropBlurPrivate::rebindWindow()
+{
+#ifdef FRAMELESSHELPER_QUICK_NO_PRIVATE
+    Q_Q(QuickBackdropBlur);
+    if (m_frameSwappedConnection) {
+        disconnect(m_frameSwappedConnection);
+        m_frameSwappedConnection = {};
+    }
+    const QQuickWindow * const window = q->window();
+    if (!window) {
+        return;
+    }
+    // Emitted on the render thread, queued to us.
+    m_frameSwappedConnection = connect(window, &QQuickWindow::frameSwapped,
+        this, &QuickBackdropBlurPrivate::handleFrameSwapped);
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+    scheduleUpdate();
+}
+
+void QuickBackdropBlurPrivate::rebindSource(QQuickItem *source)
+{
+    Q_Q(QuickBackdropBlur);
+    if (m_source) {
+        disconnect(m_source, nullptr, this, nullptr);
+#ifndef FRAMELESSHELPER_QUICK_NO_PRIVATE
+        QQuickItemPrivate::get(m_source)->derefFromEffectItem(false);
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+    }
+    m_source = source;
+    m_backdropBlur->clearSource();
+    m_image = {};
+    m_imageChanged = true;
+    q->update();
+    if (!m_source) {
+        return;
+    }
+#ifndef FRAMELESSHELPER_QUICK_NO_PRIVATE
+    // Gives the source a root node of its own, the layer renders from there,
+    // the same as a ShaderEffectSource which doesn't hide its source.
+    QQuickItemPrivate::get(m_source)->refFromEffectItem(false);
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+    connect(m_source, &QQuickItem::xChanged, this, &QuickBackdropBlurPrivate::scheduleUpdate);
+    connect(m_source, &QQuickItem::yChanged, this, &QuickBackdropBlurPrivate::scheduleUpdate);
+    connect(m_source, &QQuickItem::widthChanged, this, &QuickBackdropBlurPrivate::scheduleUpdate);
+    connect(m_source, &QQuickItem::heightChanged, this, &QuickBackdropBlurPrivate::scheduleUpdate);
+    scheduleUpdate();
+}
+
+// The part of the source the snapshot has to cover, in its coordinates.
+QRect QuickBackdropBlurPrivate::sourceGeometry() const
+{
+    Q_Q(const QuickBackdropBlur);
+    const int margin = m_backdropBlur->margin();
+    return q->mapRectToItem(m_source, QRectF(0, 0, q->width(), q->height()))
+        .toAlignedRect().adjusted(-margin, -margin, margin, margin);
+}
+
+#ifdef FRAMELESSHELPER_QUICK_NO_PRIVATE
+void QuickBackdropBlurPrivate::scheduleUpdate()
+{
+    if (m_grabPending) {
+        m_grabRequested = true;
+        return;
+    }
+    Q_Q(QuickBackdropBlur);
+    QQuickWindow * const window = q->window();
+    if (!m_source || !window || !q->isVisible() || (q->width() <= 0) || (q->height() <= 0)) {
+        return;
+    }
+    const QSizeF sourceSize = {m_source->width(), m_source->height()};
+    if (sourceSize.isEmpty()) {
+        return;
+    }
+    // Without the private Qt Quick API, the whole source is grabbed at once and
+    // only the part of it underneath us is used.
+    const qreal dpr = window->effectiveDevicePixelRatio();
+    m_grabResult = m_source->grabToImage((sourceSize * dpr).toSize());
+    if (!m_grabResult) {
+        return;
+    }
+    m_grabPending = true;
+    m_grabFrameSwapped = false;
+    connect(m_grabResult.data(), &QQuickItemGrabResult::ready, this, [this, dpr](){
+        handleGrabResult(dpr);
+    });
+}
+
+/*
+*  Every grab renders a frame, and checking the source for changes after that
+*  frame would grab it again, forever. With the threaded render loop the frame
+*  is swapped after the grab is ready, with the basic one it's the other way
+*  around, so whichever of the two comes first tells whether the next swap
+*  belongs to the grab. The other frames rendered meanwhile are skipped too,
+*  a running animation renders another one soon anyway.
+*/
+void QuickBackdropBlurPrivate::handleFrameSwapped()
+{
+    if (m_grabPending) {
+        m_grabFrameSwapped = true;
+        return;
+    }
+    if (m_skipNextFrame) {
+        m_skipNextFrame = false;
+        return;
+    }
+    if (m_live) {
+        scheduleUpdate();
+    }
+}
+
+void QuickBackdropBlurPrivate::handleGrabResult(const qreal devicePixelRatio)
+{
+    Q_Q(QuickBackdropBlur);
+    m_grabPending = false;
+    m_skipNextFrame = !m_grabFrameSwapped;
+    const QImage image = (m_grabResult ? m_grabResult->image() : QImage());
+    if (!image.isNull() && m_source && (q->width() > 0) && (q->height() > 0)) {
+        const QRect geometry = sourceGeometry();
+        const QRect deviceRect = {(QPointF(geometry.topLeft()) * devicePixelRatio).toPoint(),
+                                  (QSizeF(geometry.size()) * devicePixelRatio).toSize()};
+        // The parts outside of the source are transparent.
+        QImage snapshot = image.copy(deviceRect);
+        snapshot.setDevicePixelRatio(devicePixelRatio);
+        updateSnapshot(snapshot, geometry);
+    }
+    if (m_grabRequested) {
+        m_grabRequested = false;
+        scheduleUpdate();
+    }
+}
+#else // !FRAMELESSHELPER_QUICK_NO_PRIVATE
+/*
+*  Only the part of the source underneath us is rendered into a layer, the
+*  same as a ShaderEffectSource with a "sourceRect" does, and read back
+*  while the scene graph is synchronized, see "updatePaintNode()". The layer
+*  tells us when anything in the source really changed, no frame is rendered
+*  nor read back just to find out.
+*/
+void QuickBackdropBlurPrivate::scheduleUpdate()
+{
+    Q_Q(QuickBackdropBlur);
+    const QQuickWindow * const window = q->window();
+    if (!m_source || !window || !q->isVisible() || (q->width() <= 0) || (q->height() <= 0)) {
+        return;
+    }
+    if (m_source->window() != window) {
+        WARNING << "The source item must be in the same window as the backdrop blur item.";
+        return;
+    }
+    if ((m_source->width() <= 0) || (m_source->height() <= 0)) {
+        return;
+    }
+    m_layerGeometry = sourceGeometry();
+    m_layerDpr = window->effectiveDevicePixelRatio();
+    m_readbackRequested = true;
+    q->update();
+}
+
+void QuickBackdropBlurPrivate::handleSourceChanged()
+{
+    if (m_live) {
+        scheduleUpdate();
+    }
+}
+
+// Called from "updatePaintNode()", on the render thread while the GUI thread is blocked.
+void QuickBackdropBlurPrivate::readBackSource(BackdropBlurNode *node)
+{
+    Q_ASSERT(node);
+    if (!node) {
+        return;
+    }
+    Q_Q(QuickBackdropBlur);
+    QQuickItemPrivate * const sourcePrivate = QQuickItemPrivate::get(m_source);
+    // The root node of the source is created while the source is synchronized, which may be after us.
+    if (!sourcePrivate->rootNode()) {
+        QMetaObject::invokeMethod(this, [this](){
+            Q_Q(QuickBackdropBlur);
+            q->update();
+        }, Qt::QueuedConnection);
+        return;
+    }
+    m_readbackRequested = false;
+    const QSize textureSize = (QSizeF(m_layerGeometry.size()) * m_layerDpr).toSize();
+    if (textureSize.isEmpty()) {
+        return;
+    }
+    QSGLayer *layer = node->layer();
+    if (!layer) {
+        QSGRenderContext * const context = QQuickWindowPrivate::get(q->window())->context;
+        layer = context->sceneGraphContext()->createLayer(context);
+        // Emitted on the render thread whenever anything in the source changed, queued to us.
+        connect(layer, &QSGLayer::updateRequested, this, &QuickBackdropBlurPrivate::handleSourceChanged, Qt::QueuedConnection);
+        node->setLayer(layer);
+    }
+    layer->setLive(true);
+    layer->setRecursive(false);
+    layer->setItem(sourcePrivate->itemNode());
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+    layer->setRect(QRectF(m_layerGeometry));
+#else // (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    // Upside down, the same as QQuickItemGrabResult does with OpenGL.
+    layer->setRect(QRectF(m_layerGeometry.x(), (m_layerGeometry.y() + m_layerGeometry.height()),
+        m_layerGeometry.width(), -m_layerGeometry.height()));
+#endif // (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+    layer->setSize(textureSize);
+    layer->setDevicePixelRatio(m_layerDpr);
+    // Renders the layer only if the source or the rect changed since the last time.
+    layer->updateTexture();
+    // The parts outside of the source are transparent.
+    QImage image = layer->toImage();
+    if (image.isNull()) {
+        return;
+    }
+    image.setDevicePixelRatio(m_layerDpr);
+    m_readbackImage = image;
+    m_readbackGeometry = m_layerGeometry;
+    // Blurred on the GUI thread, once it runs again.
+    QMetaObject::invokeMethod(this, &QuickBackdropBlurPrivate::handleReadback, Qt::QueuedConnection);
+}
+
+void QuickBackdropBlurPrivate::handleReadback()
+{
+    const QImage snapshot = std::exchange(m_readbackImage, {});
+    if (snapshot.isNull() || !m_source) {
+        return;
+    }
+    updateSnapshot(snapshot, m_readbackGeometry);
+}
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+
+void QuickBackdropBlurPrivate::updateSnapshot(const QImage &snapshot, const QRect &geometry)
+{
+    const qreal devicePixelRatio = snapshot.devicePixelRatio();
+    if (!m_backdropBlur->hasSource() || (geometry != m_sourceGeometry)
+        || !qFuzzyCompare(devicePixelRatio, m_sourceDpr)) {
+        m_backdropBlur->setSource(snapshot);
+        m_sourceGeometry = geometry;
+        m_sourceDpr = devicePixelRatio;
+        updateImage();
+    } else if (m_backdropBlur->updateSource(snapshot, QPoint(0, 0))) {
+        updateImage();
+    }
+}
+
+void QuickBackdropBlurPrivate::updateImage()
+{
+    Q_Q(QuickBackdropBlur);
+    const QSize size = QSizeF(q->width(), q->height()).toSize();
+    if (!m_backdropBlur->hasSource() || size.isEmpty()) {
+        return;
+    }
+    m_image = QImage((QSizeF(size) * m_sourceDpr).toSize(), QImage::Format_ARGB32_Premultiplied);
+    m_image.setDevicePixelRatio(m_sourceDpr);
+    m_image.fill(kDefaultTransparentColor);
+    QPainter painter(&m_image);
+    m_backdropBlur->paint(&painter, QRect(QPoint(0, 0), size));
+    painter.end();
+    m_imageChanged = true;
+    q->update();
+}
+
+QuickBackdropBlur::QuickBackdropBlur(QQuickItem *parent)
+    : QQuickItem(parent), d_ptr(new QuickBackdropBlurPrivate(this))
+{
+}
+
+QuickBackdropBlur::~QuickBackdropBlur() = default;
+
+QQuickItem *QuickBackdropBlur::source() const
+{
+    Q_D(const QuickBackdropBlur);
+    return d->m_source;
+}
+
+void QuickBackdropBlur::setSource(QQuickItem *value)
+{
+    Q_D(QuickBackdropBlur);
+    if (d->m_source == value) {
+        return;
+    }
+    for (QQuickItem *item = this; item; item = item->parentItem()) {
+        if (item == value) {
+            WARNING << "The source item must not contain the backdrop blur item itself.";
+            return;
+        }
+    }
+    d->rebindSource(value);
+    Q_EMIT sourceChanged();
+}
+
+qreal QuickBackdropBlur::blurRadius() const
+{
+    Q_D(const QuickBackdropBlur);
+    return d->m_backdropBlur->radius();
+}
+
+void QuickBackdropBlur::setBlurRadius(const qreal value)
+{
+    Q_D(QuickBackdropBlur);
+    d->m_backdropBlur->setRadius(value);
+}
+
+QColor QuickBackdropBlur::tintColor() const
+{
+    Q_D(const QuickBackdropBlur);
+    return d->m_backdropBlur->tintColor();
+}
+
+void QuickBackdropBlur::setTintColor(const QColor &value)
+{
+    Q_D(QuickBackdropBlur);
+    d->m_backdropBlur->setTintColor(value);
+}
+
+bool QuickBackdropBlur::isLive() const
+{
+    Q_D(const QuickBackdropBlur);
+    return d->m_live;
+}
+
+void QuickBackdropBlur::setLive(const bool value)
+{
+    Q_D(QuickBackdropBlur);
+    if (d->m_live == value) {
+        return;
+    }
+    d->m_live = value;
+    if (d->m_live) {
+        d->scheduleUpdate();
+    }
+    Q_EMIT liveChanged();
+}
+
+void QuickBackdropBlur::scheduleUpdate()
+{
+    Q_D(QuickBackdropBlur);
+    d->scheduleUpdate();
+}
+
+void QuickBackdropBlur::itemChange(const ItemChange change, const ItemChangeData &value)
+{
+    QQuickItem::itemChange(change, value);
+    Q_D(QuickBackdropBlur);
+    switch (change) {
+    case ItemSceneChange:
+        d->rebindWindow();
+        break;
+    case ItemVisibleHasChanged:
+    case ItemDevicePixelRatioHasChanged:
+        d->scheduleUpdate();
+        break;
+    default:
+        break;
+    }
+}
+
+// Called on the render thread while the GUI thread is blocked.
+QSGNode *QuickBackdropBlur::updatePaintNode(QSGNode *old, UpdatePaintNodeData *data)
+{
+    Q_UNUSED(data);
+    Q_D(QuickBackdropBlur);
+    auto node = static_cast<BackdropBlurNode *>(old);
+    if (!node) {
+        node = new BackdropBlurNode;
+    }
+#ifndef FRAMELESSHELPER_QUICK_NO_PRIVATE
+    if (d->m_readbackRequested && d->m_source) {
+        d->readBackSource(node);
+    }
+#endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+    node->setImage(window(), d->m_image, d->m_imageChanged);
+    d->m_imageChanged = false;
+    node->setRect(boundingRect());
+    return node;
+}
+
+FRAMELESSHELPER_END_NAMESPACE
@@ -0,0 +1 @@
+#include "../../include/FramelessHelper/Quick/quickbackdropblur.h"
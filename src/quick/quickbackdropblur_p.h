@@ -0,0 +1 @@
+#include "../../include/FramelessHelper/Quick/private/quickbackdropblur_p.h"
@@ -25,12 +25,16 @@
 #include "quickmicamaterial.h"
 #include "quickmicamaterial_p.h"
 #include <micamaterial.h>
+#include <micamaterial_p.h>
+#include <QtCore/qatomic.h>
 #include <QtCore/qmutex.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qsharedpointer.h>
 #include <QtGui/qscreen.h>
-#include <QtGui/qpainter.h>
 #include <QtGui/qguiapplication.h>
 #include <QtQuick/qquickwindow.h>
 #include <QtQuick/qsgsimpletexturenode.h>
+#include <QtQuick/qsgsimplerectnode.h>
 #ifndef FRAMELESSHELPER_QUICK_NO_PRIVATE
 #  include <QtQuick/private/qquickitem_p.h>
 #endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
@@ -53,12 +57,45 @@ Q_LOGGING_CATEGORY(lcQuickMicaMaterial, "wangwenx190.framelesshelper.quick.quick
 
 using namespace Global;
 
-struct QuickMicaData
+/*
+    The blurred wallpapers are shared by all the Mica items of a window: one texture
+    per wallpaper image (that is per screen and quality), straight from the image the
+    core keeps at a fraction of the screen resolution. The textures belong to the
+    scene graph of the window, and the windows may have render threads of their own.
+ */
+struct SharedWallpaperTextures
 {
     QMutex mutex;
+    QHash<QPair<const QQuickWindow *, qint64>, QWeakPointer<QSGTexture>> textures = {};
 };
 
-Q_GLOBAL_STATIC(QuickMicaData, g_data)
+Q_GLOBAL_STATIC(SharedWallpaperTextures, g_sharedWallpaperTextures)
+
+// Render thread only, the last node which lets go of the texture deletes it there.
+[[nodiscard]] static inline QSharedPointer<QSGTexture> sharedWallpaperTexture(QQuickWindow *window, const QImage &image)
+{
+    Q_ASSERT(window);
+    Q_ASSERT(!image.isNull());
+    if (!window || image.isNull() || g_sharedWallpaperTextures.isDestroyed()) {
+        return {};
+    }
+    const QMutexLocker locker(&g_sharedWallpaperTextures()->mutex);
+    auto &textures = g_sharedWallpaperTextures()->textures;
+    for (auto it = textures.begin(); it != textures.end();) {
+        if (it->isNull()) {
+            it = textures.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    const QPair<const QQuickWindow *, qint64> key = {window, image.cacheKey()};
+    if (const QSharedPointer<QSGTexture> texture = textures.value(key).toStrongRef()) {
+        return texture;
+    }
+    const QSharedPointer<QSGTexture> texture(window->createTextureFromImage(image));
+    textures.insert(key, texture);
+    return texture;
+}
 
 class WallpaperImageNode : public QObject, public QSGTransformNode
 {
@@ -69,7 +106,15 @@ public:
     explicit WallpaperImageNode(QuickMicaMaterial *item);
     ~WallpaperImageNode() override;
 
-public Q_SLOTS:
+    // Can be called from any thread, the textures are updated on the next sync.
+    void requestWallpaperImageCacheRegeneration();
+
+    Q_NODISCARD MicaMaterial *micaMaterial() const;
+
+    // Called from "updatePaintNode()", while the GUI thread is blocked.
+    void synchronize();
+
+private:
     void maybeUpdateWallpaperImageClipRect();
     void maybeGenerateWallpaperImageCache(const bool force = false);
 
@@ -77,11 +122,18 @@ private:
     void initialize();
 
 private:
-    QSGTexture *m_texture = nullptr;
     QPointer<QuickMicaMaterial> m_item = nullptr;
+    // From bottom to top: the fallback color, the blurred wallpaper and the tint & noise.
+    QSGSimpleRectNode *m_backgroundNode = nullptr;
     QSGSimpleTextureNode *m_node = nullptr;
-    QPixmap m_pixmapCache = {};
+    QSGSimpleTextureNode *m_materialNode = nullptr;
+    QSharedPointer<QSGTexture> m_texture = {};
+    qint64 m_imageCacheKey = 0;
+    qint64 m_materialCacheKey = 0;
+    QRect m_screenGeometry = {};
+    qreal m_imageDevicePixelRatio = 1.0;
     MicaMaterial *m_micaMaterial = nullptr;
+    QAtomicInt m_regenerationRequested = 0;
 };
 
 WallpaperImageNode::WallpaperImageNode(QuickMicaMaterial *item)
@@ -94,64 +146,110 @@ WallpaperImageNode::WallpaperImageNode(QuickMicaMaterial *item)
     initialize();
 }
 
-WallpaperImageNode::~WallpaperImageNode() = default;
+WallpaperImageNode::~WallpaperImageNode()
+{
+    // Not in the tree while they have no texture, see "maybeGenerateWallpaperImageCache()".
+    if (m_node && !m_node->parent()) {
+        delete m_node;
+        m_node = nullptr;
+    }
+    if (m_materialNode && !m_materialNode->parent()) {
+        delete m_materialNode;
+        m_materialNode = nullptr;
+    }
+}
 
 void WallpaperImageNode::initialize()
 {
-    g_data()->mutex.lock();
-
-    QQuickWindow * const window = m_item->window();
     m_micaMaterial = new MicaMaterial(this);
 
+    m_backgroundNode = new QSGSimpleRectNode;
+    appendChildNode(m_backgroundNode);
+
     m_node = new QSGSimpleTextureNode;
     m_node->setFiltering(QSGTexture::Linear);
 
-    g_data()->mutex.unlock();
+    m_materialNode = new QSGSimpleTextureNode;
+    m_materialNode->setFiltering(QSGTexture::Linear);
+    m_materialNode->setOwnsTexture(true);
 
-    maybeGenerateWallpaperImageCache();
-    maybeUpdateWallpaperImageClipRect();
+    // The item is told when the wallpaper is ready and schedules a sync.
+    QuickMicaMaterialPrivate::get(m_item)->appendNode(this);
+}
 
-    appendChildNode(m_node);
+void WallpaperImageNode::requestWallpaperImageCacheRegeneration()
+{
+    m_regenerationRequested.storeRelease(1);
+}
 
-    connect(m_micaMaterial, &MicaMaterial::shouldRedraw, this, [this](){
-        maybeGenerateWallpaperImageCache(true);
-    });
-    connect(window, &QQuickWindow::beforeRendering, this,
-        &WallpaperImageNode::maybeUpdateWallpaperImageClipRect, Qt::DirectConnection);
+MicaMaterial *WallpaperImageNode::micaMaterial() const
+{
+    return m_micaMaterial;
+}
 
-    QuickMicaMaterialPrivate::get(m_item)->appendNode(this);
+void WallpaperImageNode::synchronize()
+{
+    // Keep asking until the wallpaper is there, it's just a lookup.
+    maybeGenerateWallpaperImageCache((m_regenerationRequested.fetchAndStoreAcquire(0) != 0) || !m_texture);
+    maybeUpdateWallpaperImageClipRect();
 }
 
+// Everything below runs on the render thread only, in the sync phase, so no locking is needed.
 void WallpaperImageNode::maybeGenerateWallpaperImageCache(const bool force)
 {
-    const QMutexLocker locker(&g_data()->mutex);
-    if (!m_pixmapCache.isNull() && !force) {
+    if (!force) {
         return;
     }
-    const QSize desktopSize = QGuiApplication::primaryScreen()->virtualSize();
-    static constexpr const QPoint originPoint = {0, 0};
-    m_pixmapCache = QPixmap(desktopSize);
-    m_pixmapCache.fill(kDefaultTransparentColor);
-    QPainter painter(&m_pixmapCache);
-    m_micaMaterial->paint(&painter, desktopSize, originPoint);
-    if (m_texture) {
-        delete m_texture;
-        m_texture = nullptr;
+    QQuickWindow * const window = m_item->window();
+    MicaMaterialPrivate * const material = MicaMaterialPrivate::get(m_micaMaterial);
+    m_backgroundNode->setColor(material->backgroundColor());
+    // Only the screen our window is on is needed.
+    if (const QScreen * const screen = window->screen()) {
+        const QImage image = material->screenWallpaper(screen, &m_screenGeometry, &m_imageDevicePixelRatio);
+        const qint64 cacheKey = (image.isNull() ? 0 : image.cacheKey());
+        if (cacheKey != m_imageCacheKey) {
+            m_imageCacheKey = cacheKey;
+            m_texture = (image.isNull() ? QSharedPointer<QSGTexture>{} : sharedWallpaperTexture(window, image));
+            if (m_texture) {
+                m_node->setTexture(m_texture.data());
+                if (!m_node->parent()) {
+                    insertChildNodeAfter(m_node, m_backgroundNode);
+                }
+            } else if (m_node->parent()) {
+                // A texture node can't be without a texture, just show the background.
+                removeChildNode(m_node);
+            }
+        }
+    }
+    const QImage materialImage = material->materialTexture();
+    if (!materialImage.isNull() && (materialImage.cacheKey() != m_materialCacheKey)) {
+        m_materialCacheKey = materialImage.cacheKey();
+        QSGTexture * const texture = window->createTextureFromImage(materialImage);
+        texture->setHorizontalWrapMode(QSGTexture::Repeat);
+        texture->setVerticalWrapMode(QSGTexture::Repeat);
+        m_materialNode->setTexture(texture); // Deletes the previous one.
+        if (!m_materialNode->parent()) {
+            appendChildNode(m_materialNode);
+        }
     }
-    m_texture = m_item->window()->createTextureFromImage(m_pixmapCache.toImage());
-    m_node->setTexture(m_texture);
 }
 
 void WallpaperImageNode::maybeUpdateWallpaperImageClipRect()
 {
-    const QMutexLocker locker(&g_data()->mutex);
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
     const QSizeF itemSize = m_item->size();
 #else
     const QSizeF itemSize = {m_item->width(), m_item->height()};
 #endif
-    m_node->setRect(QRectF(QPointF(0.0, 0.0), itemSize));
-    m_node->setSourceRect(QRectF(m_item->mapToGlobal(QPointF(0.0, 0.0)), itemSize));
+    const QRectF rect = {QPointF(0.0, 0.0), itemSize};
+    m_backgroundNode->setRect(rect);
+    m_node->setRect(rect);
+    // The source rect is in texture pixels, relative to the screen the wallpaper was generated for.
+    const QPointF itemPos = (m_item->mapToGlobal(QPointF(0.0, 0.0)) - QPointF(m_screenGeometry.topLeft()));
+    m_node->setSourceRect(QRectF(itemPos * m_imageDevicePixelRatio, itemSize * m_imageDevicePixelRatio));
+    // One pixel of the tile is one logical pixel, repeated all over the item.
+    m_materialNode->setRect(rect);
+    m_materialNode->setSourceRect(rect);
 }
 
 QuickMicaMaterialPrivate::QuickMicaMaterialPrivate(QuickMicaMaterial *q) : QObject(q)
@@ -191,6 +289,11 @@ void QuickMicaMaterialPrivate::initialize()
     q->setSmooth(true);
     q->setAntialiasing(true);
     q->setClip(true);
+    // The texture only changes in "updatePaintNode()", schedule one whenever the visible part may move.
+    connect(q, &QuickMicaMaterial::xChanged, q, [q](){ q->update(); });
+    connect(q, &QuickMicaMaterial::yChanged, q, [q](){ q->update(); });
+    connect(q, &QuickMicaMaterial::widthChanged, q, [q](){ q->update(); });
+    connect(q, &QuickMicaMaterial::heightChanged, q, [q](){ q->update(); });
 }
 
 void QuickMicaMaterialPrivate::rebindWindow()
@@ -215,8 +318,16 @@ void QuickMicaMaterialPrivate::rebindWindow()
         disconnect(m_rootWindowYChangedConnection);
         m_rootWindowYChangedConnection = {};
     }
+    if (m_rootWindowScreenChangedConnection) {
+        disconnect(m_rootWindowScreenChangedConnection);
+        m_rootWindowScreenChangedConnection = {};
+    }
     m_rootWindowXChangedConnection = connect(window, &QQuickWindow::xChanged, q, [q](){ q->update(); });
     m_rootWindowYChangedConnection = connect(window, &QQuickWindow::yChanged, q, [q](){ q->update(); });
+    m_rootWindowScreenChangedConnection = connect(window, &QQuickWindow::screenChanged, q, [this, q](){
+        forceRegenerateWallpaperImageCache();
+        q->update();
+    });
 }
 
 void QuickMicaMaterialPrivate::forceRegenerateWallpaperImageCache()
@@ -226,7 +337,7 @@ void QuickMicaMaterialPrivate::forceRegenerateWallpaperImageCache()
     }
     for (auto &&node : std::as_const(m_nodes)) {
         if (node) {
-            node->maybeGenerateWallpaperImageCache(true);
+            node->requestWallpaperImageCacheRegeneration();
         }
     }
 }
@@ -241,6 +352,39 @@ void QuickMicaMaterialPrivate::appendNode(WallpaperImageNode *node)
         return;
     }
     m_nodes.append(node);
+    // The blurred wallpaper is generated in the background, nothing would repaint us once
+    // it's ready. We live on the GUI thread, so that's where the signal is delivered.
+    connect(node->micaMaterial(), &MicaMaterial::shouldRedraw, this, [this](){
+        Q_Q(QuickMicaMaterial);
+        forceRegenerateWallpaperImageCache();
+        q->update();
+    }, Qt::QueuedConnection);
+}
+
+// Called from "updatePaintNode()", that is on the render thread while the GUI thread is blocked.
+void QuickMicaMaterialPrivate::applyMaterialSettings(MicaMaterial *material) const
+{
+    Q_ASSERT(material);
+    if (!material) {
+        return;
+    }
+    material->setNoiseEnabled(m_noiseEnabled);
+    material->setQuality(FRAMELESSHELPER_ENUM_QUICK_TO_CORE(MicaMaterialQuality, m_quality));
+    if (m_blurRadius > 0) {
+        material->setBlurRadius(m_blurRadius);
+    } else {
+        material->resetBlurRadius();
+    }
+    if (m_downsampleFactor > 0) {
+        material->setDownsampleFactor(m_downsampleFactor);
+    } else {
+        material->resetDownsampleFactor();
+    }
+    if (m_blurPasses > 0) {
+        material->setBlurPasses(m_blurPasses);
+    } else {
+        material->resetBlurPasses();
+    }
 }
 
 QuickMicaMaterial::QuickMicaMaterial(QQuickItem *parent)
@@ -250,6 +394,110 @@ QuickMicaMaterial::QuickMicaMaterial(QQuickItem *parent)
 
 QuickMicaMaterial::~QuickMicaMaterial() = default;
 
+bool QuickMicaMaterial::isNoiseEnabled() const
+{
+    Q_D(const QuickMicaMaterial);
+    return d->m_noiseEnabled;
+}
+
+void QuickMicaMaterial::setNoiseEnabled(const bool value)
+{
+    Q_D(QuickMicaMaterial);
+    if (d->m_noiseEnabled == value) {
+        return;
+    }
+    d->m_noiseEnabled = value;
+    update();
+    Q_EMIT noiseEnabledChanged();
+}
+
+QuickGlobal::MicaMaterialQuality QuickMicaMaterial::quality() const
+{
+    Q_D(const QuickMicaMaterial);
+    return d->m_quality;
+}
+
+void QuickMicaMaterial::setQuality(const QuickGlobal::MicaMaterialQuality value)
+{
+    Q_D(QuickMicaMaterial);
+    if (d->m_quality == value) {
+        return;
+    }
+    d->m_quality = value;
+    update();
+    Q_EMIT qualityChanged();
+}
+
+qreal QuickMicaMaterial::blurRadius() const
+{
+    Q_D(const QuickMicaMaterial);
+    return d->m_blurRadius;
+}
+
+void QuickMicaMaterial::setBlurRadius(const qreal value)
+{
+    // The core setter rejects anything out of range, so don't hand it over as is.
+    const qreal bounded = ((value > 0.0) ? qBound(kMinimumMicaMaterialBlurRadius, value, kMaximumMicaMaterialBlurRadius) : 0.0);
+    Q_D(QuickMicaMaterial);
+    if (qFuzzyCompare(d->m_blurRadius, bounded)) {
+        return;
+    }
+    d->m_blurRadius = bounded;
+    update();
+    Q_EMIT blurRadiusChanged();
+}
+
+void QuickMicaMaterial::resetBlurRadius()
+{
+    setBlurRadius(0.0);
+}
+
+int QuickMicaMaterial::downsampleFactor() const
+{
+    Q_D(const QuickMicaMaterial);
+    return d->m_downsampleFactor;
+}
+
+void QuickMicaMaterial::setDownsampleFactor(const int value)
+{
+    const int bounded = ((value > 0) ? qBound(kMinimumMicaMaterialDownsampleFactor, value, kMaximumMicaMaterialDownsampleFactor) : 0);
+    Q_D(QuickMicaMaterial);
+    if (d->m_downsampleFactor == bounded) {
+        return;
+    }
+    d->m_downsampleFactor = bounded;
+    update();
+    Q_EMIT downsampleFactorChanged();
+}
+
+void QuickMicaMaterial::resetDownsampleFactor()
+{
+    setDownsampleFactor(0);
+}
+
+int QuickMicaMaterial::blurPasses() const
+{
+    Q_D(const QuickMicaMaterial);
+    return d->m_blurPasses;
+}
+
+void QuickMicaMaterial::setBlurPasses(const int value)
+{
+    const int bounded = ((value > 0) ? qBound(kMinimumMicaMaterialBlurPasses, value, kMaximumMicaMaterialBlurPasses) : 0);
+    Q_D(QuickMicaMaterial);
+    if (d->m_blurPasses == bounded) {
+        return;
+    }
+    d->m_blurPasses = bounded;
+    update();
+    Q_EMIT blurPassesChanged();
+}
+
+void QuickMicaMaterial::resetBlurPasses()
+{
+    setBlurPasses(0);
+}
+
 void QuickMicaMaterial::itemChange(const ItemChange change, const ItemChangeData &value)
 {
     QQuickItem::itemChange(change, value);
@@ -276,6 +524,9 @@ QSGNode *QuickMicaMaterial::updatePaintNode(QSGNode *old, UpdatePaintNodeData *d
     if (!node) {
         node = new WallpaperImageNode(this);
     }
+    Q_D(const QuickMicaMaterial);
+    d->applyMaterialSettings(node->micaMaterial());
+    node->synchronize();
     return node;
 }
 
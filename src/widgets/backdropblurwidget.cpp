@@ -0,0 +1,345 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "backdropblurwidget.h"
+#include "backdropblurwidget_p.h"
+#include <QtCore/qcoreevent.h>
+#include <QtGui/qevent.h>
+#include <QtGui/qpainter.h>
+#include <backdropblur.h>
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+Q_LOGGING_CATEGORY(lcBackdropBlurWidget, "wangwenx190.framelesshelper.widgets.backdropblurwidget")
+
+#ifdef FRAMELESSHELPER_WIDGETS_NO_DEBUG_OUTPUT
+#  define INFO QT_NO_QDEBUG_MACRO()
+#  define DEBUG QT_NO_QDEBUG_MACRO()
+#  define WARNING QT_NO_QDEBUG_MACRO()
+#  define CRITICAL QT_NO_QDEBUG_MACRO()
+#else
+#  define INFO qCInfo(lcBackdropBlurWidget)
+#  define DEBUG qCDebug(lcBackdropBlurWidget)
+#  define WARNING qCWarning(lcBackdropBlurWidget)
+#  define CRITICAL qCCritical(lcBackdropBlurWidget)
+#endif
+
+using namespace Global;
+
+// Rendering the content below the overlay has a fixed cost per call, so a lot
+// of small damaged rectangles are grabbed as the rectangle around them.
+static constexpr const int kMaximumDamagedRectCount = 8;
+
+BackdropBlurWidgetPrivate::BackdropBlurWidgetPrivate(BackdropBlurWidget *q) : QObject(q)
+{
+    Q_ASSERT(q);
+    if (!q) {
+        return;
+    }
+    q_ptr = q;
+    initialize();
+}
+
+BackdropBlurWidgetPrivate::~BackdropBlurWidgetPrivate() = default;
+
+BackdropBlurWidgetPrivate *BackdropBlurWidgetPrivate::get(BackdropBlurWidget *pub)
+{
+    Q_ASSERT(pub);
+    if (!pub) {
+        return nullptr;
+    }
+    return pub->d_func();
+}
+
+const BackdropBlurWidgetPrivate *BackdropBlurWidgetPrivate::get(const BackdropBlurWidget *pub)
+{
+    Q_ASSERT(pub);
+    if (!pub) {
+        return nullptr;
+    }
+    return pub->d_func();
+}
+
+void BackdropBlurWidgetPrivate::initialize()
+{
+    Q_Q(BackdropBlurWidget);
+    m_backdropBlur = new BackdropBlur(this);
+    connect(m_backdropBlur, &BackdropBlur::radiusChanged, q, &BackdropBlurWidget::blurRadiusChanged);
+    connect(m_backdropBlur, &BackdropBlur::tintColorChanged, q, &BackdropBlurWidget::tintColorChanged);
+    connect(m_backdropBlur, &BackdropBlur::shouldRepaint, this, [this](){ requestRepaint(); });
+}
+
+BackdropBlur *BackdropBlurWidgetPrivate::backdropBlur() const
+{
+    return m_backdropBlur;
+}
+
+void BackdropBlurWidgetPrivate::watchWidget(QWidget *widget)
+{
+    Q_ASSERT(widget);
+    if (!widget) {
+        return;
+    }
+    Q_Q(BackdropBlurWidget);
+    // Our own children are painted on top of the backdrop, not behind it.
+    if ((widget == q) || q->isAncestorOf(widget)) {
+        return;
+    }
+    widget->installEventFilter(this);
+    const QList<QWidget *> children = widget->findChildren<QWidget *>(QString(), Qt::FindDirectChildrenOnly);
+    for (auto &&child : std::as_const(children)) {
+        watchWidget(child);
+    }
+}
+
+void BackdropBlurWidgetPrivate::unwatchWidget(QWidget *widget)
+{
+    Q_ASSERT(widget);
+    if (!widget) {
+        return;
+    }
+    widget->removeEventFilter(this);
+    const QList<QWidget *> children = widget->findChildren<QWidget *>();
+    for (auto &&child : std::as_const(children)) {
+        child->removeEventFilter(this);
+    }
+}
+
+bool BackdropBlurWidgetPrivate::eventFilter(QObject *object, QEvent *event)
+{
+    Q_ASSERT(object);
+    Q_ASSERT(event);
+    if (!object || !event) {
+        return false;
+    }
+    if (!object->isWidgetType()) {
+        return QObject::eventFilter(object, event);
+    }
+    const auto widget = qobject_cast<QWidget *>(object);
+    switch (event->type()) {
+    case QEvent::ChildAdded: {
+        QObject * const child = static_cast<QChildEvent *>(event)->child();
+        if (child && child->isWidgetType()) {
+            watchWidget(static_cast<QWidget *>(child));
+        }
+    } break;
+    case QEvent::Paint:
+        // Taking the snapshot paints the content below us once more.
+        if (!m_grabbing) {
+            addDamagedRegion(widget, static_cast<QPaintEvent *>(event)->region());
+        }
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(object, event);
+}
+
+void BackdropBlurWidgetPrivate::addDamagedRegion(QWidget *widget, const QRegion &region)
+{
+    Q_ASSERT(widget);
+    if (!widget) {
+        return;
+    }
+    Q_Q(BackdropBlurWidget);
+    QWidget * const parent = q->parentWidget();
+    if (!parent || (parent != m_watchedParent)) {
+        return;
+    }
+    if ((widget != parent) && (widget->isWindow() || !parent->isAncestorOf(widget))) {
+        return;
+    }
+    if (!q->isVisible()) {
+        // Nobody keeps track of the content while we are hidden, start over once we are shown again.
+        m_backdropBlur->clearSource();
+        return;
+    }
+    const QRect geometry = sourceGeometry();
+    const QRegion damagedRegion = (region.translated(widget->mapTo(parent, QPoint(0, 0))) & geometry);
+    if (damagedRegion.isEmpty()) {
+        return;
+    }
+    // We are not opaque, so repainting us repaints whatever is underneath us as well,
+    // that's no change of the content. Anything beyond it may be one, take all of it then.
+    if ((damagedRegion - m_ownUpdateRegion).isEmpty()) {
+        return;
+    }
+    m_damagedRegion += damagedRegion;
+    // Qt only repaints us for changes right below us, but the changes around us
+    // get blurred into our edges as well. Our own repaints never cause any of
+    // these, so this can't end up in a repaint loop.
+    const QRegion outsideRegion = (damagedRegion - q->geometry());
+    if (outsideRegion.isEmpty()) {
+        return;
+    }
+    const int margin = m_backdropBlur->margin();
+    const QRect affectedRect = (outsideRegion.boundingRect().adjusted(-margin, -margin, margin, margin) & q->geometry());
+    if (!affectedRect.isEmpty()) {
+        requestRepaint(affectedRect.translated(-q->pos()));
+    }
+}
+
+void BackdropBlurWidgetPrivate::requestRepaint(const QRect &rect)
+{
+    Q_Q(BackdropBlurWidget);
+    const QRect updateRect = (rect.isEmpty() ? q->rect() : rect);
+    m_ownUpdateRegion += updateRect.translated(q->pos());
+    q->update(updateRect);
+}
+
+QRect BackdropBlurWidgetPrivate::sourceGeometry() const
+{
+    Q_Q(const BackdropBlurWidget);
+    const int margin = m_backdropBlur->margin();
+    return q->geometry().adjusted(-margin, -margin, margin, margin);
+}
+
+QImage BackdropBlurWidgetPrivate::grabBackdrop(const QRect &rect)
+{
+    Q_Q(BackdropBlurWidget);
+    QWidget * const parent = q->parentWidget();
+    Q_ASSERT(parent);
+    if (!parent || rect.isEmpty()) {
+        return {};
+    }
+    const qreal dpr = q->devicePixelRatioF();
+    QImage image((QSizeF(rect.size()) * dpr).toSize(), QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(dpr);
+    // Whatever is outside of the parent widget fades into our edges as the window color.
+    image.fill(parent->palette().color(QPalette::Window));
+    QPainter painter(&image);
+    m_grabbing = true;
+    // Only the parent itself and the siblings stacked below us are behind us.
+    const QRegion parentRegion = (QRegion(rect) & parent->rect());
+    if (!parentRegion.isEmpty()) {
+        parent->render(&painter, (parentRegion.boundingRect().topLeft() - rect.topLeft()),
+            parentRegion, QWidget::DrawWindowBackground);
+    }
+    const QObjectList siblings = parent->children();
+    for (auto &&object : std::as_const(siblings)) {
+        if (object == q) {
+            break;
+        }
+        if (!object->isWidgetType()) {
+            continue;
+        }
+        const auto sibling = static_cast<QWidget *>(object);
+        if (sibling->isWindow() || !sibling->isVisible()) {
+            continue;
+        }
+        const QRegion siblingRegion = (QRegion(rect.translated(-sibling->pos())) & sibling->rect());
+        if (siblingRegion.isEmpty()) {
+            continue;
+        }
+        sibling->render(&painter, (sibling->pos() + siblingRegion.boundingRect().topLeft() - rect.topLeft()),
+            siblingRegion, QWidget::DrawChildren);
+    }
+    m_grabbing = false;
+    painter.end();
+    return image;
+}
+
+void BackdropBlurWidgetPrivate::paintBackdrop(QPaintEvent *event)
+{
+    Q_ASSERT(event);
+    if (!event) {
+        return;
+    }
+    Q_Q(BackdropBlurWidget);
+    if (QWidget * const parent = q->parentWidget()) {
+        if (parent != m_watchedParent) {
+            if (m_watchedParent) {
+                unwatchWidget(m_watchedParent);
+            }
+            m_watchedParent = parent;
+            watchWidget(parent);
+            m_backdropBlur->clearSource();
+        }
+        const QRect geometry = sourceGeometry();
+        const qreal dpr = q->devicePixelRatioF();
+        if (!m_backdropBlur->hasSource() || (geometry != m_sourceGeometry) || !qFuzzyCompare(dpr, m_sourceDpr)) {
+            m_backdropBlur->setSource(grabBackdrop(geometry));
+            m_sourceGeometry = geometry;
+            m_sourceDpr = dpr;
+        } else if (!m_damagedRegion.isEmpty()) {
+            QRegion damagedRegion = (m_damagedRegion & geometry);
+            if (damagedRegion.rectCount() > kMaximumDamagedRectCount) {
+                damagedRegion = damagedRegion.boundingRect();
+            }
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
+            const QRegion &rects = damagedRegion;
+#else
+            const QVector<QRect> rects = damagedRegion.rects();
+#endif
+            for (auto &&rect : rects) {
+                m_backdropBlur->updateSource(grabBackdrop(rect), (rect.topLeft() - geometry.topLeft()));
+            }
+        }
+        m_damagedRegion = {};
+    }
+    // Whatever has been repainted underneath us for our own sake has been painted by now.
+    m_ownUpdateRegion = {};
+    QPainter painter(q);
+    m_backdropBlur->paint(&painter, q->rect());
+}
+
+BackdropBlurWidget::BackdropBlurWidget(QWidget *parent)
+    : QWidget(parent), d_ptr(new BackdropBlurWidgetPrivate(this))
+{
+}
+
+BackdropBlurWidget::~BackdropBlurWidget() = default;
+
+qreal BackdropBlurWidget::blurRadius() const
+{
+    Q_D(const BackdropBlurWidget);
+    return d->backdropBlur()->radius();
+}
+
+void BackdropBlurWidget::setBlurRadius(const qreal value)
+{
+    Q_D(BackdropBlurWidget);
+    d->backdropBlur()->setRadius(value);
+}
+
+QColor BackdropBlurWidget::tintColor() const
+{
+    Q_D(const BackdropBlurWidget);
+    return d->backdropBlur()->tintColor();
+}
+
+void BackdropBlurWidget::setTintColor(const QColor &value)
+{
+    Q_D(BackdropBlurWidget);
+    d->backdropBlur()->setTintColor(value);
+}
+
+void BackdropBlurWidget::paintEvent(QPaintEvent *event)
+{
+    Q_D(BackdropBlurWidget);
+    d->paintBackdrop(event);
+}
+
+FRAMELESSHELPER_END_NAMESPACE
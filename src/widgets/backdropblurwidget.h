@@ -0,0 +1 @@
+#include "../../include/FramelessHelper/Widgets/backdropblurwidget.h"
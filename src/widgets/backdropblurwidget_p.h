@@ -0,0 +1 @@
+#include "../../include/FramelessHelper/Widgets/private/backdropblurwidget_p.h"
@@ -79,6 +79,7 @@ const FramelessDialogPrivate *FramelessDialogPrivate::get(const FramelessDialog
 void FramelessDialogPrivate::initialize()
 {
     Q_Q(FramelessDialog);
+    WidgetsSharedHelper::prepare(q);
     FramelessWidgetsHelper::get(q)->extendsContentIntoTitleBar();
     m_sharedHelper = new WidgetsSharedHelper(this);
     m_sharedHelper->setup(q);
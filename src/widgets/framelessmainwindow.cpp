@@ -79,6 +79,7 @@ const FramelessMainWindowPrivate *FramelessMainWindowPrivate::get(const Frameles
 void FramelessMainWindowPrivate::initialize()
 {
     Q_Q(FramelessMainWindow);
+    WidgetsSharedHelper::prepare(q);
     FramelessWidgetsHelper::get(q)->extendsContentIntoTitleBar();
     m_sharedHelper = new WidgetsSharedHelper(this);
     m_sharedHelper->setup(q);
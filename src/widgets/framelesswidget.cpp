@@ -79,6 +79,7 @@ const FramelessWidgetPrivate *FramelessWidgetPrivate::get(const FramelessWidget
 void FramelessWidgetPrivate::initialize()
 {
     Q_Q(FramelessWidget);
+    WidgetsSharedHelper::prepare(q);
     FramelessWidgetsHelper::get(q)->extendsContentIntoTitleBar();
     m_sharedHelper = new WidgetsSharedHelper(this);
     m_sharedHelper->setup(q);
@@ -30,9 +30,9 @@
 #include <QtWidgets/qwidget.h>
 #include <framelessconfig_p.h>
 #include <micamaterial.h>
-#include <micamaterial_p.h>
 #include <utils.h>
 #include <windowborderpainter.h>
+#include <windowshadowpainter.h>
 #ifdef Q_OS_WINDOWS
 #  include <winverhelper_p.h>
 #endif // Q_OS_WINDOWS
@@ -55,12 +55,38 @@ Q_LOGGING_CATEGORY(lcWidgetsSharedHelper, "wangwenx190.framelesshelper.widgets.w
 
 using namespace Global;
 
+[[maybe_unused]] static constexpr const qreal kDefaultScreenRefreshRate = 60.0;
+
 WidgetsSharedHelper::WidgetsSharedHelper(QObject *parent) : QObject(parent)
 {
+    m_micaMoveTimer.setSingleShot(true);
+    m_micaMoveTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_micaMoveTimer, &QTimer::timeout, this, [this](){
+        if (m_micaEnabled && m_targetWidget) {
+            m_targetWidget->update(micaBackdropRegion());
+        }
+    });
 }
 
 WidgetsSharedHelper::~WidgetsSharedHelper() = default;
 
+// Has to be called before the native window of \a widget is created.
+void WidgetsSharedHelper::prepare(QWidget *widget)
+{
+    Q_ASSERT(widget);
+    if (!widget) {
+        return;
+    }
+#if (defined(Q_OS_LINUX) && !defined(FRAMELESSHELPER_WIDGETS_NO_PRIVATE))
+    // The window shadow is painted into the window itself, see "setup()". Without
+    // a compositor the translucent area would be black instead of see-through.
+    if (FramelessConfig::instance()->isSet(Option::EnableWindowShadowOnLinux)
+        && Utils::isCompositingManagerRunning()) {
+        widget->setAttribute(Qt::WA_TranslucentBackground);
+    }
+#endif // (defined(Q_OS_LINUX) && !defined(FRAMELESSHELPER_WIDGETS_NO_PRIVATE))
+}
+
 void WidgetsSharedHelper::setup(QWidget *widget)
 {
     Q_ASSERT(widget);
@@ -82,6 +108,32 @@ void WidgetsSharedHelper::setup(QWidget *widget)
                 m_targetWidget->update();
             }
         });
+#if (defined(Q_OS_LINUX) && !defined(FRAMELESSHELPER_WIDGETS_NO_PRIVATE))
+    // Nobody draws a shadow for a frameless window on Linux, so we paint our own
+    // one into a translucent area around the window contents, if asked to. Only
+    // the windows which went through "prepare()" in time have the alpha channel it needs.
+    if (FramelessConfig::instance()->isSet(Option::EnableWindowShadowOnLinux)
+        && m_targetWidget->testAttribute(Qt::WA_TranslucentBackground)) {
+        m_shadowPainter = new WindowShadowPainter(this);
+        if (m_shadowRepaintConnection) {
+            disconnect(m_shadowRepaintConnection);
+            m_shadowRepaintConnection = {};
+        }
+        m_shadowRepaintConnection = connect(m_shadowPainter,
+            &WindowShadowPainter::shouldRepaint, this, [this](){
+                if (m_targetWidget) {
+                    m_targetWidget->update();
+                }
+            });
+        if (m_shadowMarginsConnection) {
+            disconnect(m_shadowMarginsConnection);
+            m_shadowMarginsConnection = {};
+        }
+        m_shadowMarginsConnection = connect(m_shadowPainter, &WindowShadowPainter::marginsChanged,
+            this, &WidgetsSharedHelper::updateShadowMargins);
+        m_shadowMargins = {};
+    }
+#endif // (defined(Q_OS_LINUX) && !defined(FRAMELESSHELPER_WIDGETS_NO_PRIVATE))
     m_micaMaterial = new MicaMaterial(this);
     if (m_micaRedrawConnection) {
         disconnect(m_micaRedrawConnection);
@@ -89,11 +141,13 @@ void WidgetsSharedHelper::setup(QWidget *widget)
     }
     m_micaRedrawConnection = connect(m_micaMaterial, &MicaMaterial::shouldRedraw,
         this, [this](){
+            invalidateMicaLayer();
             if (m_targetWidget) {
                 m_targetWidget->update();
             }
         });
     m_targetWidget->installEventFilter(this);
+    updateShadowMargins();
     updateContentsMargins();
     m_targetWidget->update();
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
@@ -121,6 +175,7 @@ void WidgetsSharedHelper::setMicaEnabled(const bool value)
         return;
     }
     m_micaEnabled = value;
+    invalidateMicaLayer();
     if (m_targetWidget) {
         m_targetWidget->update();
     }
@@ -137,6 +192,11 @@ WindowBorderPainter *WidgetsSharedHelper::rawWindowBorder() const
     return m_borderPainter;
 }
 
+WindowShadowPainter *WidgetsSharedHelper::rawWindowShadow() const
+{
+    return m_shadowPainter;
+}
+
 bool WidgetsSharedHelper::eventFilter(QObject *object, QEvent *event)
 {
     Q_ASSERT(object);
@@ -162,11 +222,26 @@ bool WidgetsSharedHelper::eventFilter(QObject *object, QEvent *event)
     case QEvent::WindowStateChange:
         changeEventHandler(event);
         break;
+    case QEvent::Show:
+        updateShadowFrameExtents();
+        break;
+    case QEvent::ActivationChange:
+        // The shadow of an inactive window is lighter.
+        if (m_shadowPainter) {
+            m_targetWidget->update();
+        }
+        break;
     case QEvent::Move:
+        if (m_micaEnabled) {
+            scheduleMicaMoveRepaint();
+        }
+        break;
     case QEvent::Resize:
+        // Qt repaints a resized widget by itself, only the cached layer is stale.
         if (m_micaEnabled) {
-            m_targetWidget->update();
+            invalidateMicaLayer();
         }
+        updateShadowFrameExtents();
         break;
     default:
         break;
@@ -213,15 +288,51 @@ void WidgetsSharedHelper::paintEventHandler(QPaintEvent *event)
     if (!event) {
         return;
     }
+    const bool normal = (Utils::windowStatesToWindowState(m_targetWidget->windowState()) == Qt::WindowNoState);
+    // Everything but the shadow goes into the visible part of the window.
+    const QRect contentsRect = m_targetWidget->rect().marginsRemoved(
+        (normal && m_shadowPainter) ? m_shadowMargins : QMargins());
+    if (normal && m_shadowPainter) {
+        QPainter painter(m_targetWidget);
+        m_shadowPainter->paint(&painter, m_targetWidget->size(), m_targetWidget->isActiveWindow());
+    }
     if (m_micaEnabled && m_micaMaterial) {
+        // The blurred wallpaper and the tint & noise layer only depend on where the
+        // widget is, so composite them once per position and size. Most paint events
+        // only cover a small part of the widget, which is just copied from the layer.
+        const QSize size = m_targetWidget->size();
+        const QPoint pos = m_targetWidget->mapToGlobal(QPoint(0, 0));
+        const qreal dpr = m_targetWidget->devicePixelRatioF();
+        const QSize layerSize = (QSizeF(size) * dpr).toSize();
+        if (m_micaLayer.isNull() || (m_micaLayerPos != pos) || (m_micaLayer.size() != layerSize)
+            || !qFuzzyCompare(m_micaLayer.devicePixelRatio(), dpr)) {
+            m_micaLayer = QPixmap(layerSize);
+            m_micaLayer.setDevicePixelRatio(dpr);
+            m_micaLayer.fill(kDefaultTransparentColor);
+            QPainter layerPainter(&m_micaLayer);
+            m_micaMaterial->paint(&layerPainter, size, pos);
+            layerPainter.end();
+            m_micaLayerPos = pos;
+        }
         QPainter painter(m_targetWidget);
-        m_micaMaterial->paint(&painter, m_targetWidget->size(),
-            m_targetWidget->mapToGlobal(QPoint(0, 0)));
+        painter.setClipRect(contentsRect);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
+        const QRegion &region = event->region();
+#else
+        const QVector<QRect> region = event->region().rects();
+#endif
+        for (auto &&rect : region) {
+            painter.drawPixmap(rect, m_micaLayer, QRectF(QRectF(rect).topLeft() * dpr, QSizeF(rect.size()) * dpr));
+        }
+    } else if (m_shadowPainter) {
+        // Qt doesn't paint the background of a translucent window.
+        QPainter painter(m_targetWidget);
+        painter.fillRect(contentsRect, m_targetWidget->palette().brush(m_targetWidget->backgroundRole()));
     }
-    if ((Utils::windowStatesToWindowState(m_targetWidget->windowState()) == Qt::WindowNoState)
-            && m_borderPainter) {
+    if (normal && m_borderPainter) {
         QPainter painter(m_targetWidget);
-        m_borderPainter->paint(&painter, m_targetWidget->size(), m_targetWidget->isActiveWindow());
+        painter.translate(contentsRect.topLeft());
+        m_borderPainter->paint(&painter, contentsRect.size(), m_targetWidget->isActiveWindow());
     }
     // Don't eat this event here, we need Qt to keep dispatching this paint event
     // otherwise the widget won't paint anything else from the user side.
@@ -242,6 +353,9 @@ void WidgetsSharedHelper::handleScreenChanged(QScreen *screen)
     }
     m_screen = screen;
     m_screenDpr = m_screen->devicePixelRatio();
+    // The wallpaper of the new screen may not have been requested yet.
+    invalidateMicaLayer();
+    updateShadowFrameExtents();
     if (m_screenDpiChangeConnection) {
         disconnect(m_screenDpiChangeConnection);
         m_screenDpiChangeConnection = {};
@@ -254,10 +368,59 @@ void WidgetsSharedHelper::handleScreenChanged(QScreen *screen)
                 return;
             }
             m_screenDpr = currentDpr;
-            if (m_micaEnabled && m_micaMaterial) {
-                MicaMaterialPrivate::get(m_micaMaterial)->maybeGenerateBlurredWallpaper(true);
+            // The frame extents are in device pixels.
+            updateShadowFrameExtents();
+            // The Mica material keeps one blurred wallpaper per screen and
+            // re-generates the one of this screen on the next repaint.
+            invalidateMicaLayer();
+            if (m_micaEnabled && m_targetWidget) {
+                m_targetWidget->update();
             }
         });
+    if (m_micaEnabled) {
+        m_targetWidget->update();
+    }
+}
+
+void WidgetsSharedHelper::invalidateMicaLayer()
+{
+    m_micaLayer = {};
+}
+
+void WidgetsSharedHelper::scheduleMicaMoveRepaint()
+{
+    // A window being dragged around can receive several move events per frame,
+    // but the screen can't show more than one of them anyway. The position is
+    // read again when the repaint happens, so dropping the others is fine.
+    if (m_micaMoveTimer.isActive()) {
+        return;
+    }
+    const qreal refreshRate = (m_screen ? m_screen->refreshRate() : 0.0);
+    const qreal frameRate = ((refreshRate > 1.0) ? refreshRate : kDefaultScreenRefreshRate);
+    m_micaMoveTimer.start(qMax(1, qRound(qreal(1000) / frameRate)));
+}
+
+QRegion WidgetsSharedHelper::micaBackdropRegion() const
+{
+    Q_ASSERT(m_targetWidget);
+    if (!m_targetWidget) {
+        return {};
+    }
+    // Moving the window only changes the part of the wallpaper behind it, child
+    // widgets that fully cover their own area don't need to be painted again.
+    QRegion region = m_targetWidget->rect();
+    const QList<QWidget *> children = m_targetWidget->findChildren<QWidget *>(QString(), Qt::FindDirectChildrenOnly);
+    for (auto &&child : std::as_const(children)) {
+        if (!child->isVisible() || child->isWindow()) {
+            continue;
+        }
+        const bool opaque = (child->testAttribute(Qt::WA_OpaquePaintEvent)
+            || (child->autoFillBackground() && child->palette().brush(child->backgroundRole()).isOpaque()));
+        if (opaque) {
+            region -= child->geometry();
+        }
+    }
+    return region;
 }
 
 void WidgetsSharedHelper::updateContentsMargins()
@@ -274,6 +437,45 @@ void WidgetsSharedHelper::updateContentsMargins()
     }();
     m_targetWidget->setContentsMargins(margins);
 #endif
+    if (m_shadowPainter) {
+        // Maximized and full screen windows don't show their shadow.
+        const bool normal = (Utils::windowStatesToWindowState(m_targetWidget->windowState()) == Qt::WindowNoState);
+        m_targetWidget->setContentsMargins(normal ? m_shadowMargins : QMargins());
+        updateShadowFrameExtents();
+    }
+}
+
+void WidgetsSharedHelper::updateShadowMargins()
+{
+    if (!m_targetWidget || !m_shadowPainter) {
+        return;
+    }
+    const QMargins margins = m_shadowPainter->margins();
+    if (m_shadowMargins == margins) {
+        return;
+    }
+    const QMargins delta = (margins - m_shadowMargins);
+    m_shadowMargins = margins;
+    // The shadow is part of the window, grow the window so that its visible part keeps its size.
+    if (Utils::windowStatesToWindowState(m_targetWidget->windowState()) == Qt::WindowNoState) {
+        m_targetWidget->resize(m_targetWidget->width() + delta.left() + delta.right(),
+            m_targetWidget->height() + delta.top() + delta.bottom());
+    }
+    updateContentsMargins();
+    m_targetWidget->update();
+}
+
+void WidgetsSharedHelper::updateShadowFrameExtents()
+{
+    if (!m_targetWidget || !m_shadowPainter) {
+        return;
+    }
+    // Don't create the native window just for this, we'll be called again once it's shown.
+    QWindow * const window = m_targetWidget->windowHandle();
+    if (!window || !m_targetWidget->isVisible()) {
+        return;
+    }
+    m_shadowPainter->updateFrameExtents(window);
 }
 
 FRAMELESSHELPER_END_NAMESPACE